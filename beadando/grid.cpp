@@ -4,6 +4,8 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include "staging_uploader.h"
+
 
 static std::vector<float> buildGrid(float width, float height, uint32_t count) {
     // Output format: { x, y, z, u, v }
@@ -85,15 +87,9 @@ void Grid::dump() {
     }
 }
 
-void Grid::BuildVertices(
-    const VkPhysicalDevice  phyDevice,
-    const VkDevice          device) {
-
-    vertexInfo = BufferInfo::Create(phyDevice, device, vertexSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    vertexInfo.Update(device, vertices.data(), vertexSize());
-
-    indexInfo = BufferInfo::Create(phyDevice, device, indexSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
-    indexInfo.Update(device, indices.data(), indexSize());
+void Grid::BuildVertices(StagingUploader& uploader) {
+    vertexInfo = uploader.CreateBuffer(vertexSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertices.data());
+    indexInfo  = uploader.CreateBuffer(indexSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data());
 }
 
 void Grid::Destroy(const VkDevice device) {
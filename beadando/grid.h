@@ -9,6 +9,8 @@
 
 #include "buffer.h"
 
+class StagingUploader;
+
 struct Grid {
     std::vector<float>      vertices;
     uint32_t                vertexCount;
@@ -22,9 +24,8 @@ struct Grid {
     Grid(float width, float height, uint32_t count);
     void dump();
 
-    void BuildVertices(
-        const VkPhysicalDevice  phyDevice,
-        const VkDevice          device);
+    // Queues the vertex and index data, usable after the uploader is flushed.
+    void BuildVertices(StagingUploader& uploader);
 
     void Destroy(const VkDevice device);
 
@@ -7,15 +7,6 @@ layout(location = 3) in vec3 in_fragPos;
 
 layout(location = 0) out vec4 out_color;
 
-layout(push_constant) uniform PushConstants {
-    layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 view;
-    layout(offset = 2*4*4*4) mat4 projection;
-    layout(offset = 3*4*4*4) vec3 cameraPosition;
-    layout(offset = 3*4*4*4 + 1*4*4) vec3 lightPosition;
-} constants;
-
-
 void main() {
     out_color = vec4(in_color, 1.0);
 }
@@ -1,24 +1,45 @@
 #pragma once
 
+#include <vector>
+
 #include <vulkan/vulkan_core.h>
 
+#include "pipeline_variants.h"
+#include "shader_reflection.h"
+
 class LightningPass {
 public:
+    enum Variant : uint32_t {
+        Simple          = 0,    // lightning_simple.vert/frag
+        ShadowMap       = 1,    // lightning_shadowmap.vert/frag
+        VariantCount    = 2,
+    };
 
+    // Nothing is compiled here: a variant is built on the compiler when it is first used (or warmed).
     void BuildPipeline(
+        PipelineCompiler&       compiler,
         const VkDevice          device,
         const VkExtent2D        surfaceExtent,
         const VkRenderPass      renderPass,
         const VkPipelineLayout  pipelineLayout,
-        const VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT);
+        const VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT,
+        const uint32_t          textureCount = 1,   // size of the texture array of set 1
+        const std::vector<VkDynamicState>& rasterStates = {});  // ExtendedDynamicState::States()
 
     void Destroy(const VkDevice device);
 
-    VkPipeline SimplePipeline() const { return m_simplePipeline; }
-    VkPipeline ShadowMapPipeline() const { return m_shadowMapPipeline; }
+    // Descriptor and push constant interface of both pipelines' shaders
+    static ShaderReflection Reflect();
+
+    // The variant if it is built, otherwise it is queued and "fallback" (or the previously used variant)
+    // is returned. With pipeline libraries this is the fast linked pipeline, bind PipelineRegistry::Optimized of it.
+    VkPipeline Pipeline(Variant variant, VkPipeline fallback) { return m_variants.Get(variant, fallback); }
+
+    // Warming, statistics and shader hot reload (Rebuild)
+    PipelineVariants& Variants() { return m_variants; }
+    static const char* VariantName(uint32_t variant) { return variant == ShadowMap ? "ShadowMap" : "Simple"; }
 
 private:
 
-    VkPipeline m_simplePipeline     = VK_NULL_HANDLE;
-    VkPipeline m_shadowMapPipeline  = VK_NULL_HANDLE;
+    PipelineVariants m_variants;
 };
@@ -10,15 +10,23 @@ layout(location = 3) in vec4 in_fragPosLightSpace;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 0, binding = 0) uniform sampler2D modelTexture;
+// Every material texture lives in one array, "textureIndex" selects the one of the draw.
+// Own set: a bindless array needs an update after bind layout, which may not hold the dynamic FrameInfo.
+layout(constant_id = 0) const uint TEXTURE_COUNT = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_COUNT];
 layout(set = 0, binding = 1) uniform sampler2D shadowMap; 
 
+layout(set = 0, binding = 2) uniform FrameInfo {
+    mat4 lightSpaceMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    vec4 lightPosition;
+    mat4 models[3];
+} frame;
+
 layout(push_constant) uniform PushConstants {
-    layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 view;
-    layout(offset = 2*4*4*4) mat4 projection;
-    layout(offset = 3*4*4*4) vec3 cameraPosition;
-    layout(offset = 3*4*4*4 + 1*4*4) vec3 lightPosition;
+    layout(offset = 1*4*4*4 + 4) uint textureIndex;
 } constants;
 
 vec3 lightColor    = vec3(1.0f, 1.0f, 1.0f);
@@ -65,7 +73,7 @@ float PCFShadow(vec4 fragPosLightSpace)
     float currentDepth = projCoords.z;
     /*
     vec3 normal = normalize(in_normal);
-    vec3 lightDir = normalize(constants.lightPosition - in_fragPos);
+    vec3 lightDir = normalize(frame.lightPosition.xyz - in_fragPos);
     float bias = max(0.01 * (1.0 - dot(normal, lightDir)), 0.001);
     */
     float shadow = 0.0;
@@ -90,10 +98,10 @@ float PCFShadow(vec4 fragPosLightSpace)
 }
 
 void main() {
-    vec4 pixel = texture(modelTexture, in_uv);
+    vec4 pixel = texture(textures[constants.textureIndex], in_uv);
 
     // distance based attenuation
-    float distance    = length(constants.lightPosition - in_fragPos);
+    float distance    = length(frame.lightPosition.xyz - in_fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance +
                                light.quadratic * (distance * distance));
 
@@ -103,7 +111,7 @@ void main() {
 
     // diffuse
     vec3 norm = normalize(in_normal);
-    vec3 lightDir = normalize(constants.lightPosition - in_fragPos);
+    vec3 lightDir = normalize(frame.lightPosition.xyz - in_fragPos);
 
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = diff * lightColor; //* attenuation;
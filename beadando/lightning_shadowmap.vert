@@ -4,16 +4,18 @@ layout(location = 0) in vec3 in_position;
 layout(location = 1) in vec2 in_uv;
 layout(location = 2) in vec3 in_normal;
 
-layout(set = 0, binding = 2) uniform li {
+layout(set = 0, binding = 2) uniform FrameInfo {
     mat4 lightSpaceMatrix;
-} lightInfo; 
-
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    vec4 lightPosition;
+    mat4 models[3];
+} frame;
 
 layout(push_constant) uniform PushConstants {
     layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 view;
-    layout(offset = 2*4*4*4) mat4 projection;
-    layout(offset = 3*4*4*4) vec3 cameraPosition;
+    layout(offset = 1*4*4*4) uint modelSlot;
 } constants;
 
 layout(location = 0) out vec2 out_uv;
@@ -28,12 +30,14 @@ const mat4 biasMat = mat4(
     0.5, 0.5, 0.0, 1.0 );
 
 void main() {
-    gl_Position = constants.projection * constants.view * constants.model * vec4(in_position, 1.0f);
+    mat4 model = frame.models[constants.modelSlot] * constants.model;
+
+    gl_Position = frame.projection * frame.view * model * vec4(in_position, 1.0f);
 
     out_uv = in_uv;
-    out_normal = mat3(transpose(inverse(constants.model))) * in_normal;
-    out_fragPos = vec3(constants.model * vec4(in_position, 1.0f));
+    out_normal = mat3(transpose(inverse(model))) * in_normal;
+    out_fragPos = vec3(model * vec4(in_position, 1.0f));
 
-    out_fragPosLightSpace = /*biasMat * */ lightInfo.lightSpaceMatrix * constants.model * vec4(in_position, 1.0f);
+    out_fragPosLightSpace = /*biasMat * */ frame.lightSpaceMatrix * model * vec4(in_position, 1.0f);
     // out_fragPosLightSpace.xy is in [-1, 1]; range, need to normalize it to [0,1] here or in the fragment shader for uv coords
 }
@@ -7,20 +7,28 @@ layout(location = 3) in vec3 in_fragPos;
 
 layout(location = 0) out vec4 out_color;
 
-layout(set = 0, binding = 0) uniform sampler2D modelTexture;
+// Every material texture lives in one array, "textureIndex" selects the one of the draw.
+// Own set: a bindless array needs an update after bind layout, which may not hold the dynamic FrameInfo.
+layout(constant_id = 0) const uint TEXTURE_COUNT = 1;
+layout(set = 1, binding = 0) uniform sampler2D textures[TEXTURE_COUNT];
+
+layout(set = 0, binding = 2) uniform FrameInfo {
+    mat4 lightSpaceMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    vec4 lightPosition;
+    mat4 models[3];
+} frame;
 
 layout(push_constant) uniform PushConstants {
-    layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 view;
-    layout(offset = 2*4*4*4) mat4 projection;
-    layout(offset = 3*4*4*4) vec3 cameraPosition;
-    layout(offset = 3*4*4*4 + 1*4*4) vec3 lightPosition;
+    layout(offset = 1*4*4*4 + 4) uint textureIndex;
 } constants;
 
 vec3 lightColor    = vec3(1.0f, 1.0f, 1.0f);
 
 void main() {
-    vec4 pixel = texture(modelTexture, in_uv);
+    vec4 pixel = texture(textures[constants.textureIndex], in_uv);
 
     // ambient
     float ambientStrength = 0.1;
@@ -28,14 +36,14 @@ void main() {
     
     // diffuse 
     vec3 norm = normalize(in_normal);
-    vec3 lightDir = normalize(constants.lightPosition - in_fragPos);
+    vec3 lightDir = normalize(frame.lightPosition.xyz - in_fragPos);
 
     float diff = max(dot(norm, lightDir), 0.0);
     vec3 diffuse = diff * lightColor;
 
     // specular
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(constants.cameraPosition - in_fragPos);
+    vec3 viewDir = normalize(frame.cameraPosition.xyz - in_fragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;  
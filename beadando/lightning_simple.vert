@@ -15,21 +15,31 @@ layout(location = 1) out vec2 out_uv;
 layout(location = 2) out vec3 out_normal;
 layout(location = 3) out vec3 out_fragPos;
 
+// Per frame values, written into the uniform ring every frame: the recorded draws stay valid.
+// "models" are the animated model matrices, a draw selects one with "modelSlot" (0 is the identity).
+layout(set = 0, binding = 2) uniform FrameInfo {
+    mat4 lightSpaceMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    vec4 lightPosition;
+    mat4 models[3];
+} frame;
+
 layout(push_constant) uniform PushConstants {
     layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 view;
-    layout(offset = 2*4*4*4) mat4 projection;
-    layout(offset = 3*4*4*4) vec3 cameraPosition;
+    layout(offset = 1*4*4*4) uint modelSlot;
 } constants;
 
 void main() {
     vec3 current_pos = in_position;
+    mat4 model = frame.models[constants.modelSlot] * constants.model;
 
-    gl_Position = constants.projection * constants.view * constants.model * vec4(current_pos, 1.0f);
+    gl_Position = frame.projection * frame.view * model * vec4(current_pos, 1.0f);
 
     out_color = colors[gl_VertexIndex % 3];
     out_uv = in_uv;
-    out_normal = mat3(transpose(inverse(constants.model))) * in_normal;
-    //out_normal = mat3(constants.model) * in_normal;
-    out_fragPos = vec3(constants.model * vec4(current_pos, 1.0f));
+    out_normal = mat3(transpose(inverse(model))) * in_normal;
+    //out_normal = mat3(model) * in_normal;
+    out_fragPos = vec3(model * vec4(current_pos, 1.0f));
 }
@@ -21,6 +21,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "buffer.h"
+#include "staging_uploader.h"
 
 #define DEBUG 0
 
@@ -28,13 +29,13 @@ class Mesh {
   public:
     Mesh() {}
 
-    Mesh(const std::string &filename, const VkPhysicalDevice &phyDevice, const VkDevice &device, glm::vec3 modelPos) {
+    // The vertex data is only usable after the uploader is flushed.
+    Mesh(const std::string &filename, StagingUploader &uploader, glm::vec3 modelPos) {
         m_vertices = std::vector<float>();
         loadObject(filename.c_str());
 
-        m_bufferInfo =
-            BufferInfo::Create(phyDevice, device, m_vertices.size() * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-        m_bufferInfo.Update(device, m_vertices.data(), m_vertices.size() * sizeof(float));
+        m_bufferInfo = uploader.CreateBuffer(m_vertices.size() * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                             m_vertices.data());
 
         m_rotation = {0, 0, 0};
         m_model    = glm::translate(glm::mat4(1.0f), modelPos);
@@ -1,5 +1,10 @@
 #include "post_process.h"
 
+#include <algorithm>
+
+#include "layout_cache.h"
+#include "pipeline_builder.h"
+#include "shader_reflection.h"
 #include "shader_tooling.h"
 
 namespace {
@@ -8,238 +13,89 @@ namespace {
 }
 
 
-static VkPipeline CreatePipeline(
+void PostProcessPass::BuildPipeline(
+    PipelineCompiler&       compiler,
     const VkDevice          device,
     const VkExtent2D        surfaceExtent,
-    const VkRenderPass      renderPass,
-    const VkPipelineLayout  pipelineLayout,
-    const VkShaderModule    shaderVertex,
-    const VkShaderModule    shaderFragment) {
-
-    // shader stages
-    VkPipelineShaderStageCreateInfo shaders[] = {
-        {
-            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext                  = nullptr,
-            .flags                  = 0,
-            .stage                  = VK_SHADER_STAGE_VERTEX_BIT,
-            .module                 = shaderVertex,
-            .pName                  = "main",
-            .pSpecializationInfo    = nullptr,
-        },
-        {
-            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext                  = nullptr,
-            .flags                  = 0,
-            .stage                  = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module                 = shaderFragment,
-            .pName                  = "main",
-            .pSpecializationInfo    = nullptr,
-        }
-    };
-
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType                              = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext                              = 0,
-        .flags                              = 0,
-        .vertexBindingDescriptionCount      = 0u,
-        .pVertexBindingDescriptions         = nullptr,
-        .vertexAttributeDescriptionCount    = 0u,
-        .pVertexAttributeDescriptions       = nullptr,
-    };
-
-    // input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    // viewport info
-    VkViewport viewport = {
-        .x          = 0,
-        .y          = 0,
-        .width      = float(surfaceExtent.width),
-        .height     = float(surfaceExtent.height),
-        .minDepth   = 0.0f,
-        .maxDepth   = 1.0f,
-    };
-
-    VkRect2D scissor {
-        .offset = { 0, 0 },
-        .extent = surfaceExtent,
-    };
-
-    VkPipelineViewportStateCreateInfo viewportInfo = {
-        .sType          = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .pNext          = nullptr,
-        .flags          = 0,
-        .viewportCount  = 1,
-        .pViewports     = &viewport,
-        .scissorCount   = 1,
-        .pScissors      = &scissor,
-    };
-
-    // rasterization info
-    VkPipelineRasterizationStateCreateInfo rasterizationInfo = {
-        .sType       = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .pNext                   = nullptr,
-        .flags                   = 0,
-        .depthClampEnable        = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode             = VK_POLYGON_MODE_FILL,
-        .cullMode                = VK_CULL_MODE_NONE, //VK_CULL_MODE_FRONT_BIT,
-        .frontFace               = VK_FRONT_FACE_CLOCKWISE,
-        .depthBiasEnable         = VK_FALSE,
-        .depthBiasConstantFactor = 0.0f, // Disabled
-        .depthBiasClamp          = 0.0f, // Disabled
-        .depthBiasSlopeFactor    = 0.0f, // Disabled
-        .lineWidth               = 1.0f,
-    };
-
-    // multisample
-    VkPipelineMultisampleStateCreateInfo multisampleInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .rasterizationSamples   = VK_SAMPLE_COUNT_1_BIT,
-        .sampleShadingEnable    = VK_FALSE,
-        .minSampleShading       = 0.0f,
-        .pSampleMask            = nullptr,
-        .alphaToCoverageEnable  = VK_FALSE,
-        .alphaToOneEnable       = VK_FALSE,
-    };
-
-    // depth stencil
-    // "empty" stencil Op state
-    VkStencilOpState emptyStencilOp = { };
-
-    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {
-        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .pNext                 = nullptr,
-        .flags                 = 0,
-        .depthTestEnable       = VK_TRUE,
-        .depthWriteEnable      = VK_TRUE,
-        .depthCompareOp        = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable     = VK_FALSE,
-        .front                 = emptyStencilOp,
-        .back                  = emptyStencilOp,
-        .minDepthBounds        = 0.0f,
-        .maxDepthBounds        = 1.0f,
-    };
-
-    // color blend
-    VkPipelineColorBlendAttachmentState blendAttachment = {
-        .blendEnable         = VK_TRUE,
-        // as blend is disabled fill these with default values,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-        .colorBlendOp        = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp        = VK_BLEND_OP_ADD,
-        // Important!
-        .colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
+    const VkRenderPass      renderPass) {
 
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {
-        .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .pNext           = nullptr,
-        .flags           = 0,
-        .logicOpEnable   = VK_FALSE, //FALSE,
-        .logicOp         = VK_LOGIC_OP_CLEAR, // Disabled
-        // Important!
-        .attachmentCount = 1,
-        .pAttachments    = &blendAttachment,
-        .blendConstants  = { 1.0f, 1.0f, 1.0f, 1.0f }, // Ignored
-    };
+    m_device = device;
 
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-    };
+    // Bindings 0 (resolved input) and 1 (multisampled input) as used by the shaders
+    ShaderReflection reflection = ShaderReflection::Create(SPV_post_process_vert, sizeof(SPV_post_process_vert));
+    reflection.Merge(ShaderReflection::Create(SPV_post_process_frag, sizeof(SPV_post_process_frag)));
 
-    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {
-        .sType              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .pNext              = nullptr,
-        .flags              = 0,
-        .dynamicStateCount  = 1,
-        .pDynamicStates     = dynamicStates,
-    };
+    m_descMgmt.SetDescriptors(reflection);
+    VkDescriptorSetLayout setLayout = m_descMgmt.CreateLayout(device);
 
-    // pipeline create
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
-        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext               = nullptr,
-        .flags               = 0,
-        .stageCount          = 2,
-        .pStages             = shaders,
-        .pVertexInputState   = &vertexInputInfo,
-        .pInputAssemblyState = &inputAssemblyInfo,
-        .pTessellationState  = nullptr,
-        .pViewportState      = &viewportInfo,
-        .pRasterizationState = &rasterizationInfo,
-        .pMultisampleState   = &multisampleInfo,
-        .pDepthStencilState  = &depthStencilInfo,
-        .pColorBlendState    = &colorBlendInfo,
-        .pDynamicState       = &dynamicStateInfo,
-        .layout              = pipelineLayout,
-        .renderPass          = renderPass,
-        .subpass             = 0,
-        .basePipelineHandle  = VK_NULL_HANDLE,
-        .basePipelineIndex   = 0,
-    };
+    m_descMgmt.CreatePool(device);
+    m_descMgmt.CreateDescriptorSets(device, 1);
 
-    VkPipeline pipeline = VK_NULL_HANDLE;
-    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+    VkResult result = LayoutCache::Get(device).Acquire({ setLayout }, reflection.PushConstantRanges(), &m_pipelineLayout);
     (void)result;
 
-    return pipeline;
+    // The layout is not modified after this point, the builds on the workers may read it
+    m_variants.Init(compiler, kModeCount * (1 + kMaxSampleCount),
+                    [this, device, surfaceExtent, renderPass](uint32_t variant, VkPipelineCache pipelineCache) {
+        return CreateVariant(device, surfaceExtent, renderPass, variant, pipelineCache);
+    });
+    m_variants.Warm(VariantIndex(0, false, 0));
 }
 
-void PostProcessPass::BuildPipeline(
+VkPipeline PostProcessPass::CreateVariant(
     const VkDevice          device,
     const VkExtent2D        surfaceExtent,
-    const VkRenderPass      renderPass) {
-
-    m_descMgmt.SetDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1); // Post process input
-    m_descMgmt.SetDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1); // Post process input
-    m_descMgmt.SetDescriptor(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1); // lightInfo
-    VkDescriptorSetLayout setLayout = m_descMgmt.CreateLayout(device);
-
-    m_descMgmt.CreatePool(device);
-    m_descMgmt.CreateDescriptorSets(device, 1);
-
-    VkPushConstantRange pushRange = {
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        .offset     = 0,
-        .size       = sizeof(uint32_t) * 4 * 3,
-    };
-
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .setLayoutCount         = 1u,
-        .pSetLayouts            = &setLayout,
-        .pushConstantRangeCount = 1,
-        .pPushConstantRanges    = &pushRange,
-    };
+    const VkRenderPass      renderPass,
+    uint32_t                variant,
+    const VkPipelineCache   pipelineCache) const {
+
+    const std::vector<uint32_t> vertexCode   = ShaderCode(SPV_post_process_vert, sizeof(SPV_post_process_vert));
+    const std::vector<uint32_t> fragmentCode = ShaderCode(SPV_post_process_frag, sizeof(SPV_post_process_frag));
+
+    // constant_id 0: POST_PROC_MODE, 1: SAMPLING_MODE, 2: SAMPLE_COUNT
+    struct {
+        uint32_t mode;
+        uint32_t samplingMode;
+        uint32_t sampleCount;
+    } constants;
+
+    VkSpecializationMapEntry constantEntries[] = {
+        { .constantID = 0, .offset = 0 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 1, .offset = 1 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+        { .constantID = 2, .offset = 2 * sizeof(uint32_t), .size = sizeof(uint32_t) },
+    };
+
+    VkSpecializationInfo fragmentSpecialization = {
+        .mapEntryCount  = 3,
+        .pMapEntries    = constantEntries,
+        .dataSize       = sizeof(constants),
+        .pData          = &constants,
+    };
+
+    // Inverse of VariantIndex, without MSAA input the sample count is 0
+    const uint32_t mode         = variant / (1 + kMaxSampleCount);
+    const uint32_t sampleCount  = variant % (1 + kMaxSampleCount);
+
+    constants.mode          = mode;
+    constants.samplingMode  = sampleCount > 0 ? 1 : 0;
+    constants.sampleCount   = sampleCount > 0 ? sampleCount : 1;
+
+    // Full screen triangle generated in the vertex shader: no vertex input
+    PipelineBuilder builder;
+    builder.Shader(VK_SHADER_STAGE_VERTEX_BIT, vertexCode.data(), vertexCode.size() * sizeof(uint32_t))
+           .Shader(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentCode.data(), fragmentCode.size() * sizeof(uint32_t),
+                   &fragmentSpecialization)
+           .Extent(surfaceExtent)
+           .DynamicState(VK_DYNAMIC_STATE_VIEWPORT)
+           .DynamicState(VK_DYNAMIC_STATE_SCISSOR)
+           .Layout(m_pipelineLayout)
+           .RenderPass(renderPass);
 
-    VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = PipelineRegistry::Get(device).Acquire(builder, pipelineCache, &pipeline);
     (void)result;
 
-    VkShaderModule shaders[] = {
-        CreateShaderModule(device, SPV_post_process_vert, sizeof(SPV_post_process_vert)),
-        CreateShaderModule(device, SPV_post_process_frag, sizeof(SPV_post_process_frag)),
-    };
-
-    m_pipeline = CreatePipeline(device, surfaceExtent, renderPass, m_pipelineLayout, shaders[0], shaders[1]);
-
-    vkDestroyShaderModule(device, shaders[0], nullptr);
-    vkDestroyShaderModule(device, shaders[1], nullptr);
+    return pipeline;
 }
 
 void PostProcessPass::BindInputImage(const VkDevice device, const Texture& texture) {
@@ -256,23 +112,47 @@ void PostProcessPass::BindMSInputImage(const VkDevice device, const Texture& tex
     descSet.Update(device);
 }
 
-void PostProcessPass::BindPipeline(VkCommandBuffer cmdBuffer) {
-    const VkShaderStageFlags pushFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+uint32_t PostProcessPass::VariantIndex(uint32_t mode, bool useMsaa, uint32_t sampleCount) {
+    mode        = std::min(mode, kModeCount - 1);
+    sampleCount = useMsaa ? std::clamp(sampleCount, 1u, kMaxSampleCount) : 0;
 
+    return mode * (1 + kMaxSampleCount) + sampleCount;
+}
 
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+std::string PostProcessPass::VariantName(uint32_t variant) {
+    static const char* modeNames[kModeCount] = { "None", "Laplace", "Blur", "Sepia", "FXAA" };
 
-    VkDescriptorSet descSet = m_descMgmt.Set(0).Get();
-    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descSet, 0, nullptr);
+    const uint32_t mode         = std::min(variant / (1 + kMaxSampleCount), kModeCount - 1);
+    const uint32_t sampleCount  = variant % (1 + kMaxSampleCount);
+
+    std::string name = modeNames[mode];
+    if (sampleCount > 0) {
+        name += ", MSAA x" + std::to_string(sampleCount);
+    }
 
-    uint32_t postProcMode[4] = { m_mode, 0, 0, 0 };
-    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, pushFlags, 0 * sizeof(int) * 4, sizeof(postProcMode), &postProcMode);
+    return name;
+}
 
-    uint32_t msaaMode[4] = { (m_useMsaa ? 1u : 0u), 0, 0, 0 };
-    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, pushFlags, 1 * sizeof(int) * 4, sizeof(msaaMode), &msaaMode);
+VkPipeline PostProcessPass::Pipeline() {
+    if (m_variants.VariantCount() == 0) {
+        return VK_NULL_HANDLE;
+    }
 
-    uint32_t msaaSamples[4] = { m_useMsaaSamples, 0, 0, 0 };
-    vkCmdPushConstants(cmdBuffer, m_pipelineLayout, pushFlags, 2 * sizeof(int) * 4, sizeof(msaaSamples), &msaaSamples);
+    // Until the selected variant is built the previous one (at first the default) is drawn
+    return m_variants.Get(VariantIndex(m_mode, m_useMsaa, m_useMsaaSamples), m_variants.Current(VariantIndex(0, false, 0)));
+}
+
+void PostProcessPass::BindPipeline(VkCommandBuffer cmdBuffer) {
+    // The mode and the MSAA settings are baked into the variants,
+    // with pipeline libraries the link time optimized variant is used once the registry has it
+    BindPipeline(cmdBuffer, PipelineRegistry::Get(m_device).Optimized(Pipeline()));
+}
+
+void PostProcessPass::BindPipeline(VkCommandBuffer cmdBuffer, VkPipeline pipeline) {
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkDescriptorSet descSet = m_descMgmt.Set(0).Get();
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &descSet, 0, nullptr);
 }
 
 void PostProcessPass::Draw(VkCommandBuffer cmdBuffer) {
@@ -280,8 +160,9 @@ void PostProcessPass::Draw(VkCommandBuffer cmdBuffer) {
 }
 
 void PostProcessPass::Destroy(const VkDevice device) {
-    vkDestroyPipeline(device, m_pipeline, nullptr);
-    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    m_variants.Destroy(device);
+    LayoutCache::Get(device).Release(m_pipelineLayout);
+    m_pipelineLayout = VK_NULL_HANDLE;
 
     m_descMgmt.Destroy(device);
 }
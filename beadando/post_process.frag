@@ -5,36 +5,35 @@ layout (binding = 1) uniform sampler2DMS samplerColorMS;
 
 layout(location = 0) in vec2 in_uv;
 
-layout(push_constant) uniform PushConstants {
-    layout(offset = 0*4*4) uvec4 postProcMode;
+// Every combination is a separate pipeline, the unused paths are removed by the compiler.
+layout(constant_id = 0) const uint POST_PROC_MODE = 0;
 
-    // samplingMode.x == 0 -> resolvedImg/samplerColor 
-    // samplingMode.x == 1 -> msaaImg/samplerColorMS
-    layout(offset = 1*4*4) uvec4 samplingMode;
+// SAMPLING_MODE == 0 -> resolvedImg/samplerColor
+// SAMPLING_MODE == 1 -> msaaImg/samplerColorMS
+layout(constant_id = 1) const uint SAMPLING_MODE = 0;
 
-    // samples.x -> number of subsamples to use
-    layout(offset = 2*4*4) uvec4 samples;
-};
+// number of subsamples to use
+layout(constant_id = 2) const uint SAMPLE_COUNT = 1;
 
 layout(location = 0) out vec4 out_color;
 
 vec4 getPixel(vec2 uv) {
-    if (samplingMode.x == 1) {
+    if (SAMPLING_MODE == 1) {
         ivec2 iuv = ivec2( uv * textureSize(samplerColorMS) );
 
         vec4 result = vec4(0.0f);
-        for (uint idx = 0; idx < samples.x; idx++) {
+        for (uint idx = 0; idx < SAMPLE_COUNT; idx++) {
             result += texelFetch(samplerColorMS, iuv, int(idx));
         }
 
-        return result / samples.x;
+        return result / SAMPLE_COUNT;
     } else {
         return texture(samplerColor, uv);
     }
 }
 
 ivec2 textureSize() {
-    if (samplingMode.x == 1) {
+    if (SAMPLING_MODE == 1) {
         return textureSize(samplerColorMS);
     } else {
         return textureSize(samplerColor, 0);
@@ -174,9 +173,7 @@ vec4 doFXAA() {
 void main() {
     vec4 result = vec4(1.0);
 
-    uint mode = postProcMode.x;
-
-    switch (mode) {
+    switch (POST_PROC_MODE) {
         case 0u: {
             vec4 pixel = getPixel(in_uv);
             result = pixel;
@@ -1,14 +1,24 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <vulkan/vulkan_core.h>
 
 #include "descriptors.h"
+#include "pipeline_variants.h"
 #include "texture.h"
 
 class PostProcessPass {
 public:
+    // "None", "Laplace", "Blur", "Sepia", "FXAA"
+    static constexpr uint32_t kModeCount        = 5;
+    static constexpr uint32_t kMaxSampleCount   = 4;
 
+    // One pipeline per (mode, MSAA input, sample count) combination, built on the compiler when first used.
+    // Only the default variant (no post processing) is queued here, it is the fallback of the others.
     void BuildPipeline(
+        PipelineCompiler&       compiler,
         const VkDevice          device,
         const VkExtent2D        surfaceExtent,
         const VkRenderPass      renderPass);
@@ -23,17 +33,29 @@ public:
     void Destroy(const VkDevice device);
 
     void BindPipeline(VkCommandBuffer cmdBuffer);
+    // For recording on other threads: "pipeline" is resolved on the render thread (Pipeline is not thread safe)
+    void BindPipeline(VkCommandBuffer cmdBuffer, VkPipeline pipeline);
     void Draw(VkCommandBuffer cmdBuffer);
 
-    VkPipeline          Pipeline() const { return m_pipeline; }
+    // The variant matching the current mode and MSAA settings, or a fallback while it is built
+    VkPipeline          Pipeline();
     VkPipelineLayout    PipelineLayout() const { return m_pipelineLayout; }
     VkDescriptorSet     DescSet() { return m_descMgmt.Set(0).Get(); }
 
+    // Warming, statistics and shader hot reload (Rebuild), indexed by VariantIndex
+    PipelineVariants&   Variants() { return m_variants; }
+    static uint32_t     VariantIndex(uint32_t mode, bool useMsaa, uint32_t sampleCount);
+    static std::string  VariantName(uint32_t variant);
+
 private:
+    VkPipeline CreateVariant(const VkDevice device, const VkExtent2D surfaceExtent, const VkRenderPass renderPass,
+                             uint32_t variant, const VkPipelineCache pipelineCache) const;
+
+    VkDevice            m_device            = VK_NULL_HANDLE;
     DescriptorMgmt      m_descMgmt          = {};
 
     VkPipelineLayout    m_pipelineLayout    = VK_NULL_HANDLE;
-    VkPipeline          m_pipeline          = VK_NULL_HANDLE;
+    PipelineVariants    m_variants;
 
     uint32_t            m_mode              = 0;
     bool                m_useMsaa           = false;
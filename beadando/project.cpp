@@ -1,5 +1,11 @@
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -20,13 +26,37 @@
 namespace {
 #include "lightning_no.frag_include.h"
 #include "lightning_simple.vert_include.h"
+
+// Only needed to match the hot reloaded sources with the pipelines using them
+#include "lightning_shadowmap.frag_include.h"
+#include "lightning_shadowmap.vert_include.h"
+#include "lightning_simple.frag_include.h"
+#include "post_process.frag_include.h"
+#include "post_process.vert_include.h"
+#include "shadow_map.frag_include.h"
+#include "shadow_map.vert_include.h"
 } // namespace
 
 #include "buffer.h"
 #include "descriptors.h"
+#include "device_extensions.h"
+#include "extended_dynamic_state.h"
+#include "frames_in_flight.h"
+#include "layout_cache.h"
+#include "parallel_recorder.h"
+#include "present_mode.h"
+#include "queue_timeline.h"
+#include "reusable_commands.h"
 #include "grid.h"
+#include "ring_buffer.h"
+#include "sampler_cache.h"
+#include "shader_reflection.h"
 #include "shader_tooling.h"
+#include "shader_watcher.h"
+#include "staging_uploader.h"
 #include "texture.h"
+#include "texture_loader.h"
+#include "texture_table.h"
 
 #include "lightning_pass.h"
 #include "post_process.h"
@@ -35,6 +65,12 @@ namespace {
 #include "mesh.cpp"
 
 #include "debug.h"
+#include "memory_stats.h"
+#include "pipeline_builder.h"
+#include "pipeline_cache.h"
+#include "pipeline_compiler.h"
+#include "pipeline_library.h"
+#include "pipeline_variants.h"
 
 #define VK_LOAD_INSTANCE_PFN(instance, name) reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name))
 
@@ -184,6 +220,17 @@ VkResult FindPhyDevice(const VkInstance instance, const VkSurfaceKHR surface, Vk
 
     // Iterate over the devices and find first device and bail
     for (const VkPhysicalDevice &device : devices) {
+        // The material textures are selected from an array by a push constant in the fragment shaders
+        VkPhysicalDeviceFeatures features = {};
+        vkGetPhysicalDeviceFeatures(device, &features);
+        if (features.shaderSampledImageArrayDynamicIndexing != VK_TRUE) {
+            VkPhysicalDeviceProperties properties = {};
+            vkGetPhysicalDeviceProperties(device, &properties);
+            printf("Skipping device \"%s\": shaderSampledImageArrayDynamicIndexing is not supported\n",
+                   properties.deviceName);
+            continue;
+        }
+
         if (FindQueueFamily(device, surface, outQueueFamilyIdx)) {
             *outPhyDevice = device;
             return VK_SUCCESS;
@@ -193,6 +240,141 @@ VkResult FindPhyDevice(const VkInstance instance, const VkSurfaceKHR surface, Vk
     return VK_ERROR_INITIALIZATION_FAILED;
 }
 
+// Features needed by DescriptorMgmt::SetBindlessDescriptor for sampled images.
+bool IsBindlessSupported(const VkPhysicalDevice phyDevice) {
+    if (!HasDeviceExtension(phyDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &indexingFeatures;
+
+    vkGetPhysicalDeviceFeatures2(phyDevice, &features);
+
+    return indexingFeatures.descriptorBindingPartiallyBound &&
+           indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+           indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+}
+
+// Number of material textures in the texture array, one sampler is kept for the shadow map.
+uint32_t TextureTableCapacity(const VkPhysicalDevice phyDevice, bool bindless) {
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = bindless ? &indexingProperties : nullptr;
+
+    vkGetPhysicalDeviceProperties2(phyDevice, &properties);
+
+    if (!bindless) {
+        const VkPhysicalDeviceLimits &limits = properties.properties.limits;
+        return std::min({8u, limits.maxPerStageDescriptorSamplers - 1, limits.maxPerStageDescriptorSampledImages - 1});
+    }
+
+    return std::min({1024u, indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers - 1,
+                     indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages - 1,
+                     indexingProperties.maxDescriptorSetUpdateAfterBindSamplers - 1,
+                     indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages - 1});
+}
+
+// Build time and fallback use of a pipeline variant, helps to decide which variants to warm at startup
+std::string VariantStatsText(const PipelineVariants::VariantStats &stats) {
+    char text[160];
+    if (stats.ready) {
+        snprintf(text, sizeof(text), "%.2f ms build, %u build(s), %llu fallback frame(s)%s", stats.lastBuildMs,
+                 stats.buildCount, (unsigned long long)stats.fallbackCount, stats.failedCount > 0 ? ", failed" : "");
+    } else if (stats.requested) {
+        snprintf(text, sizeof(text), "building, %llu fallback frame(s)%s", (unsigned long long)stats.fallbackCount,
+                 stats.failedCount > 0 ? ", failed" : "");
+    } else {
+        snprintf(text, sizeof(text), "not used");
+    }
+
+    return text;
+}
+
+// Entries of FrameInfo::models: model matrices which change every frame are read from the uniform ring,
+// so the draws using them can be recorded once
+enum FrameModel : uint32_t {
+    FrameModelStatic = 0, // identity, the push constant model is the whole transform
+    FrameModelCube,
+    FrameModelLightCube,
+    FrameModelCount,
+};
+
+// "PushConstants" block of the scene shaders
+struct DrawConstants {
+    glm::mat4   model;
+    uint32_t    modelSlot;      // FrameModel applied to "model"
+    uint32_t    textureIndex;
+};
+
+// One draw of the scene pass, the pipeline and buffers are bound only when they differ from the previous draw
+struct SceneDraw {
+    VkPipeline      pipeline;       // VK_NULL_HANDLE: the one bound by the pass (shadow map)
+    VkBuffer        vertexBuffer;
+    VkBuffer        indexBuffer;    // VK_NULL_HANDLE: not indexed
+    uint32_t        count;          // vertex or index count
+    DrawConstants   constants;
+};
+
+// Push constant stages of the scene draws
+struct ScenePush {
+    VkPipelineLayout    layout;
+    VkShaderStageFlags  modelStages;
+    VkShaderStageFlags  textureStages;  // 0: no texture index (shadow map)
+};
+
+// Smallest number of draws worth a secondary command buffer
+constexpr size_t kMinDrawsPerChunk = 256;
+
+// Records draws [first, first + count), the pass state (viewport, view/projection, descriptors) must be recorded.
+// Only reads "draws", may run on the recording workers.
+void RecordSceneDraws(const VkCommandBuffer cmdBuffer, const ScenePush &push, const std::vector<SceneDraw> &draws,
+                      size_t first, size_t count) {
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkBuffer boundVertices   = VK_NULL_HANDLE;
+    VkBuffer boundIndices    = VK_NULL_HANDLE;
+
+    for (size_t idx = first; idx < first + count; idx++) {
+        const SceneDraw &draw = draws[idx];
+
+        if (draw.pipeline != VK_NULL_HANDLE && draw.pipeline != boundPipeline) {
+            vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+            boundPipeline = draw.pipeline;
+        }
+
+        vkCmdPushConstants(cmdBuffer, push.layout, push.modelStages, 0, offsetof(DrawConstants, textureIndex),
+                           &draw.constants);
+        if (push.textureStages != 0) {
+            vkCmdPushConstants(cmdBuffer, push.layout, push.textureStages, offsetof(DrawConstants, textureIndex),
+                               sizeof(uint32_t), &draw.constants.textureIndex);
+        }
+
+        if (draw.vertexBuffer != boundVertices) {
+            VkDeviceSize offsets[] = {0};
+            vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &draw.vertexBuffer, offsets);
+            boundVertices = draw.vertexBuffer;
+        }
+
+        if (draw.indexBuffer == VK_NULL_HANDLE) {
+            vkCmdDraw(cmdBuffer, draw.count, 1, 0, 0);
+            continue;
+        }
+
+        if (draw.indexBuffer != boundIndices) {
+            vkCmdBindIndexBuffer(cmdBuffer, draw.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndices = draw.indexBuffer;
+        }
+        vkCmdDrawIndexed(cmdBuffer, draw.count, 1, 0, 0, 0);
+    }
+}
+
 void PrintPhyDeviceInfo(const VkInstance /*instance*/, const VkPhysicalDevice phyDevice) {
     VkPhysicalDeviceProperties properties = {};
     vkGetPhysicalDeviceProperties(phyDevice, &properties);
@@ -225,7 +407,8 @@ void PrintPhyDeviceInfo(const VkInstance /*instance*/, const VkPhysicalDevice ph
 }
 
 VkResult CreateDevice(const VkInstance /*instance*/, const VkPhysicalDevice phyDevice, const uint32_t queueFamilyIdx,
-                      const std::vector<const char *> &extraExtensions, VkDevice *outDevice) {
+                      const std::vector<const char *> &extraExtensions, VkDevice *outDevice,
+                      const void *featureChain = nullptr) {
 
     const std::vector<const char *> swapchainExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
@@ -251,11 +434,13 @@ VkResult CreateDevice(const VkInstance /*instance*/, const VkPhysicalDevice phyD
     }
 
     VkPhysicalDeviceFeatures features = {};
-    features.fillModeNonSolid         = VK_TRUE;
+    features.fillModeNonSolid = VK_TRUE;
+    // Texture array indexed by push constant, FindPhyDevice only selects devices supporting it
+    features.shaderSampledImageArrayDynamicIndexing = allowedFeatures.shaderSampledImageArrayDynamicIndexing;
 
     VkDeviceCreateInfo createInfo = {
         .sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pNext                   = nullptr,
+        .pNext                   = featureChain,
         .flags                   = 0,
         .queueCreateInfoCount    = 1,
         .pQueueCreateInfos       = &queueInfo,
@@ -298,13 +483,12 @@ bool FindGoodSurfaceFormat(const VkPhysicalDevice phyDevice, const VkSurfaceKHR
 
 VkResult CreateSwapchain(const VkPhysicalDevice phyDevice, const VkDevice device, const VkSurfaceKHR surface,
                          const VkSurfaceFormatKHR surfaceFormat, const uint32_t width, const uint32_t height,
-                         VkSwapchainKHR *outSwapchain) {
+                         const VkPresentModeKHR presentMode, VkSwapchainKHR *outSwapchain) {
 
     VkSurfaceCapabilitiesKHR capabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(phyDevice, surface, &capabilities);
 
-    uint32_t imageCount                = capabilities.minImageCount;
-    const VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t imageCount = SelectSwapchainImageCount(capabilities, presentMode);
 
     VkSwapchainCreateInfoKHR createInfo = {
         .sType                 = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -446,6 +630,23 @@ VkResult CreateSimpleRenderPass(const VkDevice device, const VkFormat colorForma
         .pPreserveAttachments    = NULL,
     };
 
+    // A swapchain image is only available once the acquire semaphore, waited at the color attachment
+    // output stage, is signaled: the layout transition of the color attachment must not happen earlier.
+    // The depth attachment is shared by the frames in flight, its clear and transition also wait for the
+    // previous frame's depth writes. The shared MSAA color targets are ordered by the frame's
+    // recordTargetBarrier before the render passes, not by this dependency.
+    const VkSubpassDependency acquireDependency = {
+        .srcSubpass      = VK_SUBPASS_EXTERNAL,
+        .dstSubpass      = 0,
+        .srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                         | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+                         | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dependencyFlags = 0,
+    };
+
     VkRenderPassCreateInfo createInfo = {
         .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         .pNext           = nullptr,
@@ -454,31 +655,13 @@ VkResult CreateSimpleRenderPass(const VkDevice device, const VkFormat colorForma
         .pAttachments    = attachments,
         .subpassCount    = 1,
         .pSubpasses      = &subpass,
-        .dependencyCount = 0,
-        .pDependencies   = NULL,
+        .dependencyCount = 1,
+        .pDependencies   = &acquireDependency,
     };
 
     return vkCreateRenderPass(device, &createInfo, nullptr, outRenderPass);
 }
 
-std::vector<VkCommandBuffer> AllocateCommandBuffers(const VkDevice device, const VkCommandPool cmdPool,
-                                                    const uint32_t count) {
-    std::vector<VkCommandBuffer> cmdBuffers(count, VK_NULL_HANDLE);
-
-    VkCommandBufferAllocateInfo allocInfo = {
-        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .pNext              = nullptr,
-        .commandPool        = cmdPool,
-        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = (uint32_t)cmdBuffers.size(),
-    };
-
-    // TODO: check result
-    vkAllocateCommandBuffers(device, &allocInfo, cmdBuffers.data());
-
-    return cmdBuffers;
-}
-
 void DestroyFramebuffers(const VkDevice device, std::vector<VkFramebuffer> &framebuffers) {
     for (size_t idx = 0; idx < framebuffers.size(); idx++) {
         vkDestroyFramebuffer(device, framebuffers[idx], nullptr);
@@ -521,19 +704,6 @@ std::vector<VkFramebuffer> CreateSimpleFramebuffers(const VkDevice device, const
     return framebuffers;
 }
 
-VkFence CreateFence(const VkDevice device) {
-    VkFenceCreateInfo createInfo = {
-        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-        .pNext = 0,
-        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
-    };
-
-    VkFence fence = VK_NULL_HANDLE;
-    vkCreateFence(device, &createInfo, nullptr, &fence);
-
-    return fence;
-}
-
 VkSemaphore CreateSemaphore(const VkDevice device) {
     VkSemaphoreCreateInfo createInfo = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
@@ -564,250 +734,6 @@ VkResult CreateSimpleDescriptorPool(const VkDevice device, VkDescriptorPool *out
     return vkCreateDescriptorPool(device, &createInfo, nullptr, outDescPool);
 }
 
-VkPipelineLayout CreateEmptyPipelineLayout(const VkDevice device, uint32_t pushConstantSize = 0,
-                                           VkDescriptorSetLayout setLayout = nullptr) {
-
-    VkPushConstantRange pushConstantRange = {
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        .offset     = 0,
-        .size       = pushConstantSize,
-    };
-
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .setLayoutCount         = (uint32_t)(setLayout ? 1 : 0),
-        .pSetLayouts            = &setLayout,
-        .pushConstantRangeCount = (pushConstantSize > 0) ? 1u : 0u,
-        .pPushConstantRanges    = &pushConstantRange,
-    };
-
-    VkPipelineLayout layout = VK_NULL_HANDLE;
-    VkResult result         = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &layout);
-    (void)result;
-
-    return layout;
-}
-
-VkPipeline CreateSimpleVec3Pipeline(const VkDevice device, const VkExtent2D surfaceExtent,
-                                    const VkRenderPass renderPass, const VkPipelineLayout pipelineLayout,
-                                    const VkShaderModule shaderVertex, const VkShaderModule shaderFragment,
-                                    const bool depthTest = false, const bool blendEnable = false,
-                                    VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT) {
-
-    // shader stages
-    VkPipelineShaderStageCreateInfo shaders[] = {{
-                                                     .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                     .pNext  = nullptr,
-                                                     .flags  = 0,
-                                                     .stage  = VK_SHADER_STAGE_VERTEX_BIT,
-                                                     .module = shaderVertex,
-                                                     .pName  = "main",
-                                                     .pSpecializationInfo = nullptr,
-                                                 },
-                                                 {
-                                                     .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                                                     .pNext  = nullptr,
-                                                     .flags  = 0,
-                                                     .stage  = VK_SHADER_STAGE_FRAGMENT_BIT,
-                                                     .module = shaderFragment,
-                                                     .pName  = "main",
-                                                     .pSpecializationInfo = nullptr,
-                                                 }};
-
-    // IMPORTANT!
-    VkVertexInputBindingDescription vertexBinding = {
-        // binding position in Vulkan API, maches the binding in VkVertexInputAttributeDescription
-        .binding   = 0,
-        .stride    = sizeof(float) * (3 + 2 + 3), // step by "vec3 + vec2 + vec3" elements in the attached buffer
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX, // step "stride" bytes each for vertex in the buffer
-    };
-
-    // IMPORTANT!
-    VkVertexInputAttributeDescription vertexAttributes[3] = {
-        {
-            // position
-            .location = 0,                          // layout location=0 in shader
-            .binding  = 0,                          // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32B32_SFLOAT, // use "vec3" values from the buffer
-            .offset   = 0,                          // use buffer from the 0 byte
-        },
-        {
-            // uv
-            .location = 1,                       // layout location=1 in shader
-            .binding  = 0,                       // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32_SFLOAT, // use "vec2" values from the buffer
-            .offset   = sizeof(float) * 3,       // use buffer from the 0 byte
-        },
-        {
-            // normals
-            .location = 2,                          // layout location=2 in shader
-            .binding  = 0,                          // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32B32_SFLOAT, // use "vec3" values from the buffer
-            .offset   = sizeof(float) * (3 + 2),    // use buffer from the 0 byte
-        },
-    };
-
-    // IMPORTANT! related buffer(s) must be bound before draw via vkCmdBindVertexBuffers
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext                           = 0,
-        .flags                           = 0,
-        .vertexBindingDescriptionCount   = 1u,
-        .pVertexBindingDescriptions      = &vertexBinding,
-        .vertexAttributeDescriptionCount = 3u,
-        .pVertexAttributeDescriptions    = vertexAttributes,
-    };
-
-    // input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    // viewport info
-    VkViewport viewport = {
-        .x        = 0,
-        .y        = 0,
-        .width    = float(surfaceExtent.width),
-        .height   = float(surfaceExtent.height),
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f,
-    };
-
-    VkRect2D scissor{
-        .offset = {0, 0},
-        .extent = surfaceExtent,
-    };
-
-    VkPipelineViewportStateCreateInfo viewportInfo = {
-        .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .pNext         = nullptr,
-        .flags         = 0,
-        .viewportCount = 1,
-        .pViewports    = &viewport,
-        .scissorCount  = 1,
-        .pScissors     = &scissor,
-    };
-
-    // rasterization info
-    VkPipelineRasterizationStateCreateInfo rasterizationInfo = {
-        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .pNext                   = nullptr,
-        .flags                   = 0,
-        .depthClampEnable        = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode             = VK_POLYGON_MODE_FILL,
-        .cullMode                = VK_CULL_MODE_NONE, // VK_CULL_MODE_FRONT_BIT,
-        .frontFace               = VK_FRONT_FACE_CLOCKWISE,
-        .depthBiasEnable         = VK_TRUE,
-        .depthBiasConstantFactor = 1.25f, // Disabled
-        .depthBiasClamp          = 0.0f,  // Disabled
-        .depthBiasSlopeFactor    = 1.75f, // Disabled
-        .lineWidth               = 1.0f,
-    };
-
-    // multisample
-    VkPipelineMultisampleStateCreateInfo multisampleInfo = {
-        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext                 = nullptr,
-        .flags                 = 0,
-        .rasterizationSamples  = msaaSamples,
-        .sampleShadingEnable   = VK_FALSE,
-        .minSampleShading      = 0.0f,
-        .pSampleMask           = nullptr,
-        .alphaToCoverageEnable = VK_FALSE,
-        .alphaToOneEnable      = VK_FALSE,
-    };
-
-    // depth stencil
-    // "empty" stencil Op state
-    VkStencilOpState emptyStencilOp = {
-        .failOp      = VK_STENCIL_OP_KEEP,
-        .passOp      = VK_STENCIL_OP_KEEP,
-        .depthFailOp = VK_STENCIL_OP_KEEP,
-        .compareOp   = VK_COMPARE_OP_NEVER,
-        .compareMask = 0,
-        .writeMask   = 0,
-        .reference   = 0,
-    };
-
-    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {
-        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .pNext                 = nullptr,
-        .flags                 = 0,
-        .depthTestEnable       = depthTest ? VK_TRUE : VK_FALSE,
-        .depthWriteEnable      = VK_TRUE,
-        .depthCompareOp        = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable     = VK_FALSE,
-        .front                 = emptyStencilOp,
-        .back                  = emptyStencilOp,
-        .minDepthBounds        = 0.0f,
-        .maxDepthBounds        = 1.0f,
-    };
-
-    // color blend
-    VkPipelineColorBlendAttachmentState blendAttachment = {
-        .blendEnable = blendEnable ? VK_TRUE : VK_FALSE,
-        // as blend is disabled fill these with default values,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA, // VK_BLEND_FACTOR_ZERO, //ONE, //DST_COLOR,
-        .colorBlendOp        = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,  // SRC_ALPHA, //SRC_ALPHA, //VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO, // VK_BLEND_FACTOR_DST_ALPHA, //ZERO,
-        .alphaBlendOp        = VK_BLEND_OP_ADD,
-        // Important!
-        .colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
-
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {
-        .sType         = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .pNext         = nullptr,
-        .flags         = 0,
-        .logicOpEnable = VK_FALSE,          // FALSE,
-        .logicOp       = VK_LOGIC_OP_CLEAR, // Disabled
-        // Important!
-        .attachmentCount = 1,
-        .pAttachments    = &blendAttachment,
-        .blendConstants  = {1.0f, 1.0f, 1.0f, 1.0f}, // Ignored
-    };
-
-    // pipeline create
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
-        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext               = nullptr,
-        .flags               = 0,
-        .stageCount          = 2,
-        .pStages             = shaders,
-        .pVertexInputState   = &vertexInputInfo,
-        .pInputAssemblyState = &inputAssemblyInfo,
-        .pTessellationState  = nullptr,
-        .pViewportState      = &viewportInfo,
-        .pRasterizationState = &rasterizationInfo,
-        .pMultisampleState   = &multisampleInfo,
-        .pDepthStencilState  = &depthStencilInfo,
-        .pColorBlendState    = &colorBlendInfo,
-        .pDynamicState       = nullptr,
-        .layout              = pipelineLayout,
-        .renderPass          = renderPass,
-        .subpass             = 0,
-        .basePipelineHandle  = VK_NULL_HANDLE,
-        .basePipelineIndex   = 0,
-    };
-
-    VkPipeline pipeline = VK_NULL_HANDLE;
-    VkResult result     = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
-    (void)result;
-
-    return pipeline;
-}
-
 uint32_t FindMemoryTypeIndex(const VkPhysicalDevice phyDevice, const VkMemoryRequirements &requirements,
                              VkMemoryPropertyFlags flags) {
     VkPhysicalDeviceMemoryProperties memoryProperties = {};
@@ -891,7 +817,16 @@ void KeyCallback(GLFWwindow *window, int key, int /*scancode*/, int /*action*/,
     }
 }
 
-int main(int /*argc*/, char ** /*argv*/) {
+int main(int argc, char **argv) {
+    // --present-mode=fifo|mailbox|immediate
+    PresentModePolicy presentPolicy = PresentModePolicy::Fifo;
+    for (int idx = 1; idx < argc; idx++) {
+        const char *option = "--present-mode=";
+        if (strncmp(argv[idx], option, strlen(option)) == 0
+            && !ParsePresentModePolicy(argv[idx] + strlen(option), &presentPolicy)) {
+            printf("Unknown present mode: %s (fifo, mailbox or immediate)\n", argv[idx] + strlen(option));
+        }
+    }
 
     if (glfwVulkanSupported()) {
         printf("Failed to look up minimal Vulkan loader/ICD\n!");
@@ -960,16 +895,71 @@ int main(int /*argc*/, char ** /*argv*/) {
     VkPhysicalDevice phyDevice = VK_NULL_HANDLE;
     uint32_t queueFamilyIdx    = -1;
     if (FindPhyDevice(instance, surface, &phyDevice, &queueFamilyIdx) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to find a good device/queue family");
+        throw std::runtime_error("Failed to find a device with a presenting queue family and texture array "
+                                 "dynamic indexing (shaderSampledImageArrayDynamicIndexing)");
     }
 
     PrintPhyDeviceInfo(instance, phyDevice);
 
+    std::vector<const char *> deviceExtensions;
+
+    const bool hasMemoryBudget = HasDeviceExtension(phyDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (hasMemoryBudget) {
+        deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+
+    // Bindless texture array if possible, otherwise a small fully written one
+    const bool useBindless = IsBindlessSupported(phyDevice);
+
+    VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+    indexingFeatures.descriptorBindingPartiallyBound             = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending    = VK_TRUE;
+
+    if (useBindless) {
+        deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    }
+
+    // Cull mode, depth test and blending of the scene pipelines are set while recording if supported
+    ExtendedDynamicState dynamicState = ExtendedDynamicState::Query(phyDevice);
+    dynamicState.AppendExtensions(deviceExtensions);
+
+    // Pipeline variants are linked from shared, separately compiled parts if the device links them fast
+    GraphicsPipelineLibrary pipelineLibrary = GraphicsPipelineLibrary::Query(phyDevice);
+    pipelineLibrary.AppendExtensions(deviceExtensions);
+
+    // GPU progress of the queue is tracked with a timeline semaphore if possible (fences otherwise)
+    TimelineSemaphore timelineSemaphore = TimelineSemaphore::Query(phyDevice);
+    timelineSemaphore.AppendExtensions(deviceExtensions);
+
+    void *featureChain = dynamicState.FeatureChain(useBindless ? &indexingFeatures : nullptr);
+    featureChain       = pipelineLibrary.FeatureChain(featureChain);
+    featureChain       = timelineSemaphore.FeatureChain(featureChain);
+
     VkDevice device = VK_NULL_HANDLE;
-    if (CreateDevice(instance, phyDevice, queueFamilyIdx, {}, &device) != VK_SUCCESS) {
+    if (CreateDevice(instance, phyDevice, queueFamilyIdx, deviceExtensions, &device, featureChain) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create Vulkan Device\n");
     }
 
+    dynamicState.Load(device);
+    timelineSemaphore.Enable(device);
+    printf("Extended dynamic state: %s%s%s\n", dynamicState.HasExtended() ? "1 " : "",
+           dynamicState.HasExtended2() ? "2 " : "", dynamicState.HasColorBlendEnable() ? "3 (color blend)" : "");
+
+    PipelineRegistry::Get(device).UseLibraries(pipelineLibrary.IsSupported());
+    printf("Graphics pipeline library: %s\n", pipelineLibrary.IsSupported() ? "yes" : "no");
+    printf("Timeline semaphore: %s\n", timelineSemaphore.IsSupported() ? "yes" : "no");
+
+    // Shared by every scene pipeline, the rest of their state is covered by the pipelines
+    const std::vector<VkDynamicState> rasterStates = dynamicState.States();
+
+    MemoryArena::Get(phyDevice, device).UseMemoryBudget(hasMemoryBudget);
+
+    // Shared by every pipeline, a warm start skips the shader compilation in the driver
+    PipelineCache pipelineCache;
+    pipelineCache.Load(phyDevice, device, "pipeline_cache.bin");
+
     VkQueue queue = VK_NULL_HANDLE;
     vkGetDeviceQueue(device, queueFamilyIdx, 0, &queue);
 
@@ -979,8 +969,11 @@ int main(int /*argc*/, char ** /*argv*/) {
     VkSurfaceFormatKHR surfaceInfo = {};
     FindGoodSurfaceFormat(phyDevice, surface, preferredFormats, &surfaceInfo);
 
+    const VkPresentModeKHR presentMode = SelectPresentMode(phyDevice, surface, presentPolicy);
+    printf("Present mode: %s\n", PresentModeName(presentMode));
+
     VkSwapchainKHR swapchain = VK_NULL_HANDLE;
-    CreateSwapchain(phyDevice, device, surface, surfaceInfo, windowWidth, windowHeight,
+    CreateSwapchain(phyDevice, device, surface, surfaceInfo, windowWidth, windowHeight, presentMode,
                     &swapchain); // TODO: check result
 
     std::vector<VkImage> swapchainImages    = GetSwapchainImages(device, swapchain);
@@ -989,7 +982,15 @@ int main(int /*argc*/, char ** /*argv*/) {
     VkCommandPool cmdPool = VK_NULL_HANDLE;
     CreateCommandPool(device, queueFamilyIdx, &cmdPool); // TODO: check result
 
-    std::vector<VkCommandBuffer> cmdBuffers = AllocateCommandBuffers(device, cmdPool, swapchainImages.size());
+    // Command buffers and acquire semaphores of the frames the CPU may record ahead of the GPU,
+    // a slot is reused once the queue timeline reached the value of its last submit
+    FramesInFlight frames = FramesInFlight::Create(device, queue, queueFamilyIdx, 2);
+    // Uploads, frames and deferred releases share the values of this counter
+    QueueTimeline &queueTimeline = frames.Timeline();
+    // Secondary command buffers of the passes and draw chunks, recorded on worker threads
+    ParallelRecorder recorder(device, queueFamilyIdx, FramesInFlight::kMaxFrames);
+    // Shadow and color passes recorded once per frame slot, submitted in front of the frame's command buffer
+    ReusableCommands sceneCommands = ReusableCommands::Create(device, queueFamilyIdx, FramesInFlight::kMaxFrames);
 
     VkFormat depthFormat  = VK_FORMAT_D32_SFLOAT_S8_UINT;
     ImageInfo depthInfo   = Create2DImage(phyDevice, device, windowWidth, windowHeight, depthFormat,
@@ -1014,9 +1015,9 @@ int main(int /*argc*/, char ** /*argv*/) {
             .DescriptorPool = descPool,
             .RenderPass     = renderPass,
             .MinImageCount  = 2,
-            .ImageCount     = 2,
+            .ImageCount     = FramesInFlight::kMaxFrames, // ImGui's vertex buffers are cycled per frame in flight
             .MSAASamples    = VK_SAMPLE_COUNT_1_BIT,
-            .PipelineCache  = VK_NULL_HANDLE,
+            .PipelineCache  = pipelineCache.Handle(),
             .Subpass        = 0,
 
             .UseDynamicRendering         = false,
@@ -1037,6 +1038,7 @@ int main(int /*argc*/, char ** /*argv*/) {
     Texture resolvedOutput =
         Texture::Create2D(phyDevice, device, surfaceInfo.format, {windowWidth, windowHeight},
                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
+    SetResourceName(device, VK_OBJECT_TYPE_IMAGE, resolvedOutput.image(), "ResolvedOutput");
     (void)resolvedOutput;
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_4_BIT;
     VkRenderPass colorRenderPass      = VK_NULL_HANDLE;
@@ -1048,75 +1050,152 @@ int main(int /*argc*/, char ** /*argv*/) {
 #include "05_cube_vertices.inc"
     };
 
+    // Static geometry goes to device local memory, every upload is done with a single submit below.
+    StagingUploader uploader = StagingUploader::Create(phyDevice, device, queue, cmdPool);
+
     BufferInfo cubeVertexInfo =
-        BufferInfo::Create(phyDevice, device, sizeof(cubeVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-    cubeVertexInfo.Update(device, cubeVertices, sizeof(cubeVertices));
+        uploader.CreateBuffer(sizeof(cubeVertices), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, cubeVertices);
+    SetResourceName(device, VK_OBJECT_TYPE_BUFFER, cubeVertexInfo.buffer, "Cube-Vertices");
 
-    struct LightInfo {
+    // "FrameInfo" uniform block of the scene shaders (std140)
+    struct FrameInfo {
         glm::mat4 lightSpaceMatrix;
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 cameraPosition;
+        glm::vec4 lightPosition;
+        glm::mat4 models[FrameModelCount];
     };
-    BufferInfo lightInfo =
-        BufferInfo::Create(phyDevice, device, sizeof(cubeVertices), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+    // Per frame uniform data, written without map/unmap and bound via dynamic offsets.
+    FrameRingBuffer uniformRing = FrameRingBuffer::Create(phyDevice, device, 16 * 1024, FramesInFlight::kMaxFrames);
+    SetResourceName(device, VK_OBJECT_TYPE_BUFFER, uniformRing.Buffer(), "UniformRing");
 
-    Mesh cottage = Mesh(std::string("Cottage_FREE.obj").c_str(), phyDevice, device, glm::vec3(0.0f, 0.0f, 0.0f));
+    Mesh cottage = Mesh(std::string("Cottage_FREE.obj").c_str(), uploader, glm::vec3(0.0f, 0.0f, 0.0f));
+    SetResourceName(device, VK_OBJECT_TYPE_BUFFER, cottage.m_bufferInfo.buffer, "Cottage-Vertices");
 
-    // Fill the MVP matrix with identity
-    float MVP[4][4] = {};
+    // Textures are decoded in the background, a placeholder is used until they are uploaded.
+    TextureLoader textureLoader(phyDevice, device, queue, queueFamilyIdx);
 
-    Texture *uvTexture = Texture::LoadFromFile(phyDevice, device, queue, cmdPool, "./images/checker-map_tho.png",
-                                               VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+    TextureHandle uvTexture      = textureLoader.Load("./images/checker-map_tho.png", VK_FORMAT_R8G8B8A8_UNORM);
+    TextureHandle cottageTexture = textureLoader.Load("./Cottage_Clean_Base_Color.png", VK_FORMAT_R8G8B8A8_UNORM);
 
-    Texture *cottageTexture = Texture::LoadFromFile(phyDevice, device, queue, cmdPool, "./Cottage_Clean_Base_Color.png",
-                                                    VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+    // One set for every material: the diffuse textures are selected by the "textureIndex" push constant
+    const uint32_t textureCapacity = TextureTableCapacity(phyDevice, useBindless);
+    printf("Texture table: %u textures (%s)\n", textureCapacity, useBindless ? "bindless" : "fully bound");
+
+    // Every scene pipeline shares one layout: the interface of all of their shaders
+    ShaderReflection sceneReflection =
+        ShaderReflection::Create(SPV_lightning_simple_vert, sizeof(SPV_lightning_simple_vert));
+    sceneReflection.Merge(ShaderReflection::Create(SPV_lightning_no_frag, sizeof(SPV_lightning_no_frag)));
+    sceneReflection.Merge(LightningPass::Reflect());
+    sceneReflection.Merge(ShadowMap::Reflect());
 
     DescriptorMgmt descriptors;
-    descriptors.SetDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1); // diffues texture
-    descriptors.SetDescriptor(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1); // shadow texture
-    descriptors.SetDescriptor(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1);         // lightInfo
+    descriptors.SetDescriptors(sceneReflection, 0); // stages of the shadow texture and frameInfo
+    descriptors.SetDescriptor(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1); // frameInfo, offset per frame
     descriptors.CreateLayout(device);
-    descriptors.CreatePool(device);
-    descriptors.CreateDescriptorSets(device, 2);
+    descriptors.CreatePool(device, 1);
+    descriptors.CreateDescriptorSets(device, 1);
+
+    // The diffuse textures have their own set: an update after bind layout must not contain dynamic buffers
+    DescriptorMgmt textureDescriptors;
+    textureDescriptors.SetDescriptors(sceneReflection, 1); // stages of the diffuse textures
+    if (useBindless) {
+        textureDescriptors.SetBindlessDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity);
+    } else {
+        textureDescriptors.SetDescriptor(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity);
+    }
+    textureDescriptors.CreateLayout(device);
+    textureDescriptors.CreatePool(device, 1);
+    textureDescriptors.CreateDescriptorSets(device, 1);
 
     VkExtent2D surfaceExtent = {(uint32_t)windowWidth, (uint32_t)windowHeight};
-    VkPipelineLayout trianglePipelineLayout =
-        CreateEmptyPipelineLayout(device, sizeof(MVP) * 3 + sizeof(float) * 4 * 2, descriptors.Layout());
-
-    VkShaderModule shaderVertex =
-        CreateShaderModule(device, SPV_lightning_simple_vert, sizeof(SPV_lightning_simple_vert));
-    VkShaderModule shaderFragment = CreateShaderModule(device, SPV_lightning_no_frag, sizeof(SPV_lightning_no_frag));
+    VkPipelineLayout trianglePipelineLayout = VK_NULL_HANDLE;
+    const VkResult layoutResult =
+        LayoutCache::Get(device).Acquire({descriptors.Layout(), textureDescriptors.Layout()},
+                                         sceneReflection.PushConstantRanges(), &trianglePipelineLayout);
+    if (layoutResult != VK_SUCCESS) {
+        printf("[LayoutCache] Scene pipeline layout creation failed (error code: %d)\n", layoutResult);
+        throw std::runtime_error("Failed to create the scene pipeline layout");
+    }
 
-    VkPipeline cubePipeline = CreateSimpleVec3Pipeline(device, surfaceExtent, colorRenderPass, trianglePipelineLayout,
-                                                       shaderVertex, shaderFragment, true, true, msaaSamples);
+    // Each push must list exactly the stages whose push constant range overlaps it
+    const VkShaderStageFlags modelPushFlags   =
+        sceneReflection.PushConstantStages(0, offsetof(DrawConstants, textureIndex));
+    const VkShaderStageFlags texturePushFlags =
+        sceneReflection.PushConstantStages(offsetof(DrawConstants, textureIndex), sizeof(uint32_t));
+
+    // Pipelines are compiled on the workers while the main thread continues with the other resources,
+    // the results are collected before the first frame.
+    PipelineCompiler pipelineCompiler(pipelineCache.Handle());
+
+    // Also used by the shader hot reload
+    auto buildCubePipeline = [&](VkPipelineCache cache) {
+        const std::vector<uint32_t> vertexCode = ShaderCode(SPV_lightning_simple_vert, sizeof(SPV_lightning_simple_vert));
+        const std::vector<uint32_t> fragmentCode = ShaderCode(SPV_lightning_no_frag, sizeof(SPV_lightning_no_frag));
+
+        PipelineBuilder builder;
+        builder.Shader(VK_SHADER_STAGE_VERTEX_BIT, vertexCode.data(), vertexCode.size() * sizeof(uint32_t))
+            .Shader(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentCode.data(), fragmentCode.size() * sizeof(uint32_t))
+            .VertexBinding(0, sizeof(float) * (3 + 2 + 3))                                // "vec3 + vec2 + vec3" per vertex
+            .VertexAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0)                       // position
+            .VertexAttribute(1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3)          // uv
+            .VertexAttribute(2, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * (3 + 2)) // normals
+            .Extent(surfaceExtent)
+            .DepthBias(1.25f, 1.75f)
+            .Samples(msaaSamples)
+            .DynamicState(VK_DYNAMIC_STATE_VIEWPORT)
+            .DynamicState(VK_DYNAMIC_STATE_SCISSOR)
+            .DynamicStates(rasterStates)
+            .Layout(trianglePipelineLayout)
+            .RenderPass(colorRenderPass)
+            .Name("Cube-Pipeline");
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkResult result     = PipelineRegistry::Get(device).Acquire(builder, cache, &pipeline);
+        (void)result;
+
+        return pipeline;
+    };
 
-    // Destroy shader modules, pipeline already created
-    vkDestroyShaderModule(device, shaderVertex, nullptr);
-    vkDestroyShaderModule(device, shaderFragment, nullptr);
+    std::future<VkPipeline> cubePipelineBuild = pipelineCompiler.Compile(buildCubePipeline);
 
     ShadowMap shadowMap;
     shadowMap.Build(phyDevice, device, 2048);
-    shadowMap.BuildPipeline(device, trianglePipelineLayout);
+    std::future<bool> shadowPipelineBuild = pipelineCompiler.Compile([&](VkPipelineCache cache) {
+        return shadowMap.BuildPipeline(device, trianglePipelineLayout, cache);
+    });
 
     VkDescriptorSet depthShowDS = ImGui_ImplVulkan_AddTexture(shadowMap.Depth().sampler(), shadowMap.Depth().view(),
                                                               VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
 
     // color pass output
 
+    // The lighting and post process variants are compiled when first selected, the frames in between
+    // are drawn with an already built pipeline (see PipelineVariants)
     LightningPass lightPass;
-    lightPass.BuildPipeline(device, surfaceExtent, colorRenderPass, trianglePipelineLayout, msaaSamples);
-
-    DescriptorSetMgmt &gridSet = descriptors.Set(0);
-    gridSet.SetImage(0, uvTexture->view(), uvTexture->sampler());
-    gridSet.SetImage(1, shadowMap.Depth().view(), shadowMap.Depth().sampler(),
-                     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-    gridSet.SetBuffer(2, lightInfo.buffer);
-    gridSet.Update(device);
-
-    DescriptorSetMgmt &cottageSet = descriptors.Set(1);
-    cottageSet.SetImage(3, cottageTexture->view(), cottageTexture->sampler());
-    cottageSet.SetImage(1, shadowMap.Depth().view(), shadowMap.Depth().sampler(),
-                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-    cottageSet.SetBuffer(2, lightInfo.buffer);
-    cottageSet.Update(device);
+    lightPass.BuildPipeline(pipelineCompiler, device, surfaceExtent, colorRenderPass, trianglePipelineLayout,
+                            msaaSamples, textureCapacity, rasterStates);
+
+    // Post Process pass, only the default variant is built up front
+    PostProcessPass postProcessPass;
+    postProcessPass.BuildPipeline(pipelineCompiler, device, {windowWidth, windowHeight}, renderPass);
+
+    DescriptorSetMgmt &sceneSet = descriptors.Set(0);
+    sceneSet.SetImage(1, shadowMap.Depth().view(), shadowMap.Depth().sampler(),
+                      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    sceneSet.SetBuffer(2, uniformRing.Buffer(), sizeof(FrameInfo), VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+
+    // Sets 0 and 1 of the scene pipeline layout, bound together by the color pass
+    DescriptorSetMgmt &textureSet      = textureDescriptors.Set(0);
+    const VkDescriptorSet sceneSets[2] = {sceneSet.Get(), textureSet.Get()};
+
+    TextureTable textureTable;
+    textureTable.Init(&textureSet, 0, textureCapacity, useBindless, textureLoader.Placeholder());
+
+    const uint32_t gridTextureIdx    = textureTable.Register(textureLoader.Get(uvTexture));
+    const uint32_t cottageTextureIdx = textureTable.Register(textureLoader.Get(cottageTexture));
+    textureTable.Update(device);
 
     Texture colorOutput =
         Texture::Create2D(phyDevice, device, surfaceInfo.format, {windowWidth, windowHeight},
@@ -1124,15 +1203,27 @@ int main(int /*argc*/, char ** /*argv*/) {
     SetResourceName(device, VK_OBJECT_TYPE_IMAGE, colorOutput.image(), "ColorOutput-ColorImage");
     Texture colorDepth = Texture::Create2D(phyDevice, device, depthFormat, {windowWidth, windowHeight},
                                            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, msaaSamples);
-    SetResourceName(device, VK_OBJECT_TYPE_IMAGE, colorOutput.image(), "ColorOutput-DepthImage");
+    SetResourceName(device, VK_OBJECT_TYPE_IMAGE, colorDepth.image(), "ColorOutput-DepthImage");
 
     std::vector<VkFramebuffer> colorFramebuffers =
         CreateSimpleFramebuffers(device, colorRenderPass, windowWidth, windowHeight, {colorOutput.view()},
                                  colorDepth.view(), resolvedOutput.view());
 
-    // Post Process pass
-    PostProcessPass postProcessPass;
-    postProcessPass.BuildPipeline(device, {windowWidth, windowHeight}, renderPass);
+    // Wait for the pipeline builds
+    VkPipeline cubePipeline = cubePipelineBuild.get();
+    bool pipelinesBuilt = cubePipeline != VK_NULL_HANDLE;
+    pipelinesBuilt &= shadowPipelineBuild.get();
+    postProcessPass.Variants().Wait();
+    pipelinesBuilt &= postProcessPass.Variants().Current(PostProcessPass::VariantIndex(0, false, 0)) != VK_NULL_HANDLE;
+    pipelineCompiler.WaitIdle();
+
+    printf("Pipelines: %u compiled on %u worker(s), %s cache\n", pipelineCompiler.CompletedCount(),
+           pipelineCompiler.WorkerCount(), pipelineCache.IsWarm() ? "warm" : "cold");
+    printf("Pipelines: %u unique, %llu deduplicated, %u libraries\n", PipelineRegistry::Get(device).PipelineCount(),
+           (unsigned long long)PipelineRegistry::Get(device).HitCount(), PipelineRegistry::Get(device).LibraryCount());
+    if (!pipelinesBuilt) {
+        printf("Failed to create some of the pipelines\n");
+    }
 
     postProcessPass.BindInputImage(device, resolvedOutput);
     postProcessPass.BindMSInputImage(device, colorOutput);
@@ -1141,10 +1232,23 @@ int main(int /*argc*/, char ** /*argv*/) {
     // rotate via X axis to have it a plane
     grid.transform = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
     grid.dump();
-    grid.BuildVertices(phyDevice, device);
+    grid.BuildVertices(uploader);
+    SetResourceName(device, VK_OBJECT_TYPE_BUFFER, grid.vertexInfo.buffer, "Grid-Vertices");
+    SetResourceName(device, VK_OBJECT_TYPE_BUFFER, grid.indexInfo.buffer, "Grid-Indices");
+
+    const VkResult uploadResult = uploader.Flush();
+    uploader.Destroy();
+    if (uploadResult != VK_SUCCESS) {
+        printf("[StagingUploader] Static geometry upload failed (error code: %d)\n", uploadResult);
+        throw std::runtime_error("Failed to upload the static geometry");
+    }
 
-    VkFence imageFence           = CreateFence(device);
-    VkSemaphore presentSemaphore = CreateSemaphore(device);
+    // Per swapchain image: a semaphore is only reused once the image is acquired again,
+    // at that point its previous present (which waited on it) is finished
+    std::vector<VkSemaphore> presentSemaphores(swapchainImages.size());
+    for (VkSemaphore &semaphore : presentSemaphores) {
+        semaphore = CreateSemaphore(device);
+    }
 
     glfwShowWindow(window);
 
@@ -1198,9 +1302,164 @@ int main(int /*argc*/, char ** /*argv*/) {
 
     VkPipeline lightPipeline = cubePipeline;
 
+    // Matches the static state of the scene pipelines. Depth bias is enabled for the whole pass: only the
+    // cube pipeline has bias factors, they stay baked and are zero in the lighting pipelines.
+    RasterState sceneRasterState;
+    sceneRasterState.depthBias = true;
+
+    // Shader hot reload: the watched sources are recompiled in the background, the pipelines using
+    // a changed shader are rebuilt on the pipeline compiler and swapped in at the start of a frame.
+    // The reloaded shaders must keep their descriptor and push constant interface.
+    enum ReloadGroup : uint32_t {
+        ReloadCube          = 1 << 0,
+        ReloadLighting      = 1 << 1,
+        ReloadShadowMap     = 1 << 2,
+        ReloadPostProcess   = 1 << 3,
+    };
+
+    struct HotShader {
+        const char*     file;
+        const uint32_t* code;
+        uint32_t        codeSize;
+        uint32_t        groups;
+    };
+
+    const HotShader hotShaders[] = {
+        {"lightning_simple.vert", SPV_lightning_simple_vert, sizeof(SPV_lightning_simple_vert), ReloadCube | ReloadLighting},
+        {"lightning_no.frag", SPV_lightning_no_frag, sizeof(SPV_lightning_no_frag), ReloadCube},
+        {"lightning_simple.frag", SPV_lightning_simple_frag, sizeof(SPV_lightning_simple_frag), ReloadLighting},
+        {"lightning_shadowmap.vert", SPV_lightning_shadowmap_vert, sizeof(SPV_lightning_shadowmap_vert), ReloadLighting},
+        {"lightning_shadowmap.frag", SPV_lightning_shadowmap_frag, sizeof(SPV_lightning_shadowmap_frag), ReloadLighting},
+        {"shadow_map.vert", SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert), ReloadShadowMap},
+        {"shadow_map.frag", SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag), ReloadShadowMap},
+        {"post_process.vert", SPV_post_process_vert, sizeof(SPV_post_process_vert), ReloadPostProcess},
+        {"post_process.frag", SPV_post_process_frag, sizeof(SPV_post_process_frag), ReloadPostProcess},
+    };
+
+    ShaderWatcher shaderWatcher;
+    if (ShaderWatcher::IsSupported()) {
+        for (const HotShader &shader : hotShaders) {
+            shaderWatcher.Watch(std::string(SHADER_SOURCE_DIR) + "/" + shader.file);
+        }
+        shaderWatcher.Start();
+    }
+
+    // The lighting and post process variants are rebuilt by their PipelineVariants
+    struct PipelineReload {
+        std::future<VkPipeline> cube;
+        std::future<VkPipeline> shadowMap;
+
+        bool IsReady() const {
+            auto ready = [](const auto &build) {
+                return !build.valid() || build.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            };
+
+            return ready(cube) && ready(shadowMap);
+        }
+    };
+
+    std::unique_ptr<PipelineReload> pipelineReload;
+    uint32_t pendingReloadGroups = 0;
+
+    // Average frame time per frames in flight setting, to compare the throughput of the settings
+    double frameMsByCount[FramesInFlight::kMaxFrames + 1] = {};
+    int framesInFlight = (int)frames.FrameCount();
+
+    // Draw lists rebuilt every frame, the vectors keep their capacity
+    std::vector<SceneDraw> sceneDraws;
+    std::vector<SceneDraw> shadowDraws;
+    // Extra cubes around the scene to see how the recording scales with the draw count
+    int extraCubeCount = 0;
+    std::vector<glm::mat4> extraCubeTransforms;
+    bool parallelRecording = true;
+    bool reuseScene        = true;
+    double recordMs        = 0.0;
+
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
 
+        // The texture table is rewritten when a streamed texture becomes resident, the frames in flight
+        // still use the descriptors so they are waited for (happens once per streamed batch).
+        if (textureLoader.Update() > 0) {
+            frames.WaitIdle();
+            textureTable.Replace(gridTextureIdx, textureLoader.Get(uvTexture));
+            textureTable.Replace(cottageTextureIdx, textureLoader.Get(cottageTexture));
+            textureTable.Update(device);
+            // The recorded scene passes bound the rewritten set
+            sceneCommands.Invalidate();
+        }
+
+        // Shader hot reload, the replaced pipelines are released once the frames in flight using them are finished
+        for (ShaderWatcher::CompiledShader &compiled : shaderWatcher.TakeCompiled()) {
+            const std::string file = std::filesystem::path(compiled.path).filename().string();
+
+            for (const HotShader &shader : hotShaders) {
+                if (file == shader.file) {
+                    OverrideShaderCode(shader.code, shader.codeSize, std::move(compiled.spirv));
+                    pendingReloadGroups |= shader.groups;
+                }
+            }
+        }
+
+        // The variants keep drawing with their current pipelines until the rebuilt ones are ready
+        if (pendingReloadGroups & ReloadLighting) {
+            lightPass.Variants().Rebuild();
+        }
+        if (pendingReloadGroups & ReloadPostProcess) {
+            postProcessPass.Variants().Rebuild();
+        }
+        pendingReloadGroups &= ~(ReloadLighting | ReloadPostProcess);
+
+        if (!pipelineReload && pendingReloadGroups != 0) {
+            pipelineReload = std::make_unique<PipelineReload>();
+
+            if (pendingReloadGroups & ReloadCube) {
+                pipelineReload->cube = pipelineCompiler.Compile(buildCubePipeline);
+            }
+            if (pendingReloadGroups & ReloadShadowMap) {
+                pipelineReload->shadowMap = pipelineCompiler.Compile([&](VkPipelineCache cache) {
+                    return shadowMap.CreatePipeline(device, trianglePipelineLayout, cache);
+                });
+            }
+
+            pendingReloadGroups = 0;
+        }
+
+        if (pipelineReload && pipelineReload->IsReady()) {
+            // A failed build keeps the previous pipelines
+            std::vector<VkPipeline> retired;
+
+            if (pipelineReload->cube.valid()) {
+                VkPipeline pipeline = pipelineReload->cube.get();
+                if (pipeline != VK_NULL_HANDLE) {
+                    retired.push_back(cubePipeline);
+                    cubePipeline = pipeline;
+                }
+            }
+
+            if (pipelineReload->shadowMap.valid()) {
+                VkPipeline pipeline = pipelineReload->shadowMap.get();
+                if (pipeline != VK_NULL_HANDLE) {
+                    retired.push_back(shadowMap.ReplacePipeline(pipeline));
+                }
+            }
+
+            // Unchanged pipelines are shared with the rebuilt ones, only the last release destroys them
+            for (VkPipeline pipeline : retired) {
+                queueTimeline.Defer([device, pipeline]() { PipelineRegistry::Get(device).Release(pipeline); });
+            }
+
+            pipelineReload.reset();
+            printf("Shader reload finished\n");
+        }
+
+        // Variants replaced by their rebuilt version, not used by the frames recorded from now on
+        for (PipelineVariants *variants : {&lightPass.Variants(), &postProcessPass.Variants()}) {
+            for (VkPipeline pipeline : variants->TakeRetired()) {
+                queueTimeline.Defer([device, pipeline]() { PipelineRegistry::Get(device).Release(pipeline); });
+            }
+        }
+
         {
             float cameraSpeed = static_cast<float>(2.5 * 0.05); // deltaTime);
 
@@ -1299,13 +1558,36 @@ int main(int /*argc*/, char ** /*argv*/) {
             ImGui::SliderInt("Sahder MSAA sample count", &msaaSamples, 1, 4);
             postProcessPass.UseMSAASamples((uint32_t)msaaSamples);
 
-            static int shadow_current            = 0;
-            const char *shadow_options[]         = {"No Lighting", "Simple Lightning", "With Shadow"};
-            static VkPipeline shadow_pipelines[] = {cubePipeline, lightPass.SimplePipeline(),
-                                                    lightPass.ShadowMapPipeline()};
+            static int shadow_current    = 0;
+            const char *shadow_options[] = {"No Lighting", "Simple Lightning", "With Shadow"};
+            ImGui::Combo("Lightning", &shadow_current, shadow_options, IM_ARRAYSIZE(shadow_options));
+
+            // Looked up every frame: a newly selected variant is drawn with the previous one (or the
+            // "No Lighting" cube pipeline) until it is compiled, the shader hot reload may replace the pipelines
+            // and with pipeline libraries the fast linked ones are replaced by their optimized versions
+            const LightningPass::Variant lightVariants[] = {LightningPass::Simple, LightningPass::ShadowMap};
+            lightPipeline = shadow_current == 0 ? cubePipeline
+                                                : lightPass.Pipeline(lightVariants[shadow_current - 1], cubePipeline);
+            lightPipeline = PipelineRegistry::Get(device).Optimized(lightPipeline);
+
+            // No new pipelines needed, the states are set while recording
+            if (dynamicState.HasExtended()) {
+                static int cull_current   = 0;
+                const char *cull_options[] = {"None", "Front", "Back"};
+                const VkCullModeFlags cull_modes[] = {VK_CULL_MODE_NONE, VK_CULL_MODE_FRONT_BIT, VK_CULL_MODE_BACK_BIT};
+
+                ImGui::Combo("Cull mode", &cull_current, cull_options, IM_ARRAYSIZE(cull_options));
+                sceneRasterState.cullMode = cull_modes[cull_current];
+
+                ImGui::Checkbox("Depth test", &sceneRasterState.depthTest);
+            }
+            if (dynamicState.HasColorBlendEnable()) {
+                ImGui::Checkbox("Blending", &sceneRasterState.blendEnable);
+            }
 
-            if (ImGui::Combo("Lightning", &shadow_current, shadow_options, IM_ARRAYSIZE(shadow_options))) {
-                lightPipeline = shadow_pipelines[shadow_current];
+            if (ShaderWatcher::IsSupported()) {
+                ImGui::Text("Shader hot reload: %u compile error(s)%s", shaderWatcher.FailedCount(),
+                            pipelineReload ? ", rebuilding" : "");
             }
 
             static int postMode           = 0;
@@ -1326,6 +1608,52 @@ int main(int /*argc*/, char ** /*argv*/) {
             ImGui::SliderInt("Rotation Z", &rotation.z, 0, 360);
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+            ImGui::Text("Streaming textures: %u pending", textureLoader.PendingCount());
+
+            if (ImGui::CollapsingHeader("Frames in flight")) {
+                ImGui::Text("Present mode: %s (--present-mode=fifo|mailbox|immediate)", PresentModeName(presentMode));
+                if (ImGui::SliderInt("Frames in flight", &framesInFlight, 1, FramesInFlight::kMaxFrames)) {
+                    frames.SetFrameCount((uint32_t)framesInFlight);
+                }
+
+                ImGui::Text("CPU frame %.3f ms, blocked on the GPU %.3f ms", frames.AverageFrameMs(),
+                            frames.AverageWaitMs());
+
+                const uint64_t submitted = queueTimeline.LastSubmitted();
+                ImGui::Text("Queue timeline (%s): submitted %llu, completed %llu, %zu deferred",
+                            queueTimeline.UsesTimelineSemaphore() ? "semaphore" : "fences",
+                            (unsigned long long)submitted, (unsigned long long)queueTimeline.Completed(),
+                            queueTimeline.DeferredCount());
+
+                for (uint32_t count = 1; count <= FramesInFlight::kMaxFrames; count++) {
+                    if (frameMsByCount[count] <= 0.0) {
+                        continue;
+                    }
+
+                    if (frameMsByCount[1] > 0.0) {
+                        ImGui::Text("%u frame(s): %.3f ms/frame, %.2fx the throughput of 1", count,
+                                    frameMsByCount[count], frameMsByCount[1] / frameMsByCount[count]);
+                    } else {
+                        ImGui::Text("%u frame(s): %.3f ms/frame", count, frameMsByCount[count]);
+                    }
+                }
+            }
+
+            if (ImGui::CollapsingHeader("Command recording")) {
+                ImGui::Checkbox("Reuse recorded scene passes", &reuseScene);
+                ImGui::Checkbox("Parallel recording", &parallelRecording);
+                ImGui::SliderInt("Extra cube draws", &extraCubeCount, 0, 50000);
+
+                if (reuseScene) {
+                    ImGui::Text("Recording %.3f ms, scene passes recorded %llu time(s)", recordMs,
+                                (unsigned long long)sceneCommands.RecordCount());
+                } else if (parallelRecording) {
+                    ImGui::Text("Recording %.3f ms, %u secondary buffer(s) on %u thread(s)", recordMs,
+                                recorder.RecordingCount(), recorder.ThreadCount());
+                } else {
+                    ImGui::Text("Recording %.3f ms on the render thread", recordMs);
+                }
+            }
 
             ImGui::InputFloat3("Camera Positon", (float *)&camera.position);
             float cameraRotation[2] = {pitch, yaw};
@@ -1339,16 +1667,108 @@ int main(int /*argc*/, char ** /*argv*/) {
                 ImGui::Image((ImTextureID)depthShowDS, ImVec2(256, 256));
             }
 
+            if (ImGui::CollapsingHeader("Memory")) {
+                const float MiB = 1024.0f * 1024.0f;
+
+                MemoryStats memoryStats;
+                MemoryArena::Get(phyDevice, device).CollectStats(&memoryStats);
+
+                for (uint32_t heapIdx = 0; heapIdx < memoryStats.heaps.size(); heapIdx++) {
+                    const MemoryHeapStats &heap = memoryStats.heaps[heapIdx];
+                    const bool deviceLocal      = heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+                    ImGui::Text("Heap %u (%s, %.0f MiB): used %.2f MiB, allocated %.2f MiB", heapIdx,
+                                deviceLocal ? "device" : "host", heap.size / MiB, heap.usedBytes / MiB,
+                                heap.allocatedBytes / MiB);
+
+                    if (memoryStats.hasBudget) {
+                        ImVec4 color = memoryStats.IsOverBudget(heapIdx) ? ImVec4(1.0f, 0.2f, 0.2f, 1.0f)
+                                                                         : ImVec4(0.6f, 1.0f, 0.6f, 1.0f);
+                        ImGui::TextColored(color, "    process usage %.2f MiB / budget %.2f MiB", heap.usage / MiB,
+                                           heap.budget / MiB);
+                    }
+                }
+
+                for (const MemoryTypeStats &type : memoryStats.types) {
+                    ImGui::Text("Type %u (heap %u, flags 0x%x): %u block(s), %u dedicated, %u resource(s), "
+                                "%.2f / %.2f MiB",
+                                type.memoryTypeIdx, type.heapIdx, type.flags, type.blockCount, type.dedicatedCount,
+                                type.resourceCount, type.usedBytes / MiB, type.allocatedBytes / MiB);
+                }
+
+                if (ImGui::TreeNode("Resources")) {
+                    for (const MemoryResourceStats &resource : memoryStats.resources) {
+                        ImGui::Text("%-28s %8.2f MiB  type %u%s",
+                                    resource.name.empty() ? "<unnamed>" : resource.name.c_str(), resource.size / MiB,
+                                    resource.memoryTypeIdx, resource.dedicated ? "  (dedicated)" : "");
+                    }
+                    ImGui::TreePop();
+                }
+
+                const SamplerCache &samplerCache = SamplerCache::Get(phyDevice, device);
+                ImGui::Text("Samplers: %u / %u (%llu shared request(s))", samplerCache.SamplerCount(),
+                            samplerCache.MaxSamplerCount(), (unsigned long long)samplerCache.HitCount());
+
+                const LayoutCache &layoutCache = LayoutCache::Get(device);
+                ImGui::Text("Layouts: %u set, %u pipeline (%llu shared request(s))", layoutCache.SetLayoutCount(),
+                            layoutCache.PipelineLayoutCount(), (unsigned long long)layoutCache.HitCount());
+
+                const PipelineRegistry &pipelineRegistry = PipelineRegistry::Get(device);
+                ImGui::Text("Pipelines: %u (%llu hit(s), %llu miss(es))", pipelineRegistry.PipelineCount(),
+                            (unsigned long long)pipelineRegistry.HitCount(),
+                            (unsigned long long)pipelineRegistry.MissCount());
+                if (pipelineRegistry.UsesLibraries()) {
+                    ImGui::Text("Pipeline libraries: %u, %u/%u link time optimized", pipelineRegistry.LibraryCount(),
+                                pipelineRegistry.OptimizedCount(), pipelineRegistry.PipelineCount());
+                }
+
+                if (ImGui::TreeNode("Pipeline variants")) {
+                    PipelineVariants &lightVariants = lightPass.Variants();
+                    for (uint32_t idx = 0; idx < lightVariants.VariantCount(); idx++) {
+                        ImGui::Text("Lighting %-22s %s", LightningPass::VariantName(idx),
+                                    VariantStatsText(lightVariants.Stats(idx)).c_str());
+                    }
+
+                    PipelineVariants &postVariants = postProcessPass.Variants();
+                    for (uint32_t idx = 0; idx < postVariants.VariantCount(); idx++) {
+                        ImGui::Text("PostProcess %-19s %s", PostProcessPass::VariantName(idx).c_str(),
+                                    VariantStatsText(postVariants.Stats(idx)).c_str());
+                    }
+
+                    if (ImGui::Button("Warm every variant")) {
+                        lightVariants.WarmAll();
+                        postVariants.WarmAll();
+                    }
+                    ImGui::TreePop();
+                }
+
+                if (ImGui::Button("Dump JSON report")) {
+                    WriteMemoryStatsJson(memoryStats, "memory_report.json");
+                }
+            }
+
             ImGui::End();
 
             ImGui::Render();
         }
 
-        vkResetFences(device, 1, &imageFence);
+        // The only CPU wait of the frame: if the GPU is still executing the frame which used this slot
+        const FramesInFlight::Frame &frame = frames.Begin();
+
+        // Skip the first frames of a setting, they include the wait of the switch
+        if (frames.SampleCount() > 60) {
+            frameMsByCount[frames.FrameCount()] = frames.AverageFrameMs();
+        }
 
-        uint32_t swapchainIdx = -1;
-        vkAcquireNextImageKHR(device, swapchain, 1e9 * 2, VK_NULL_HANDLE, imageFence, &swapchainIdx);
-        vkWaitForFences(device, 1, &imageFence, VK_TRUE, UINT64_MAX);
+        // The image may still be presented, the submit waits for the semaphore instead of the CPU
+        uint32_t swapchainIdx   = -1;
+        VkResult acquireResult  = vkAcquireNextImageKHR(device, swapchain, 1e9 * 2, frame.acquireSemaphore,
+                                                        VK_NULL_HANDLE, &swapchainIdx);
+        if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
+            // Nothing is submitted, the slot stays free
+            printf("Swapchain image acquire failed (error code: %d)\n", acquireResult);
+            continue;
+        }
 
         // Camera info
         camera.Update();
@@ -1357,8 +1777,6 @@ int main(int /*argc*/, char ** /*argv*/) {
         directionalLight.view = glm::lookAt(glm::vec3(directionalLight.position),
                                             glm::vec3(0.0f), // Look at the center of the scene
                                             glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 ll          = directionalLight.projection * directionalLight.view;
-        lightInfo.Update(device, &ll, sizeof(glm::mat4));
 
         // Model update
         glm::mat4 cubeTransform =
@@ -1366,164 +1784,290 @@ int main(int /*argc*/, char ** /*argv*/) {
             glm::rotate(glm::mat4(1.0f), glm::radians((float)rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)) *
             glm::rotate(glm::mat4(1.0f), glm::radians((float)rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
 
-        VkShaderStageFlags pushFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        // Light cube: a smaller cube at the light's position
+        glm::mat4 lightCubeTransform = glm::translate(glm::mat4(1.0f), glm::vec3(directionalLight.position));
+        lightCubeTransform           = glm::scale(lightCubeTransform, glm::vec3(0.2f));
+
+        // Everything which changes from frame to frame, the draws only reference it
+        FrameInfo frameData = {
+            .lightSpaceMatrix = directionalLight.projection * directionalLight.view,
+            .view             = camera.view,
+            .projection       = camera.projection,
+            .cameraPosition   = glm::vec4(camera.position, 1.0f),
+            .lightPosition    = directionalLight.position,
+            .models           = {glm::mat4(1.0f), cubeTransform, lightCubeTransform},
+        };
 
-        VkCommandBuffer cmdBuffer = cmdBuffers[swapchainIdx];
+        // The first allocation of the slot's region: its offset is the same every frame of the slot
+        uniformRing.BeginFrame(frame.index);
+        RingAllocation frameAlloc = uniformRing.Push(&frameData, sizeof(frameData));
+        uint32_t frameOffset      = frameAlloc.DynamicOffset();
+        uniformRing.Flush();
 
-        {
-            VkCommandBufferBeginInfo beginInfo = {
-                .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                .pNext            = nullptr,
-                .flags            = 0,
-                .pInheritanceInfo = nullptr,
-            };
+        if (extraCubeTransforms.size() != (size_t)extraCubeCount) {
+            // A square of small cubes above the scene
+            const uint32_t side = (uint32_t)std::ceil(std::sqrt((double)extraCubeCount));
+            extraCubeTransforms.resize(extraCubeCount);
 
-            vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+            for (uint32_t idx = 0; idx < (uint32_t)extraCubeCount; idx++) {
+                const glm::vec3 position((idx % side - side / 2.0f) * 0.5f, 4.0f, (idx / side - side / 2.0f) * 0.5f);
+                extraCubeTransforms[idx] = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.1f));
+            }
+        }
 
-            // Shadow
-            shadowMap.BeginPass(cmdBuffer);
+        // Resolved on this thread, the recording workers must not look up pipelines
+        const VkPipeline lightCubePipeline = PipelineRegistry::Get(device).Optimized(cubePipeline);
+        const VkPipeline shadowPipeline    = PipelineRegistry::Get(device).Optimized(shadowMap.Pipeline());
+        const VkPipeline postPipeline      = PipelineRegistry::Get(device).Optimized(postProcessPass.Pipeline());
+        ImDrawData *drawData               = ImGui::GetDrawData();
+
+        // Only needed when the scene passes are recorded
+        const auto buildDrawLists = [&]() {
+            sceneDraws.clear();
+            sceneDraws.push_back({lightPipeline, cubeVertexInfo.buffer, VK_NULL_HANDLE, 36,
+                                  {glm::mat4(1.0f), FrameModelCube, gridTextureIdx}});
+            sceneDraws.push_back({lightPipeline, cottage.m_bufferInfo.buffer, VK_NULL_HANDLE,
+                                  (uint32_t)cottage.m_vertices.size(),
+                                  {glm::mat4(1.0f), FrameModelStatic, cottageTextureIdx}});
+            sceneDraws.push_back({lightPipeline, grid.vertexInfo.buffer, grid.indexInfo.buffer,
+                                  (uint32_t)grid.indices.size(), {grid.transform, FrameModelStatic, gridTextureIdx}});
+            for (const glm::mat4 &transform : extraCubeTransforms) {
+                sceneDraws.push_back({lightPipeline, cubeVertexInfo.buffer, VK_NULL_HANDLE, 36,
+                                      {transform, FrameModelStatic, gridTextureIdx}});
+            }
+            sceneDraws.push_back({lightCubePipeline, cubeVertexInfo.buffer, VK_NULL_HANDLE, 36,
+                                  {glm::mat4(1.0f), FrameModelLightCube, gridTextureIdx}});
+
+            // The grid does not cast shadows, the shadow map pipeline is bound by the pass
+            shadowDraws.clear();
+            shadowDraws.push_back(
+                {VK_NULL_HANDLE, cubeVertexInfo.buffer, VK_NULL_HANDLE, 36, {glm::mat4(1.0f), FrameModelCube, 0}});
+            for (const glm::mat4 &transform : extraCubeTransforms) {
+                shadowDraws.push_back(
+                    {VK_NULL_HANDLE, cubeVertexInfo.buffer, VK_NULL_HANDLE, 36, {transform, FrameModelStatic, 0}});
+            }
+        };
+
+        const ScenePush shadowPush = {trianglePipelineLayout, modelPushFlags, 0};
+        const ScenePush scenePush  = {trianglePipelineLayout, modelPushFlags, texturePushFlags};
+
+        VkClearValue clears[2];
+        clears[0].color        = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clears[1].depthStencil = {1.0f, 0};
+
+        VkRenderPassBeginInfo colorPassInfo = {
+            .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext       = nullptr,
+            .renderPass  = colorRenderPass,
+            .framebuffer = colorFramebuffers[0],
+            .renderArea =
+                {
+                    .offset = {0, 0},
+                    .extent = {(uint32_t)windowWidth, (uint32_t)windowHeight},
+                },
+            .clearValueCount = 2,
+            .pClearValues    = clears,
+        };
+        VkViewport viewport = {
+            .x        = 0,
+            .y        = 0,
+            .width    = float(surfaceExtent.width),
+            .height   = float(surfaceExtent.height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+        };
 
-            // push basic light view info
-            vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 1 * sizeof(MVP), sizeof(MVP),
-                               &directionalLight.view);
-            vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 2 * sizeof(MVP), sizeof(MVP),
-                               &directionalLight.projection);
+        VkRenderPassBeginInfo finalPassInfo = {
+            .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext       = nullptr,
+            .renderPass  = renderPass,
+            .framebuffer = framebuffers[swapchainIdx],
+            .renderArea =
+                {
+                    .offset = {0, 0},
+                    .extent = {(uint32_t)windowWidth, (uint32_t)windowHeight},
+                },
+            .clearValueCount = 2,
+            .pClearValues    = clears,
+        };
 
-            {
-                // draw the grid
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0 * sizeof(MVP), sizeof(MVP),
-                                   &grid.transform);
+        // The passes' contents, recorded into a primary command buffer or into secondaries on the workers.
+        // A secondary inherits no state: each one records the state of its pass before the draws.
+        const auto recordShadow = [&](VkCommandBuffer cmd, size_t first, size_t count) {
+            shadowMap.BindState(cmd, shadowPipeline);
 
-                vkCmdBindIndexBuffer(cmdBuffer, grid.indexInfo.buffer, 0, VK_INDEX_TYPE_UINT32);
+            // The light space matrix and the animated models, the shadow map pipeline does not read the shadow
+            // texture of the set
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1,
+                                    &sceneSet.Get(), 1, &frameOffset);
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &grid.vertexInfo.buffer, offsets);
+            RecordSceneDraws(cmd, shadowPush, shadowDraws, first, count);
+        };
 
-                // vkCmdDrawIndexed(cmdBuffer, grid.indices.size(), 1, 0, 0, 0);
-            }
+        const auto recordColor = [&](VkCommandBuffer cmd, size_t first, size_t count) {
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &colorPassInfo.renderArea);
 
-            { // our main cube
-                // Cube bind and draw
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0 * sizeof(MVP), sizeof(MVP),
-                                   &cubeTransform);
+            // Kept by every scene pipeline, does nothing without extended dynamic state support
+            dynamicState.Apply(cmd, sceneRasterState);
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &cubeVertexInfo.buffer, offsets);
-                vkCmdDraw(cmdBuffer, 36, 1, 0, 0);
-            }
+            // Every draw uses the same sets, only the texture index push constant changes between materials
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 2, sceneSets,
+                                    1, &frameOffset);
 
-            vkCmdEndRenderPass(cmdBuffer);
+            RecordSceneDraws(cmd, scenePush, sceneDraws, first, count);
+        };
 
-            // COLOR pass
-            VkClearValue clears[2];
-            clears[0].color        = {{0.0f, 0.0f, 0.0f, 1.0f}};
-            clears[1].depthStencil = {1.0f, 0};
-
-            VkRenderPassBeginInfo colorPassInfo = {
-                .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .pNext       = nullptr,
-                .renderPass  = colorRenderPass,
-                .framebuffer = colorFramebuffers[0],
-                .renderArea =
-                    {
-                        .offset = {0, 0},
-                        .extent = {(uint32_t)windowWidth, (uint32_t)windowHeight},
-                    },
-                .clearValueCount = 2,
-                .pClearValues    = clears,
+        // The shadow map and the offscreen color targets are shared by the frames in flight:
+        // the previous frame must be done with them before this one writes them again.
+        const auto recordTargetBarrier = [&](VkCommandBuffer cmd) {
+            const VkMemoryBarrier barrier = {
+                .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext         = nullptr,
+                .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                               | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                               | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
             };
-            VkViewport viewport = {
-                .x        = 0,
-                .y        = 0,
-                .width    = float(surfaceExtent.width),
-                .height   = float(surfaceExtent.height),
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
-            };
-            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 
-            vkCmdBeginRenderPass(cmdBuffer, &colorPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+                                     | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+                                     | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+                                     | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        };
+
+        // Shadow and color pass recorded inline
+        const auto recordScene = [&](VkCommandBuffer cmd) {
+            recordTargetBarrier(cmd);
 
-            vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 3 * sizeof(MVP) + sizeof(glm::vec4),
-                               sizeof(directionalLight.position), &directionalLight.position);
+            // Shadow
+            shadowMap.BeginPass(cmd);
+            recordShadow(cmd, 0, shadowDraws.size());
+            vkCmdEndRenderPass(cmd);
 
-            // vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1,
-            //                         &gridSet.Get(), 0, nullptr);
+            // COLOR pass
+            vkCmdBeginRenderPass(cmd, &colorPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            recordColor(cmd, 0, sceneDraws.size());
+            vkCmdEndRenderPass(cmd);
+        };
 
-            // vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1,
-            //                         &cottageSet.Get(), 0, nullptr);
+        const auto recordPostProcess = [&](VkCommandBuffer cmd) {
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &finalPassInfo.renderArea);
 
-            { // our main cube
+            postProcessPass.BindPipeline(cmd, postPipeline);
+            postProcessPass.Draw(cmd);
+        };
 
-                // Cube bind and draw
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0 * sizeof(MVP), sizeof(MVP),
-                                   &cubeTransform);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 1 * sizeof(MVP), sizeof(MVP),
-                                   &camera.view);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 2 * sizeof(MVP), sizeof(MVP),
-                                   &camera.projection);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 3 * sizeof(MVP),
-                                   sizeof(camera.position), &camera.position);
+        const auto recordImGui = [&](VkCommandBuffer cmd) { ImGui_ImplVulkan_RenderDrawData(drawData, cmd); };
+
+        const auto recordStart = std::chrono::steady_clock::now();
+
+        // Reused: the scene passes are submitted in front of the frame's command buffer and only recorded again
+        // if one of their inputs changed, the camera, light and animation are in "frameData"
+        VkCommandBuffer sceneCmdBuffer = VK_NULL_HANDLE;
+        if (reuseScene) {
+            // The generation: a rebuilt pipeline may get the handle of a destroyed one
+            const ReusableCommands::Key sceneKey = {
+                PipelineRegistry::Get(device).ReleaseGeneration(),
+                (uint64_t)lightPipeline,
+                (uint64_t)lightCubePipeline,
+                (uint64_t)shadowPipeline,
+                (uint64_t)sceneRasterState.cullMode,
+                (uint64_t)sceneRasterState.frontFace,
+                (uint64_t)sceneRasterState.depthTest,
+                (uint64_t)sceneRasterState.depthWrite,
+                (uint64_t)sceneRasterState.depthCompareOp,
+                (uint64_t)sceneRasterState.depthBias,
+                (uint64_t)sceneRasterState.blendEnable,
+                (uint64_t)extraCubeCount,
+                frameOffset,
+            };
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &cubeVertexInfo.buffer, offsets);
-                vkCmdDraw(cmdBuffer, 36, 1, 0, 0);
-            }
+            sceneCmdBuffer = sceneCommands.Get(frame.index, sceneKey, [&](VkCommandBuffer cmd) {
+                buildDrawLists();
+                recordScene(cmd);
+            });
+        }
+
+        // Recorded every frame: not reused (or its recording failed)
+        if (sceneCmdBuffer == VK_NULL_HANDLE) {
+            buildDrawLists();
+        }
+
+        // Only the per frame recording is split, the reused one is rarely recorded
+        const bool useSecondaries = parallelRecording && sceneCmdBuffer == VK_NULL_HANDLE;
 
-            { // cottage
-                vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1,
-                                        &cottageSet.Get(), 0, nullptr);
+        // First secondary command buffer of each pass
+        uint32_t shadowFirst = 0;
+        uint32_t colorFirst  = 0;
+        uint32_t finalFirst  = 0;
 
-                glm::mat4 cottagePos(1.0f);
+        if (useSecondaries) {
+            recorder.BeginFrame(frame.index);
 
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0, sizeof(MVP), &cottagePos);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 1 * sizeof(MVP), sizeof(MVP),
-                                   &camera.view);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 2 * sizeof(MVP), sizeof(MVP),
-                                   &camera.projection);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 3 * sizeof(MVP),
-                                   sizeof(camera.position), &camera.position);
+            // Enough draws per chunk to be worth the pass state, enough chunks to keep every thread busy
+            const size_t threadCount = recorder.ThreadCount();
+            const auto chunkSize     = [&](size_t drawCount) {
+                return std::max(kMinDrawsPerChunk, (drawCount + threadCount - 1) / threadCount);
+            };
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &cottage.m_bufferInfo.buffer, offsets);
-                vkCmdDraw(cmdBuffer, cottage.m_vertices.size(), 1, 0, 0);
+            shadowFirst              = recorder.RecordingCount();
+            const size_t shadowChunk = chunkSize(shadowDraws.size());
+            for (size_t first = 0; first < shadowDraws.size(); first += shadowChunk) {
+                const size_t count = std::min(shadowChunk, shadowDraws.size() - first);
+                recorder.Add(shadowMap.RenderPass(), shadowMap.Framebuffer(),
+                             [&, first, count](VkCommandBuffer cmd) { recordShadow(cmd, first, count); });
             }
 
-            {
+            colorFirst              = recorder.RecordingCount();
+            const size_t colorChunk = chunkSize(sceneDraws.size());
+            for (size_t first = 0; first < sceneDraws.size(); first += colorChunk) {
+                const size_t count = std::min(colorChunk, sceneDraws.size() - first);
+                recorder.Add(colorRenderPass, colorFramebuffers[0],
+                             [&, first, count](VkCommandBuffer cmd) { recordColor(cmd, first, count); });
+            }
 
-                vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, trianglePipelineLayout, 0, 1,
-                                        &gridSet.Get(), 0, nullptr);
+            finalFirst = recorder.RecordingCount();
+            recorder.Add(renderPass, framebuffers[swapchainIdx], recordPostProcess);
+            recorder.Add(renderPass, framebuffers[swapchainIdx], recordImGui);
 
-                // draw the grid
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                  lightPipeline); // lightPass.ShadowMapPipeline());
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0 * sizeof(MVP), sizeof(MVP),
-                                   &grid.transform);
+            recorder.Run();
+        }
 
-                vkCmdBindIndexBuffer(cmdBuffer, grid.indexInfo.buffer, 0, VK_INDEX_TYPE_UINT32);
+        const VkSubpassContents contents =
+            useSecondaries ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &grid.vertexInfo.buffer, offsets);
+        VkCommandBuffer cmdBuffer = frame.cmdBuffer;
 
-                vkCmdDrawIndexed(cmdBuffer, grid.indices.size(), 1, 0, 0, 0);
-            }
+        {
+            VkCommandBufferBeginInfo beginInfo = {
+                .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext            = nullptr,
+                .flags            = 0,
+                .pInheritanceInfo = nullptr,
+            };
 
-            { // our light cube
-                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(directionalLight.position));
-                model           = glm::scale(model, glm::vec3(0.2f)); // a smaller cube
+            vkBeginCommandBuffer(cmdBuffer, &beginInfo);
 
-                // Cube bind and draw
-                vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cubePipeline);
-                vkCmdPushConstants(cmdBuffer, trianglePipelineLayout, pushFlags, 0 * sizeof(MVP), sizeof(MVP), &model);
+            if (useSecondaries) {
+                recordTargetBarrier(cmdBuffer);
 
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &cubeVertexInfo.buffer, offsets);
-                vkCmdDraw(cmdBuffer, 36, 1, 0, 0);
-            }
+                // Shadow
+                shadowMap.BeginPass(cmdBuffer, contents);
+                recorder.Execute(cmdBuffer, shadowFirst, colorFirst - shadowFirst);
+                vkCmdEndRenderPass(cmdBuffer);
 
-            vkCmdEndRenderPass(cmdBuffer);
+                // COLOR pass
+                vkCmdBeginRenderPass(cmdBuffer, &colorPassInfo, contents);
+                recorder.Execute(cmdBuffer, colorFirst, finalFirst - colorFirst);
+                vkCmdEndRenderPass(cmdBuffer);
+            } else if (sceneCmdBuffer == VK_NULL_HANDLE) {
+                recordScene(cmdBuffer);
+            }
 
             // Post Process pass
 
@@ -1545,58 +2089,50 @@ int main(int /*argc*/, char ** /*argv*/) {
             vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL,
                                  0, NULL, 2, imageMemoryBarrier);
 
-            VkRenderPassBeginInfo finalPassInfo = {
-                .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .pNext       = nullptr,
-                .renderPass  = renderPass,
-                .framebuffer = framebuffers[swapchainIdx],
-                .renderArea =
-                    {
-                        .offset = {0, 0},
-                        .extent = {(uint32_t)windowWidth, (uint32_t)windowHeight},
-                    },
-                .clearValueCount = 2,
-                .pClearValues    = clears,
-            };
-            vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
-
-            vkCmdBeginRenderPass(cmdBuffer, &finalPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-            {
-                postProcessPass.BindPipeline(cmdBuffer);
-                postProcessPass.Draw(cmdBuffer);
-            }
-
-            {
+            vkCmdBeginRenderPass(cmdBuffer, &finalPassInfo, contents);
+            if (useSecondaries) {
+                recorder.Execute(cmdBuffer, finalFirst, recorder.RecordingCount() - finalFirst);
+            } else {
+                recordPostProcess(cmdBuffer);
                 // IMGUI
-                ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmdBuffer);
+                recordImGui(cmdBuffer);
             }
-
             vkCmdEndRenderPass(cmdBuffer);
 
             VkResult endResult = vkEndCommandBuffer(cmdBuffer);
             (void)endResult;
         }
 
+        const std::chrono::duration<double, std::milli> recordTime = std::chrono::steady_clock::now() - recordStart;
+        recordMs += (recordTime.count() - recordMs) * 0.05;
+
+        // The reused scene passes run first, in submission order
+        const VkCommandBuffer submitCmdBuffers[] = {sceneCmdBuffer, cmdBuffer};
+        const uint32_t submitFirst               = sceneCmdBuffer != VK_NULL_HANDLE ? 0 : 1;
+
+        // The wait holds every color attachment output of the batch (the offscreen passes too) until the image
+        // is acquired, vertex work and the depth only shadow pass may start earlier
+        const VkPipelineStageFlags acquireWaitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
         VkSubmitInfo submitInfo = {
             .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext                = nullptr,
-            .waitSemaphoreCount   = 0,
-            .pWaitSemaphores      = nullptr,
-            .pWaitDstStageMask    = nullptr,
-            .commandBufferCount   = 1,
-            .pCommandBuffers      = &cmdBuffer,
+            .waitSemaphoreCount   = 1,
+            .pWaitSemaphores      = &frame.acquireSemaphore,
+            .pWaitDstStageMask    = &acquireWaitStage,
+            .commandBufferCount   = 2 - submitFirst,
+            .pCommandBuffers      = &submitCmdBuffers[submitFirst],
             .signalSemaphoreCount = 1,
-            .pSignalSemaphores    = &presentSemaphore,
+            .pSignalSemaphores    = &presentSemaphores[swapchainIdx],
         };
 
-        vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        frames.Submit(submitInfo);
 
         VkPresentInfoKHR presentInfo = {
             .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
             .pNext              = 0,
             .waitSemaphoreCount = 1,
-            .pWaitSemaphores    = &presentSemaphore,
+            .pWaitSemaphores    = &presentSemaphores[swapchainIdx],
             .swapchainCount     = 1,
             .pSwapchains        = &swapchain,
             .pImageIndices      = &swapchainIdx,
@@ -1604,8 +2140,15 @@ int main(int /*argc*/, char ** /*argv*/) {
         };
 
         vkQueuePresentKHR(queue, &presentInfo);
+    }
 
-        vkDeviceWaitIdle(device);
+    // Runs the deferred releases too
+    frames.WaitIdle();
+
+    for (uint32_t count = 1; count <= FramesInFlight::kMaxFrames; count++) {
+        if (frameMsByCount[count] > 0.0) {
+            printf("Frames in flight %u: %.3f ms/frame\n", count, frameMsByCount[count]);
+        }
     }
 
     {
@@ -1614,11 +2157,40 @@ int main(int /*argc*/, char ** /*argv*/) {
         ImGui::DestroyContext();
     }
 
-    vkDestroyFence(device, imageFence, nullptr);
-    vkDestroySemaphore(device, presentSemaphore, nullptr);
+    // Candidates for warming at startup: the variants used in this run and what they cost
+    for (uint32_t idx = 0; idx < lightPass.Variants().VariantCount(); idx++) {
+        if (lightPass.Variants().Stats(idx).requested) {
+            printf("Variant Lighting %s: %s\n", LightningPass::VariantName(idx),
+                   VariantStatsText(lightPass.Variants().Stats(idx)).c_str());
+        }
+    }
+    for (uint32_t idx = 0; idx < postProcessPass.Variants().VariantCount(); idx++) {
+        if (postProcessPass.Variants().Stats(idx).requested) {
+            printf("Variant PostProcess %s: %s\n", PostProcessPass::VariantName(idx).c_str(),
+                   VariantStatsText(postProcessPass.Variants().Stats(idx)).c_str());
+        }
+    }
 
-    vkDestroyPipeline(device, cubePipeline, nullptr);
-    vkDestroyPipelineLayout(device, trianglePipelineLayout, nullptr);
+    shaderWatcher.Stop();
+    if (pipelineReload) {
+        if (pipelineReload->cube.valid()) {
+            PipelineRegistry::Get(device).Release(pipelineReload->cube.get());
+        }
+        if (pipelineReload->shadowMap.valid()) {
+            PipelineRegistry::Get(device).Release(pipelineReload->shadowMap.get());
+        }
+        pipelineReload.reset();
+    }
+
+    for (VkSemaphore semaphore : presentSemaphores) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+    recorder.Destroy();
+    sceneCommands.Destroy();
+    frames.Destroy();
+
+    PipelineRegistry::Get(device).Release(cubePipeline);
+    LayoutCache::Get(device).Release(trianglePipelineLayout);
 
     grid.Destroy(device);
 
@@ -1636,13 +2208,14 @@ int main(int /*argc*/, char ** /*argv*/) {
     vkDestroyDescriptorPool(device, descPool, nullptr);
     vkDestroyCommandPool(device, cmdPool, nullptr);
 
+    textureDescriptors.Destroy(device);
     descriptors.Destroy(device);
-    uvTexture->Destroy(device);
+    textureLoader.Destroy();
 
     shadowMap.Destroy(device);
     lightPass.Destroy(device);
 
-    lightInfo.Destroy(device);
+    uniformRing.Destroy(device);
 
     vkDestroyRenderPass(device, colorRenderPass, nullptr);
     colorOutput.Destroy(device);
@@ -1654,6 +2227,21 @@ int main(int /*argc*/, char ** /*argv*/) {
 
     DestroyImageViews(device, swapchainViews);
     vkDestroySwapchainKHR(device, swapchain, nullptr);
+
+    // Its deferred calls may still release pipelines
+    QueueTimeline::Destroy(device);
+
+    // Finishes the pending optimized links first, they still use the pipeline cache
+    PipelineRegistry::Destroy(device);
+
+    if (!pipelineCache.Save()) {
+        printf("Failed to save the pipeline cache\n");
+    }
+    pipelineCache.Destroy();
+
+    LayoutCache::Destroy(device);
+    SamplerCache::Destroy(device);
+    MemoryArena::Destroy(device);
     vkDestroyDevice(device, nullptr);
     vkDestroySurfaceKHR(instance, surface, nullptr);
 
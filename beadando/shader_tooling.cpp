@@ -1,17 +1,41 @@
 #include "shader_tooling.h"
 
+#include <map>
+#include <mutex>
+
+// Pipelines may be built on worker threads
+static std::mutex s_overridesMutex;
+static std::map<std::vector<uint32_t>, std::vector<uint32_t>> s_overrides;
+
+std::vector<uint32_t> ShaderCode(
+    const uint32_t* SPIRVBinary,
+    uint32_t        SPIRVBinarySize) {
+    // SPIRVBinarySize is in bytes
+    std::vector<uint32_t> code(SPIRVBinary, SPIRVBinary + SPIRVBinarySize / sizeof(uint32_t));
+
+    std::lock_guard<std::mutex> lock(s_overridesMutex);
+    if (!s_overrides.empty()) {
+        auto it = s_overrides.find(code);
+        if (it != s_overrides.end()) {
+            code = it->second;
+        }
+    }
+
+    return code;
+}
+
 VkShaderModule CreateShaderModule(
     const VkDevice  device,
     const uint32_t* SPIRVBinary,
     uint32_t    SPIRVBinarySize) {
-    // SPIRVBinarySize is in bytes
+    const std::vector<uint32_t> code = ShaderCode(SPIRVBinary, SPIRVBinarySize);
 
     VkShaderModuleCreateInfo shaderModuleCreateInfo = {
         .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .pNext    = nullptr,
         .flags    = 0,
-        .codeSize = SPIRVBinarySize,
-        .pCode    = SPIRVBinary,
+        .codeSize = code.size() * sizeof(uint32_t),
+        .pCode    = code.data(),
     };
 
     VkShaderModule shaderModule = VK_NULL_HANDLE;
@@ -20,3 +44,12 @@ VkShaderModule CreateShaderModule(
     return shaderModule;
 }
 
+void OverrideShaderCode(
+    const uint32_t*         originalBinary,
+    uint32_t                originalBinarySize,
+    std::vector<uint32_t>   SPIRVBinary) {
+    std::lock_guard<std::mutex> lock(s_overridesMutex);
+
+    std::vector<uint32_t> key(originalBinary, originalBinary + originalBinarySize / sizeof(uint32_t));
+    s_overrides[std::move(key)] = std::move(SPIRVBinary);
+}
@@ -1,8 +1,23 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include <vulkan/vulkan_core.h>
 
 VkShaderModule CreateShaderModule(
     const VkDevice  device,
     const uint32_t* SPIRVBinary,
     uint32_t        SPIRVBinarySize);
+
+// The code used for the baked "SPIRVBinary": the hot reloaded version if any, a copy of it otherwise.
+std::vector<uint32_t> ShaderCode(
+    const uint32_t* SPIRVBinary,
+    uint32_t        SPIRVBinarySize);
+
+// Hot reload: later CreateShaderModule calls with the baked "originalBinary" use "SPIRVBinary" instead.
+// Baked arrays are matched by content, every translation unit has its own copy of them.
+void OverrideShaderCode(
+    const uint32_t*         originalBinary,
+    uint32_t                originalBinarySize,
+    std::vector<uint32_t>   SPIRVBinary);
@@ -2,6 +2,7 @@
 
 #include <cassert>
 
+#include "pipeline_builder.h"
 #include "shader_tooling.h"
 
 namespace {
@@ -11,6 +12,7 @@ namespace {
 
 
 bool ShadowMap::Build(const VkPhysicalDevice phyDevice, const VkDevice device, uint32_t size) {
+    m_device = device;
     m_extent = { size, size };
 
     m_shadowDepth = Texture::Create2D(phyDevice, device, m_depthFormat, m_extent,
@@ -22,224 +24,53 @@ bool ShadowMap::Build(const VkPhysicalDevice phyDevice, const VkDevice device, u
     return true;
 }
 
-bool ShadowMap::BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineLayout) {
-    VkShaderModule shaderVertex     = CreateShaderModule(device, SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert));
-    VkShaderModule shaderFragment   = CreateShaderModule(device, SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag));
-
-    // shader stages
-    VkPipelineShaderStageCreateInfo shaders[] = {
-        {
-            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext                  = nullptr,
-            .flags                  = 0,
-            .stage                  = VK_SHADER_STAGE_VERTEX_BIT,
-            .module                 = shaderVertex,
-            .pName                  = "main",
-            .pSpecializationInfo    = nullptr,
-        },
-        {
-            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .pNext                  = nullptr,
-            .flags                  = 0,
-            .stage                  = VK_SHADER_STAGE_FRAGMENT_BIT,
-            .module                 = shaderFragment,
-            .pName                  = "main",
-            .pSpecializationInfo    = nullptr,
-        }
-    };
-
-    // Vertex Infor information must match across all objects!
-    // IMPORTANT!
-    VkVertexInputBindingDescription vertexBinding = {
-        // binding position in Vulkan API, maches the binding in VkVertexInputAttributeDescription
-        .binding   = 0,
-        .stride    = sizeof(float) * (3 + 2 + 3), // step by "vec3 + vec2 + vec3" elements in the attached buffer
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX, // step "stride" bytes each for vertex in the buffer
-    };
-
-    // IMPORTANT!
-    VkVertexInputAttributeDescription vertexAttributes[3] = {
-        {   // position
-            .location = 0,                          // layout location=0 in shader
-            .binding  = 0,                          // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32B32_SFLOAT, // use "vec3" values from the buffer
-            .offset   = 0,                          // use buffer from the 0 byte
-        },
-        {   // uv
-            .location = 1,                          // layout location=1 in shader
-            .binding  = 0,                          // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32_SFLOAT,    // use "vec2" values from the buffer
-            .offset   = sizeof(float) * 3,          // use buffer from the 0 byte
-        },
-        {   // normals
-            .location = 2,                          // layout location=2 in shader
-            .binding  = 0,                          // binding position in Vulkan API
-            .format   = VK_FORMAT_R32G32B32_SFLOAT, // use "vec3" values from the buffer
-            .offset   = sizeof(float) * (3 + 2),    // use buffer from the 0 byte
-        },
-    };
-
-    // IMPORTANT! related buffer(s) must be bound before draw via vkCmdBindVertexBuffers
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
-        .sType                              = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-        .pNext                              = 0,
-        .flags                              = 0,
-        .vertexBindingDescriptionCount      = 1u,
-        .pVertexBindingDescriptions         = &vertexBinding,
-        .vertexAttributeDescriptionCount    = 3u,
-        .pVertexAttributeDescriptions       = vertexAttributes,
-    };
-
-    // input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .topology               = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-        .primitiveRestartEnable = VK_FALSE,
-    };
-
-    // viewport info
-    VkViewport viewport = {
-        .x          = 0,
-        .y          = 0,
-        .width      = float(m_extent.width),
-        .height     = float(m_extent.height),
-        .minDepth   = 0.0f,
-        .maxDepth   = 1.0f,
-    };
-
-    VkRect2D scissor {
-        .offset = { 0, 0 },
-        .extent = m_extent,
-    };
-
-    VkPipelineViewportStateCreateInfo viewportInfo = {
-        .sType          = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-        .pNext          = nullptr,
-        .flags          = 0,
-        .viewportCount  = 1,
-        .pViewports     = &viewport,
-        .scissorCount   = 1,
-        .pScissors      = &scissor,
-    };
-
-    // rasterization info
-    VkPipelineRasterizationStateCreateInfo rasterizationInfo = {
-        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-        .pNext                   = nullptr,
-        .flags                   = 0,
-        .depthClampEnable        = VK_FALSE,
-        .rasterizerDiscardEnable = VK_FALSE,
-        .polygonMode             = VK_POLYGON_MODE_FILL,
-        .cullMode                = VK_CULL_MODE_NONE, //VK_CULL_MODE_FRONT_BIT,
-        .frontFace               = VK_FRONT_FACE_CLOCKWISE,
-        .depthBiasEnable         = VK_TRUE,  // TASK: Test with true
-        .depthBiasConstantFactor = 1.25f, // Disabled
-        .depthBiasClamp          = 0.0f, // Disabled
-        .depthBiasSlopeFactor    = 1.75f, // Disabled
-        .lineWidth               = 1.0f,
-    };
+ShaderReflection ShadowMap::Reflect() {
+    ShaderReflection reflection = ShaderReflection::Create(SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert));
+    reflection.Merge(ShaderReflection::Create(SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag)));
 
-    // multisample
-    VkPipelineMultisampleStateCreateInfo multisampleInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-        .pNext                  = nullptr,
-        .flags                  = 0,
-        .rasterizationSamples   = VK_SAMPLE_COUNT_1_BIT,
-        .sampleShadingEnable    = VK_FALSE,
-        .minSampleShading       = 0.0f,
-        .pSampleMask            = nullptr,
-        .alphaToCoverageEnable  = VK_FALSE,
-        .alphaToOneEnable       = VK_FALSE,
-    };
-
-    // depth stencil
-    // "empty" stencil Op state
-    VkStencilOpState emptyStencilOp = { }; // Removed memeber init for space
-
-    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {
-        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-        .pNext                 = nullptr,
-        .flags                 = 0,
-        .depthTestEnable       = VK_TRUE, // Depth test is a must!
-        .depthWriteEnable      = VK_TRUE,
-        .depthCompareOp        = VK_COMPARE_OP_LESS,
-        .depthBoundsTestEnable = VK_FALSE,
-        .stencilTestEnable     = VK_FALSE,
-        .front                 = emptyStencilOp,
-        .back                  = emptyStencilOp,
-        .minDepthBounds        = 0.0f,
-        .maxDepthBounds        = 1.0f,
-    };
-
-    // color blend
-    VkPipelineColorBlendAttachmentState blendAttachment = {
-        .blendEnable         = VK_FALSE,
-        // as blend is disabled fill these with default values,
-        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-        .colorBlendOp        = VK_BLEND_OP_ADD,
-        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-        .alphaBlendOp        = VK_BLEND_OP_ADD,
-        // Important!
-        .colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-    };
-
-    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {
-        .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-        .pNext           = nullptr,
-        .flags           = 0,
-        .logicOpEnable   = VK_FALSE,
-        .logicOp         = VK_LOGIC_OP_CLEAR,
-        // Important!
-        .attachmentCount = 1,
-        .pAttachments    = &blendAttachment,
-        .blendConstants  = { 1.0f, 1.0f, 1.0f, 1.0f }, // Ignored
-    };
+    return reflection;
+}
 
-    VkDynamicState dynamicStates[] = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-    };
+bool ShadowMap::BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineLayout,
+                              const VkPipelineCache pipelineCache) {
+    m_pipeline = CreatePipeline(device, pipelineLayout, pipelineCache);
 
-    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {
-        .sType              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-        .pNext              = nullptr,
-        .flags              = 0,
-        .dynamicStateCount  = 1,
-        .pDynamicStates     = dynamicStates,
-    };
-
-    // pipeline create
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
-        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-        .pNext               = nullptr,
-        .flags               = 0,
-        .stageCount          = 2,
-        .pStages             = shaders,
-        .pVertexInputState   = &vertexInputInfo,
-        .pInputAssemblyState = &inputAssemblyInfo,
-        .pTessellationState  = nullptr,
-        .pViewportState      = &viewportInfo,
-        .pRasterizationState = &rasterizationInfo,
-        .pMultisampleState   = &multisampleInfo,
-        .pDepthStencilState  = &depthStencilInfo,
-        .pColorBlendState    = &colorBlendInfo,
-        .pDynamicState       = &dynamicStateInfo,
-        .layout              = pipelineLayout,
-        .renderPass          = m_renderPass,
-        .subpass             = 0,
-        .basePipelineHandle  = VK_NULL_HANDLE,
-        .basePipelineIndex   = 0,
-    };
+    return m_pipeline != VK_NULL_HANDLE;
+}
 
-    VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &m_pipeline);
+VkPipeline ShadowMap::ReplacePipeline(const VkPipeline pipeline) {
+    const VkPipeline oldPipeline = m_pipeline;
+    m_pipeline = pipeline;
 
-    vkDestroyShaderModule(device, shaderVertex, nullptr);
-    vkDestroyShaderModule(device, shaderFragment, nullptr);
+    return oldPipeline;
+}
 
-    return result == VK_SUCCESS;
+VkPipeline ShadowMap::CreatePipeline(const VkDevice device, const VkPipelineLayout pipelineLayout,
+                                     const VkPipelineCache pipelineCache) const {
+    const std::vector<uint32_t> vertexCode   = ShaderCode(SPV_shadow_map_vert, sizeof(SPV_shadow_map_vert));
+    const std::vector<uint32_t> fragmentCode = ShaderCode(SPV_shadow_map_frag, sizeof(SPV_shadow_map_frag));
+
+    PipelineBuilder builder;
+    builder.Shader(VK_SHADER_STAGE_VERTEX_BIT, vertexCode.data(), vertexCode.size() * sizeof(uint32_t))
+           .Shader(VK_SHADER_STAGE_FRAGMENT_BIT, fragmentCode.data(), fragmentCode.size() * sizeof(uint32_t))
+           // Vertex Infor information must match across all objects!
+           .VertexBinding(0, sizeof(float) * (3 + 2 + 3))                    // "vec3 + vec2 + vec3" per vertex
+           .VertexAttribute(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0)                         // position
+           .VertexAttribute(1, 0, VK_FORMAT_R32G32_SFLOAT, sizeof(float) * 3)            // uv
+           .VertexAttribute(2, 0, VK_FORMAT_R32G32B32_SFLOAT, sizeof(float) * (3 + 2))   // normals
+           .Extent(m_extent)
+           .DepthBias(1.25f, 1.75f)
+           .ColorAttachments(0)    // depth only
+           .DynamicState(VK_DYNAMIC_STATE_VIEWPORT)
+           .DynamicState(VK_DYNAMIC_STATE_SCISSOR)
+           .Layout(pipelineLayout)
+           .RenderPass(m_renderPass)
+           .Name("ShadowMap-Pipeline");
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = PipelineRegistry::Get(device).Acquire(builder, pipelineCache, &pipeline);
+
+    return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
 }
 
 
@@ -277,6 +108,18 @@ bool ShadowMap::BuildRenderpass(const VkDevice device) {
         .pPreserveAttachments       = NULL,
     };
 
+    // The shadow map is shared by the frames in flight: the clear and the layout transition must wait
+    // until the previous frame's lighting pass finished sampling it.
+    const VkSubpassDependency readDependency = {
+        .srcSubpass      = VK_SUBPASS_EXTERNAL,
+        .dstSubpass      = 0,
+        .srcStageMask    = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .dstStageMask    = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .srcAccessMask   = 0,
+        .dstAccessMask   = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        .dependencyFlags = 0,
+    };
+
     VkRenderPassCreateInfo createInfo = {
         .sType              = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
         .pNext              = nullptr,
@@ -285,8 +128,8 @@ bool ShadowMap::BuildRenderpass(const VkDevice device) {
         .pAttachments       = attachments,
         .subpassCount       = 1,
         .pSubpasses         = &subpass,
-        .dependencyCount    = 0,
-        .pDependencies      = NULL,
+        .dependencyCount    = 1,
+        .pDependencies      = &readDependency,
     };
 
     return vkCreateRenderPass(device, &createInfo, nullptr, &m_renderPass) == VK_SUCCESS;
@@ -315,12 +158,12 @@ bool ShadowMap::BuildFBO(const VkDevice device) {
 
 void ShadowMap::Destroy(const VkDevice device) {
     m_shadowDepth.Destroy(device);
-    vkDestroyPipeline(device, m_pipeline, nullptr);
+    PipelineRegistry::Get(device).Release(m_pipeline);
     vkDestroyFramebuffer(device, m_framebuffer, nullptr);
     vkDestroyRenderPass(device, m_renderPass, nullptr);
 }
 
-void ShadowMap::BeginPass(const VkCommandBuffer cmdBuffer) {
+void ShadowMap::BeginPass(const VkCommandBuffer cmdBuffer, VkSubpassContents contents) {
     VkClearValue clears[1];
     clears[0].depthStencil = {1.0f, 0};
 
@@ -338,8 +181,13 @@ void ShadowMap::BeginPass(const VkCommandBuffer cmdBuffer) {
         .pClearValues = clears,
     };
 
-    vkCmdBeginRenderPass(cmdBuffer, &shadowRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(cmdBuffer, &shadowRenderPassInfo, contents);
+}
+
+void ShadowMap::BindState(const VkCommandBuffer cmdBuffer, const VkPipeline pipeline) const {
+    const VkRect2D scissor = { { 0, 0 }, m_extent };
 
     vkCmdSetViewport(cmdBuffer, 0, 1, &Viewport());
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline());
+    vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 }
@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include "shader_reflection.h"
 #include "texture.h"
 
 class ShadowMap {
@@ -10,10 +11,19 @@ public:
                const VkDevice device,
                uint32_t size);
 
-    bool BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineLayout);
+    bool BuildPipeline(const VkDevice device, const VkPipelineLayout pipelineLayout,
+                       const VkPipelineCache pipelineCache = VK_NULL_HANDLE);
+    // New pipeline with the pass' current shaders, the pass is not modified (hot reload).
+    VkPipeline CreatePipeline(const VkDevice device, const VkPipelineLayout pipelineLayout,
+                              const VkPipelineCache pipelineCache = VK_NULL_HANDLE) const;
+    // Returns the previous pipeline, the caller releases it (PipelineRegistry) once no frame uses it.
+    VkPipeline ReplacePipeline(const VkPipeline pipeline);
 
     void Destroy(const VkDevice device);
 
+    // Descriptor and push constant interface of the pass' shaders
+    static ShaderReflection Reflect();
+
     VkExtent2D Extent() const { return m_extent; }
     uint32_t Width() const { return m_extent.width; }
     uint32_t Height() const{ return m_extent.height; }
@@ -33,7 +43,14 @@ public:
     VkPipeline Pipeline() const { return m_pipeline; }
     Texture& Depth() { return m_shadowDepth; }
 
-    void BeginPass(const VkCommandBuffer cmdBuffer);
+    VkRenderPass RenderPass() const { return m_renderPass; }
+    VkFramebuffer Framebuffer() const { return m_framebuffer; }
+
+    // The pass state is recorded by BindState, inline or in each secondary command buffer.
+    void BeginPass(const VkCommandBuffer cmdBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+    // Viewport, scissor and "pipeline" (Pipeline() or its optimized version, resolved by the caller once per frame
+    // so every secondary of the pass binds the same one). Safe to record from any thread.
+    void BindState(const VkCommandBuffer cmdBuffer, const VkPipeline pipeline) const;
 
 private:
     bool BuildRenderpass(const VkDevice device);
@@ -41,6 +58,7 @@ private:
 
     const VkFormat  m_depthFormat   = VK_FORMAT_D32_SFLOAT_S8_UINT;
 
+    VkDevice        m_device        = VK_NULL_HANDLE;
     VkExtent2D      m_extent        = { 0, 0 };
     VkPipeline      m_pipeline      = VK_NULL_HANDLE;
     VkRenderPass    m_renderPass    = VK_NULL_HANDLE;
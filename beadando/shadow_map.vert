@@ -12,16 +12,26 @@ layout(location = 2) in vec3 in_normal;
 
 layout(location = 0) out vec3 out_debugcolor;
 
+layout(set = 0, binding = 2) uniform FrameInfo {
+    mat4 lightSpaceMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 cameraPosition;
+    vec4 lightPosition;
+    mat4 models[3];
+} frame;
+
 layout(push_constant) uniform PushConstants {
     layout(offset = 0*4*4*4) mat4 model;
-    layout(offset = 1*4*4*4) mat4 lightView;
-    layout(offset = 2*4*4*4) mat4 lightProjection;
-};
+    layout(offset = 1*4*4*4) uint modelSlot;
+} constants;
 
 void main() {
     vec3 current_pos = in_position;
 
-    gl_Position = lightProjection * lightView * model * vec4(current_pos, 1.0f);
+    mat4 model = frame.models[constants.modelSlot] * constants.model;
+
+    gl_Position = frame.lightSpaceMatrix * model * vec4(current_pos, 1.0f);
 
     out_debugcolor = colors[gl_VertexIndex % 3];
 }
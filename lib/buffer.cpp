@@ -2,29 +2,12 @@
 
 #include <cstring>
 
-static uint32_t FindMemoryTypeIndex(const VkPhysicalDevice phyDevice, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags flags) {
-    VkPhysicalDeviceMemoryProperties memoryProperties = {};
-    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memoryProperties);
-
-    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; idx++) {
-        if (requirements.memoryTypeBits & (1 << idx)) {
-            const VkMemoryType& memoryType = memoryProperties.memoryTypes[idx];
-            // TODO: add size check?
-
-            if (memoryType.propertyFlags & flags) {
-                return idx;
-            }
-        }
-    }
-
-    return (uint32_t)-1;
-}
-
 BufferInfo BufferInfo::Create(
     const VkPhysicalDevice  phyDevice,
     const VkDevice          device,
     VkDeviceSize            size,
-    VkBufferUsageFlags      usageFlags) {
+    VkBufferUsageFlags      usageFlags,
+    VkMemoryPropertyFlags   memoryFlags) {
 
     VkBufferCreateInfo createInfo = {
         .sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -42,35 +25,22 @@ BufferInfo BufferInfo::Create(
     vkCreateBuffer(device, &createInfo, nullptr, &result.buffer);
     // TODO: error check
 
-    VkMemoryRequirements requirements = {};
-    vkGetBufferMemoryRequirements(device, result.buffer, &requirements);
-
-    const uint32_t memoryTypeIdx = FindMemoryTypeIndex(phyDevice, requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    MemoryArena& arena = MemoryArena::Get(phyDevice, device);
+    arena.AllocateForBuffer(result.buffer, memoryFlags, &result.allocation);
     // TODO: check for error
 
-    VkMemoryAllocateInfo allocInfo = {
-        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext           = 0,
-        .allocationSize  = requirements.size,
-        .memoryTypeIndex = memoryTypeIdx,
-    };
-
-    vkAllocateMemory(device, &allocInfo, nullptr, &result.memory);
-
-    vkBindBufferMemory(device, result.buffer, result.memory, 0);
+    result.size = size;
 
     return result;
 }
 
-void* BufferInfo::Map(const VkDevice device) {
-    void* GPUPtr = nullptr;
-    vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &GPUPtr);
-
-    return GPUPtr;
+void* BufferInfo::Map(const VkDevice /*device*/) {
+    // Host visible arena blocks stay mapped, no need for a vkMapMemory call.
+    return allocation.mapped;
 }
 
-void BufferInfo::Unmap(const VkDevice device) {
-    vkUnmapMemory(device, memory);
+void BufferInfo::Unmap(const VkDevice /*device*/) {
+    allocation.arena->Flush(allocation);
 }
 
 void BufferInfo::Update(const VkDevice device, const void* inputPtr, size_t size) {
@@ -83,5 +53,8 @@ void BufferInfo::Update(const VkDevice device, const void* inputPtr, size_t size
 
 void BufferInfo::Destroy(const VkDevice device) {
     vkDestroyBuffer(device, buffer, nullptr);
-    vkFreeMemory(device, memory, nullptr);
+
+    if (allocation.arena) {
+        allocation.arena->Free(allocation);
+    }
 }
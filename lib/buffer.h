@@ -2,13 +2,21 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include "memory_arena.h"
+
 struct BufferInfo {
-    VkDeviceSize   size;
-    VkBuffer       buffer;
-    VkDeviceMemory memory;
+    VkDeviceSize        size;
+    VkBuffer            buffer;
+    MemoryAllocation    allocation;
 
-    static BufferInfo Create(const VkPhysicalDevice phyDevice, const VkDevice device, VkDeviceSize size, VkBufferUsageFlags usageFlags);
+    static BufferInfo Create(
+        const VkPhysicalDevice  phyDevice,
+        const VkDevice          device,
+        VkDeviceSize            size,
+        VkBufferUsageFlags      usageFlags,
+        VkMemoryPropertyFlags   memoryFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
 
+    // Only valid for host visible buffers.
     void* Map(const VkDevice device);
     void Unmap(const VkDevice device);
 
@@ -1,6 +1,8 @@
 #pragma once
 #include <string>
 
+#include "memory_arena.h"
+
 template<typename T>
 void SetResourceName(const VkDevice device, VkObjectType objectType, const T resource, const std::string& name) {
     VkDebugUtilsObjectNameInfoEXT info = {
@@ -17,4 +19,9 @@ void SetResourceName(const VkDevice device, VkObjectType objectType, const T res
         = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(vkGetDeviceProcAddr(device, "vkSetDebugUtilsObjectNameEXT"));
 
     vkSetDebugUtilsObjectNameEXT(device, &info);
+
+    // Memory statistics are reported by resource name.
+    if (objectType == VK_OBJECT_TYPE_BUFFER || objectType == VK_OBJECT_TYPE_IMAGE) {
+        MemoryArena::NameResource(device, info.objectHandle, name);
+    }
 }
@@ -0,0 +1,141 @@
+#include "descriptor_allocator.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// Each new pool doubles in size up to this many sets.
+static constexpr uint32_t kMaxSetsPerPool = 4096;
+
+DescriptorAllocator DescriptorAllocator::Create(
+    const VkDevice                  device,
+    const std::vector<PoolSize>&    poolSizes,
+    uint32_t                        setsPerPool,
+    VkDescriptorPoolCreateFlags     flags) {
+
+    DescriptorAllocator allocator;
+    allocator.m_device      = device;
+    allocator.m_poolSizes   = poolSizes;
+    allocator.m_minSetsPerPool = std::max(setsPerPool, 1u);
+    allocator.m_setsPerPool = allocator.m_minSetsPerPool;
+    allocator.m_flags       = flags;
+
+    return allocator;
+}
+
+VkResult DescriptorAllocator::CreatePool(uint32_t maxSets, VkDescriptorPool* outPool) {
+    std::vector<VkDescriptorPoolSize> sizes;
+    sizes.reserve(m_poolSizes.size());
+
+    for (const PoolSize& poolSize : m_poolSizes) {
+        sizes.push_back({ poolSize.type, poolSize.countPerSet * maxSets });
+    }
+
+    VkDescriptorPoolCreateInfo createInfo = {
+        .sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext          = nullptr,
+        .flags          = m_flags,
+        .maxSets        = maxSets,
+        .poolSizeCount  = (uint32_t)sizes.size(),
+        .pPoolSizes     = sizes.data(),
+    };
+
+    return vkCreateDescriptorPool(m_device, &createInfo, nullptr, outPool);
+}
+
+VkResult DescriptorAllocator::GrabPool(uint32_t setCount) {
+    if (!m_freePools.empty() && setCount <= m_minSetsPerPool) {
+        m_current = m_freePools.back();
+        m_freePools.pop_back();
+    } else {
+        VkResult result = CreatePool(std::max(m_setsPerPool, setCount), &m_current);
+        if (result != VK_SUCCESS) {
+            printf("[DescriptorAllocator] Pool creation failed (error code: %d)\n", result);
+            m_current = VK_NULL_HANDLE;
+            return result;
+        }
+
+        m_setsPerPool = std::min(m_setsPerPool * 2, kMaxSetsPerPool);
+    }
+
+    m_usedPools.push_back(m_current);
+
+    return VK_SUCCESS;
+}
+
+VkResult DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, VkDescriptorSet* outSet) {
+    std::vector<VkDescriptorSet> sets;
+
+    VkResult result = Allocate(std::vector<VkDescriptorSetLayout>{ layout }, &sets);
+    if (result == VK_SUCCESS) {
+        *outSet = sets[0];
+    }
+
+    return result;
+}
+
+VkResult DescriptorAllocator::Allocate(
+    const std::vector<VkDescriptorSetLayout>&   layouts,
+    std::vector<VkDescriptorSet>*               outSets) {
+
+    outSets->assign(layouts.size(), VK_NULL_HANDLE);
+
+    if (m_current == VK_NULL_HANDLE) {
+        VkResult result = GrabPool((uint32_t)layouts.size());
+        if (result != VK_SUCCESS) {
+            return result;
+        }
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .descriptorPool     = m_current,
+        .descriptorSetCount = (uint32_t)layouts.size(),
+        .pSetLayouts        = layouts.data(),
+    };
+
+    VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, outSets->data());
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+        return result;
+    }
+
+    // The current pool is full: continue in a new one
+    result = GrabPool((uint32_t)layouts.size());
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    allocInfo.descriptorPool = m_current;
+
+    result = vkAllocateDescriptorSets(m_device, &allocInfo, outSets->data());
+    if (result != VK_SUCCESS) {
+        printf("[DescriptorAllocator] Allocation of %zu set(s) failed in a new pool (error code: %d)\n",
+               layouts.size(), result);
+    }
+
+    return result;
+}
+
+void DescriptorAllocator::Reset() {
+    for (VkDescriptorPool pool : m_usedPools) {
+        vkResetDescriptorPool(m_device, pool, 0);
+        m_freePools.push_back(pool);
+    }
+
+    m_usedPools.clear();
+    m_current = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::Destroy() {
+    for (VkDescriptorPool pool : m_usedPools) {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+
+    for (VkDescriptorPool pool : m_freePools) {
+        vkDestroyDescriptorPool(m_device, pool, nullptr);
+    }
+
+    m_usedPools.clear();
+    m_freePools.clear();
+    m_current = VK_NULL_HANDLE;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Allocates descriptor sets from a chain of pools, a new pool is added whenever the current one
+// runs out (VK_ERROR_OUT_OF_POOL_MEMORY / VK_ERROR_FRAGMENTED_POOL).
+// Sets are never freed one by one: "Reset" recycles every pool with one vkResetDescriptorPool each.
+// For per-frame sets keep one allocator per frame in flight and reset it once that frame's work finished.
+class DescriptorAllocator {
+public:
+    // Number of descriptors of a type needed by one set.
+    struct PoolSize {
+        VkDescriptorType    type;
+        uint32_t            countPerSet;
+    };
+
+    static DescriptorAllocator Create(
+        const VkDevice                  device,
+        const std::vector<PoolSize>&    poolSizes,
+        uint32_t                        setsPerPool = 16,
+        VkDescriptorPoolCreateFlags     flags = 0);
+
+    VkResult Allocate(VkDescriptorSetLayout layout, VkDescriptorSet* outSet);
+    VkResult Allocate(const std::vector<VkDescriptorSetLayout>& layouts, std::vector<VkDescriptorSet>* outSets);
+
+    // Every set allocated so far becomes invalid.
+    void Reset();
+
+    uint32_t PoolCount() const { return (uint32_t)(m_usedPools.size() + m_freePools.size()); }
+
+    void Destroy();
+
+private:
+    // Makes a pool with room for at least "setCount" sets the current one.
+    VkResult GrabPool(uint32_t setCount);
+    VkResult CreatePool(uint32_t maxSets, VkDescriptorPool* outPool);
+
+    VkDevice                        m_device        = VK_NULL_HANDLE;
+    std::vector<PoolSize>           m_poolSizes;
+    uint32_t                        m_minSetsPerPool = 0;  // every pool holds at least this many sets
+    uint32_t                        m_setsPerPool   = 0;
+    VkDescriptorPoolCreateFlags     m_flags         = 0;
+
+    VkDescriptorPool                m_current       = VK_NULL_HANDLE;
+    std::vector<VkDescriptorPool>   m_usedPools;    // includes "m_current"
+    std::vector<VkDescriptorPool>   m_freePools;
+};
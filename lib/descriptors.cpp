@@ -1,20 +1,48 @@
 #include "descriptors.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+
+#include "layout_cache.h"
+#include "shader_reflection.h"
 
 DescriptorMgmt::DescriptorMgmt() {
 }
 
+static bool IsDynamicBuffer(VkDescriptorType type) {
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+}
+
 void DescriptorMgmt::SetDescriptor(
     uint32_t            bindingIdx,
     VkDescriptorType    type,
-    uint32_t            count) {
+    uint32_t            count,
+    VkShaderStageFlags  stages) {
+
+    // An update after bind layout must not contain dynamic buffers
+    // (VUID-VkDescriptorSetLayoutCreateInfo-descriptorType-03001)
+    if (IsDynamicBuffer(type) && !m_bindingFlags.empty()) {
+        printf("[DescriptorMgmt] Dynamic buffer binding %u can not share a layout with bindless bindings, "
+               "use a separate set\n", bindingIdx);
+        return;
+    }
+
+    // Redeclaring a binding (ex.: a reflected one) keeps its stages unless new ones are given
+    auto existing = m_bindings.find(bindingIdx);
+    if (existing != m_bindings.end()) {
+        m_descTypes[existing->second.descriptorType] -= existing->second.descriptorCount;
+
+        if (stages == 0) {
+            stages = existing->second.stageFlags;
+        }
+    }
 
     VkDescriptorSetLayoutBinding binding = {
         .binding            = bindingIdx,
         .descriptorType     = type,
         .descriptorCount    = count,
-        .stageFlags         = VK_SHADER_STAGE_ALL,
+        .stageFlags         = stages != 0 ? stages : (VkShaderStageFlags)VK_SHADER_STAGE_ALL,
         .pImmutableSamplers = nullptr,
     };
 
@@ -23,33 +51,56 @@ void DescriptorMgmt::SetDescriptor(
     AddDescType(type, count);
 }
 
+void DescriptorMgmt::SetBindlessDescriptor(
+    uint32_t            bindingIdx,
+    VkDescriptorType    type,
+    uint32_t            count,
+    VkShaderStageFlags  stages) {
+
+    for (const std::pair<const uint32_t, VkDescriptorSetLayoutBinding>& entry : m_bindings) {
+        if (entry.first != bindingIdx && IsDynamicBuffer(entry.second.descriptorType)) {
+            printf("[DescriptorMgmt] Bindless binding %u can not share a layout with dynamic buffer binding %u, "
+                   "use a separate set\n", bindingIdx, entry.first);
+            return;
+        }
+    }
+
+    SetDescriptor(bindingIdx, type, count, stages);
+
+    // Unused elements may stay empty, elements not used by pending command buffers can be rewritten any time.
+    m_bindingFlags[bindingIdx] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                               | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                               | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+}
+
+void DescriptorMgmt::SetDescriptors(const ShaderReflection& reflection, uint32_t set) {
+    for (const ReflectedBinding& binding : reflection.Bindings()) {
+        if (binding.set != set) {
+            continue;
+        }
+
+        // Runtime sized arrays need an explicit SetBindlessDescriptor with the real count
+        SetDescriptor(binding.binding, binding.type, binding.count > 0 ? binding.count : 1, binding.stages);
+    }
+}
+
 void DescriptorMgmt::AddDescType(
     VkDescriptorType    type,
     uint32_t            count) {
     m_descTypes[type] += count;
 }
 
-void DescriptorMgmt::CreatePool(const VkDevice device) {
-    std::vector<VkDescriptorPoolSize> poolSizes;
+void DescriptorMgmt::CreatePool(const VkDevice device, uint32_t setsPerPool) {
+    std::vector<DescriptorAllocator::PoolSize> poolSizes;
     poolSizes.reserve(m_descTypes.size());
 
     for (const std::pair<const VkDescriptorType, uint32_t> &entry : m_descTypes) {
         poolSizes.push_back({entry.first, entry.second});
     }
 
-    VkDescriptorPoolCreateInfo createInfo = {
-        .sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext          = nullptr,
-        .flags          = 0,
-        .maxSets        = 4,
-        .poolSizeCount  = (uint32_t)poolSizes.size(),
-        .pPoolSizes     = poolSizes.data(),
-    };
+    const VkDescriptorPoolCreateFlags flags = m_bindingFlags.empty() ? 0 : VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
 
-    VkResult result = vkCreateDescriptorPool(device, &createInfo, nullptr, &m_pool);
-    if (result != VK_SUCCESS) {
-        // TODO: ....
-    }
+    m_allocator = DescriptorAllocator::Create(device, poolSizes, setsPerPool, flags);
 }
 
 VkDescriptorSetLayout DescriptorMgmt::CreateLayout(const VkDevice device) {
@@ -60,57 +111,164 @@ VkDescriptorSetLayout DescriptorMgmt::CreateLayout(const VkDevice device) {
         bindings.push_back(entry.second);
     }
 
+    std::sort(bindings.begin(), bindings.end(),
+              [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+                  return a.binding < b.binding;
+              });
+
+    // Binding flags are only chained if there is a bindless binding
+    std::vector<VkDescriptorBindingFlags> bindingFlags;
+    bindingFlags.reserve(bindings.size());
+
+    for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+        auto it = m_bindingFlags.find(binding.binding);
+        bindingFlags.push_back(it != m_bindingFlags.end() ? it->second : 0);
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+        .sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext          = nullptr,
+        .bindingCount   = (uint32_t)bindingFlags.size(),
+        .pBindingFlags  = bindingFlags.data(),
+    };
+
+    const bool hasBindless = !m_bindingFlags.empty();
+
     VkDescriptorSetLayoutCreateInfo createInfo = {
         .sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .pNext          = nullptr,
-        .flags          = 0,
+        .pNext          = hasBindless ? &bindingFlagsInfo : nullptr,
+        .flags          = hasBindless ? (VkDescriptorSetLayoutCreateFlags)VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0,
         .bindingCount   = (uint32_t)bindings.size(),
         .pBindings      = bindings.data(),
     };
 
-    VkResult result = vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &m_layout);
+    // Identical layouts are shared with the other users of the device
+    VkResult result = LayoutCache::Get(device).Acquire(createInfo, &m_layout);
     if (result != VK_SUCCESS) {
         // TODO: ....
     }
 
+    // Flat slot layout + update template
+
+    std::shared_ptr<DescriptorTemplateLayout> templateLayout = std::make_shared<DescriptorTemplateLayout>();
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    entries.reserve(bindings.size());
+
+    const size_t slotSize = sizeof(VkDescriptorImageInfo) > sizeof(VkDescriptorBufferInfo)
+                          ? sizeof(VkDescriptorImageInfo) : sizeof(VkDescriptorBufferInfo);
+
+    for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+        if (m_bindingFlags.count(binding.binding)) {
+            templateLayout->bindings.push_back({ binding.binding, binding.descriptorType, binding.descriptorCount, 0, true });
+            continue;
+        }
+
+        templateLayout->bindings.push_back({
+            binding.binding, binding.descriptorType, binding.descriptorCount, templateLayout->slotCount, false });
+
+        entries.push_back({
+            .dstBinding         = binding.binding,
+            .dstArrayElement    = 0,
+            .descriptorCount    = binding.descriptorCount,
+            .descriptorType     = binding.descriptorType,
+            .offset             = templateLayout->slotCount * slotSize,
+            .stride             = slotSize,
+        });
+
+        templateLayout->slotCount += binding.descriptorCount;
+        templateLayout->templatedCount++;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo templateInfo = {
+        .sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO,
+        .pNext                      = nullptr,
+        .flags                      = 0,
+        .descriptorUpdateEntryCount = (uint32_t)entries.size(),
+        .pDescriptorUpdateEntries   = entries.data(),
+        .templateType               = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET,
+        .descriptorSetLayout        = m_layout,
+        .pipelineBindPoint          = VK_PIPELINE_BIND_POINT_GRAPHICS,  // ignored for DESCRIPTOR_SET templates
+        .pipelineLayout             = VK_NULL_HANDLE,
+        .set                        = 0,
+    };
+
+    result = vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &templateLayout->updateTemplate);
+    if (result != VK_SUCCESS) {
+        printf("[DescriptorMgmt] Update template creation failed (error code: %d), using plain writes\n", result);
+        templateLayout->updateTemplate = VK_NULL_HANDLE;
+    }
+
+    m_templateLayout = templateLayout;
+
     return m_layout;
 }
 
-void DescriptorMgmt::CreateDescriptorSets(const VkDevice device, uint32_t count) {
-    assert(m_pool != VK_NULL_HANDLE);
+void DescriptorMgmt::CreateDescriptorSets(const VkDevice /*device*/, uint32_t count) {
     assert(m_layout != VK_NULL_HANDLE);
 
     std::vector<VkDescriptorSetLayout> layouts(count, m_layout);
+    std::vector<VkDescriptorSet> sets;
 
-    VkDescriptorSetAllocateInfo createInfo = {
-        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-        .pNext              = nullptr,
-        .descriptorPool     = m_pool,
-        .descriptorSetCount = count,
-        .pSetLayouts        = layouts.data(),
-    };
-
-    std::vector<VkDescriptorSet> sets(count, VK_NULL_HANDLE);
-
-    VkResult result = vkAllocateDescriptorSets(device, &createInfo, sets.data());
+    VkResult result = m_allocator.Allocate(layouts, &sets);
     if (result != VK_SUCCESS) {
         // TODO: ....
+        return;
     }
 
     for (const VkDescriptorSet &set : sets) {
-        m_sets.push_back(DescriptorSetMgmt(set));
+        m_sets.push_back(DescriptorSetMgmt(set, m_templateLayout));
     }
 }
 
 void DescriptorMgmt::Destroy(const VkDevice device) {
-    vkDestroyDescriptorPool(device, m_pool, nullptr);
+    m_allocator.Destroy();
+
+    if (m_templateLayout) {
+        vkDestroyDescriptorUpdateTemplate(device, m_templateLayout->updateTemplate, nullptr);
+        m_templateLayout.reset();
+    }
 
-    vkDestroyDescriptorSetLayout(device, m_layout, nullptr);
+    LayoutCache::Get(device).Release(m_layout);
+    m_layout = VK_NULL_HANDLE;
 }
 
 
-void DescriptorSetMgmt::SetBuffer(uint32_t idx, VkBuffer buffer) {
-    m_bufferInfos[idx] = { buffer, 0, VK_WHOLE_SIZE };
+const DescriptorTemplateLayout::Binding* DescriptorTemplateLayout::Find(uint32_t binding) const {
+    for (const Binding& entry : bindings) {
+        if (entry.binding == binding) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+
+DescriptorSetMgmt::DescriptorSetMgmt(const VkDescriptorSet set, std::shared_ptr<const DescriptorTemplateLayout> layout)
+    : m_set(set)
+    , m_layout(std::move(layout))
+    , m_infos(m_layout->slotCount, DescriptorInfo{})
+    , m_bindingSet(m_layout->bindings.size(), false)
+{}
+
+void DescriptorSetMgmt::SetBuffer(
+    uint32_t            idx,
+    VkBuffer            buffer,
+    VkDeviceSize        range,
+    VkDescriptorType    type) {
+    const DescriptorTemplateLayout::Binding* binding = m_layout->Find(idx);
+    if (binding == nullptr) {
+        printf("[DescriptorSetMgmt] Binding %u is not part of the layout\n", idx);
+        return;
+    }
+
+    if (binding->type != type) {
+        printf("[DescriptorSetMgmt] Binding %u has type %d in the layout, not %d\n", idx, binding->type, type);
+    }
+
+    m_infos[binding->firstSlot].buffer = { buffer, 0, range };
+
+    MarkSet(binding);
 }
 
 void DescriptorSetMgmt::SetImage(
@@ -118,10 +276,83 @@ void DescriptorSetMgmt::SetImage(
     VkImageView   view,
     VkSampler     sampler,
     VkImageLayout layout) {
-    m_imageInfos[idx] = { sampler, view, layout };
+    const DescriptorTemplateLayout::Binding* binding = m_layout->Find(idx);
+    if (binding == nullptr) {
+        printf("[DescriptorSetMgmt] Binding %u is not part of the layout\n", idx);
+        return;
+    }
+
+    SetArrayImage(idx, 0, view, sampler, layout);
+}
+
+void DescriptorSetMgmt::SetArrayImage(
+    uint32_t      idx,
+    uint32_t      arrayElement,
+    VkImageView   view,
+    VkSampler     sampler,
+    VkImageLayout layout) {
+    const DescriptorTemplateLayout::Binding* binding = m_layout->Find(idx);
+    if (binding == nullptr || arrayElement >= binding->count) {
+        printf("[DescriptorSetMgmt] Binding %u element %u is not part of the layout\n", idx, arrayElement);
+        return;
+    }
+
+    if (binding->bindless) {
+        m_arrayWrites.push_back({ idx, arrayElement, binding->type, { sampler, view, layout } });
+        return;
+    }
+
+    m_infos[binding->firstSlot + arrayElement].image = { sampler, view, layout };
+
+    MarkSet(binding);
+}
+
+void DescriptorSetMgmt::MarkSet(const DescriptorTemplateLayout::Binding* binding) {
+    const size_t bindingIdx = binding - m_layout->bindings.data();
+    if (!m_bindingSet[bindingIdx]) {
+        m_bindingSet[bindingIdx] = true;
+        m_setCount++;
+    }
 }
 
 void DescriptorSetMgmt::Update(const VkDevice device) {
+    if (!m_arrayWrites.empty()) {
+        std::vector<VkWriteDescriptorSet> writeInfos;
+        writeInfos.reserve(m_arrayWrites.size());
+
+        for (const ArrayWrite& write : m_arrayWrites) {
+            writeInfos.push_back({
+                .sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext              = nullptr,
+                .dstSet             = m_set,
+                .dstBinding         = write.binding,
+                .dstArrayElement    = write.arrayElement,
+                .descriptorCount    = 1,
+                .descriptorType     = write.type,
+                .pImageInfo         = &write.image,
+                .pBufferInfo        = nullptr,
+                .pTexelBufferView   = nullptr,
+            });
+        }
+
+        vkUpdateDescriptorSets(device, (uint32_t)writeInfos.size(), writeInfos.data(), 0, nullptr);
+        m_arrayWrites.clear();
+    }
+
+    if (m_setCount == 0) {
+        return;
+    }
+
+    // The template writes every binding, unset ones would be invalid descriptors.
+    if (m_layout->updateTemplate != VK_NULL_HANDLE && m_setCount == m_layout->templatedCount) {
+        vkUpdateDescriptorSetWithTemplate(device, m_set, m_layout->updateTemplate, m_infos.data());
+        return;
+    }
+
+    UpdateWithWrites(device);
+}
+
+void DescriptorSetMgmt::UpdateWithWrites(const VkDevice device) {
     VkWriteDescriptorSet baseInfo = {
         .sType              = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .pNext              = nullptr,
@@ -135,30 +366,41 @@ void DescriptorSetMgmt::Update(const VkDevice device) {
         .pTexelBufferView   = nullptr,
     };
 
-    const uint32_t infoCount = (uint32_t)(m_bufferInfos.size() + m_imageInfos.size());
-    std::vector<VkWriteDescriptorSet> writeInfos(infoCount, baseInfo);
-
-    for (const std::pair<const uint32_t, VkDescriptorBufferInfo> &entry : m_bufferInfos) {
-        const uint32_t                  idx = entry.first;
-        const VkDescriptorBufferInfo&   info = entry.second;
-
-        VkWriteDescriptorSet &writeInfo = writeInfos[idx];
-
-        writeInfo.dstBinding     = idx;
-        writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writeInfo.pBufferInfo     = &info;
-    }
-
-    for (const std::pair<const uint32_t, VkDescriptorImageInfo> &entry : m_imageInfos) {
-        const uint32_t                  idx = entry.first;
-        const VkDescriptorImageInfo&    info = entry.second;
-
-        VkWriteDescriptorSet &writeInfo = writeInfos[idx];
-
-        writeInfo.dstBinding     = idx;
-        writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writeInfo.pImageInfo     = &info;
+    // Array bindings are written in one go straight from the slots
+    static_assert(sizeof(DescriptorInfo) == sizeof(VkDescriptorImageInfo), "slot stride must match the image infos");
+    static_assert(sizeof(DescriptorInfo) == sizeof(VkDescriptorBufferInfo), "slot stride must match the buffer infos");
+
+    std::vector<VkWriteDescriptorSet> writeInfos;
+    writeInfos.reserve(m_setCount);
+
+    for (size_t bindingIdx = 0; bindingIdx < m_layout->bindings.size(); bindingIdx++) {
+        if (!m_bindingSet[bindingIdx]) {
+            continue;
+        }
+
+        const DescriptorTemplateLayout::Binding& binding = m_layout->bindings[bindingIdx];
+        const DescriptorInfo& info = m_infos[binding.firstSlot];
+
+        VkWriteDescriptorSet writeInfo = baseInfo;
+        writeInfo.dstBinding      = binding.binding;
+        writeInfo.descriptorCount = binding.count;
+        writeInfo.descriptorType  = binding.type;
+
+        switch (binding.type) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            writeInfo.pImageInfo = &info.image;
+            break;
+        default:
+            writeInfo.pBufferInfo = &info.buffer;
+            break;
+        }
+
+        writeInfos.push_back(writeInfo);
     }
 
-    vkUpdateDescriptorSets(device, infoCount, writeInfos.data(), 0, nullptr);
+    vkUpdateDescriptorSets(device, (uint32_t)writeInfos.size(), writeInfos.data(), 0, nullptr);
 }
@@ -1,22 +1,58 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <unordered_map>
 
 #include <vulkan/vulkan_core.h>
 
+#include "descriptor_allocator.h"
+
 class DescriptorSetMgmt;
+class ShaderReflection;
+
+// Flat storage layout of a set's descriptor data, shared by every set of a DescriptorMgmt.
+// Each binding owns "count" consecutive slots, the update template reads the slots directly.
+// Bindless bindings are left out of the template, their elements are written one by one.
+struct DescriptorTemplateLayout {
+    struct Binding {
+        uint32_t            binding;
+        VkDescriptorType    type;
+        uint32_t            count;
+        uint32_t            firstSlot;
+        bool                bindless;
+    };
+
+    VkDescriptorUpdateTemplate  updateTemplate  = VK_NULL_HANDLE;
+    std::vector<Binding>        bindings;       // sorted by binding number
+    uint32_t                    slotCount       = 0;
+    uint32_t                    templatedCount  = 0;    // bindings written by the template
+
+    const Binding* Find(uint32_t binding) const;
+};
 
 class DescriptorMgmt {
 public:
     DescriptorMgmt();
 
-    void SetDescriptor(uint32_t binding, VkDescriptorType type, uint32_t count = 1);
-
+    // "stages" == 0: the stages of an earlier declaration of the binding (see SetDescriptors),
+    // VK_SHADER_STAGE_ALL for new bindings.
+    void SetDescriptor(uint32_t binding, VkDescriptorType type, uint32_t count = 1, VkShaderStageFlags stages = 0);
+    // Large, partially bound array which can be updated after the set was bound (VK_EXT_descriptor_indexing
+    // with descriptorBindingPartiallyBound and the update after bind feature of the type must be enabled).
+    // Refused if the layout has dynamic buffers: put the bindless bindings into their own set.
+    void SetBindlessDescriptor(uint32_t binding, VkDescriptorType type, uint32_t count, VkShaderStageFlags stages = 0);
+    // Declares every binding of "set" used by the reflected shaders, with the exact stages using them.
+    // Dynamic buffers and array sizes other than the shader's default must be redeclared afterwards.
+    void SetDescriptors(const ShaderReflection& reflection, uint32_t set = 0);
+
+    // Also bakes the bindings into a VkDescriptorUpdateTemplate used by DescriptorSetMgmt::Update.
+    // The layout itself comes from the device's LayoutCache.
     VkDescriptorSetLayout CreateLayout(const VkDevice device);
     VkDescriptorSetLayout Layout() const { return m_layout; }
 
-    void CreatePool(const VkDevice device);
+    // Sized per set of the layout, grows when more sets are requested than the pool holds.
+    void CreatePool(const VkDevice device, uint32_t setsPerPool = 4);
     void CreateDescriptorSets(const VkDevice device, uint32_t count);
 
     DescriptorSetMgmt &Set(uint32_t idx) { return m_sets[idx]; }
@@ -27,31 +63,62 @@ private:
     void AddDescType(VkDescriptorType type, uint32_t count);
 
     std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>  m_bindings;
+    std::unordered_map<uint32_t, VkDescriptorBindingFlags>      m_bindingFlags;
 
     std::unordered_map<VkDescriptorType, uint32_t>              m_descTypes;
     VkDescriptorSetLayout                                       m_layout = VK_NULL_HANDLE;
-    VkDescriptorPool                                            m_pool = VK_NULL_HANDLE;
+    DescriptorAllocator                                         m_allocator;
+    std::shared_ptr<DescriptorTemplateLayout>                   m_templateLayout;
     std::vector<DescriptorSetMgmt>                              m_sets;
 };
 
 class DescriptorSetMgmt {
 public:
-    DescriptorSetMgmt(const VkDescriptorSet set)
-        : m_set(set)
-    {}
+    DescriptorSetMgmt(const VkDescriptorSet set, std::shared_ptr<const DescriptorTemplateLayout> layout);
 
     VkDescriptorSet &Get() { return m_set; }
 
-    void SetBuffer(uint32_t idx, VkBuffer buffer);
+    // Dynamic buffer types need an explicit "range", the offset is given at bind time.
+    // "type" must match the type of the binding in the layout.
+    void SetBuffer(uint32_t         idx,
+                   VkBuffer         buffer,
+                   VkDeviceSize     range = VK_WHOLE_SIZE,
+                   VkDescriptorType type  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
     void SetImage(uint32_t      idx,
                   VkImageView   view,
                   VkSampler     sampler,
                   VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
-
+    // Element of an image array binding. Non bindless arrays must have every element set.
+    void SetArrayImage(uint32_t      idx,
+                       uint32_t      arrayElement,
+                       VkImageView   view,
+                       VkSampler     sampler,
+                       VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL);
+
+    // Once every binding was set this is a single allocation free vkUpdateDescriptorSetWithTemplate,
+    // until then only the bindings set so far are written.
     void Update(const VkDevice device);
 
 private:
-    VkDescriptorSet                                         m_set;
-    std::unordered_map<uint32_t, VkDescriptorBufferInfo>    m_bufferInfos;
-    std::unordered_map<uint32_t, VkDescriptorImageInfo>     m_imageInfos;
+    union DescriptorInfo {
+        VkDescriptorImageInfo   image;
+        VkDescriptorBufferInfo  buffer;
+    };
+
+    struct ArrayWrite {
+        uint32_t                binding;
+        uint32_t                arrayElement;
+        VkDescriptorType        type;
+        VkDescriptorImageInfo   image;
+    };
+
+    void MarkSet(const DescriptorTemplateLayout::Binding* binding);
+    void UpdateWithWrites(const VkDevice device);
+
+    VkDescriptorSet                                     m_set;
+    std::shared_ptr<const DescriptorTemplateLayout>     m_layout;
+    std::vector<DescriptorInfo>                         m_infos;        // one per layout slot
+    std::vector<bool>                                   m_bindingSet;   // per layout binding
+    uint32_t                                            m_setCount = 0;
+    std::vector<ArrayWrite>                             m_arrayWrites;  // pending bindless element writes
 };
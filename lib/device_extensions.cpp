@@ -0,0 +1,33 @@
+#include "device_extensions.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
+
+bool HasDeviceExtension(const VkPhysicalDevice phyDevice, const char* name) {
+    // Holds no Vulkan objects, so it can be destroyed normally at exit
+    static std::mutex s_mutex;
+    static std::map<VkPhysicalDevice, std::vector<VkExtensionProperties>> s_extensions;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    auto it = s_extensions.find(phyDevice);
+    if (it == s_extensions.end()) {
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(phyDevice, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(phyDevice, nullptr, &extensionCount, extensions.data());
+
+        it = s_extensions.emplace(phyDevice, std::move(extensions)).first;
+    }
+
+    for (const VkExtensionProperties& extension : it->second) {
+        if (strcmp(extension.extensionName, name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
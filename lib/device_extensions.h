@@ -0,0 +1,7 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+// Whether "phyDevice" supports the device extension "name".
+// The extension list of a physical device is enumerated once and cached.
+bool HasDeviceExtension(const VkPhysicalDevice phyDevice, const char* name);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// One object per device (or per device and queue), created on first use, for the static Get/Destroy
+// of the per device helpers (MemoryArena, SamplerCache, LayoutCache, PipelineRegistry, QueueTimeline).
+//
+// The objects are intentionally leaked: they must be released via Destroy before the device is destroyed,
+// running their destructors during static destruction would touch an already destroyed device.
+template <typename T, typename Key = VkDevice>
+class DeviceRegistry {
+public:
+    // The object of "key", made with "create" (returning std::unique_ptr<T>) if there is none yet.
+    template <typename Create>
+    static T& Get(const Key& key, const Create& create) {
+        State& state = Instance();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        std::unique_ptr<T>& object = state.objects[key];
+        if (!object) {
+            object = create();
+        }
+
+        return *object;
+    }
+
+    // The object of "key" or nullptr, does not create one.
+    static T* Find(const Key& key) {
+        State& state = Instance();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        auto it = state.objects.find(key);
+        return it != state.objects.end() ? it->second.get() : nullptr;
+    }
+
+    // Destroys every object of "device". The destructors run outside the lock, so they may use the registry.
+    static void Destroy(const VkDevice device) {
+        std::vector<std::unique_ptr<T>> destroyed;
+        {
+            State& state = Instance();
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            for (auto it = state.objects.begin(); it != state.objects.end();) {
+                if (DeviceOf(it->first) == device) {
+                    destroyed.push_back(std::move(it->second));
+                    it = state.objects.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+private:
+    struct State {
+        std::mutex                          mutex;
+        std::map<Key, std::unique_ptr<T>>   objects;
+    };
+
+    static State& Instance() {
+        static auto* state = new State();
+        return *state;
+    }
+
+    static VkDevice DeviceOf(const VkDevice device) { return device; }
+    static VkDevice DeviceOf(const std::pair<VkDevice, VkQueue>& key) { return key.first; }
+};
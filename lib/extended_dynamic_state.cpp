@@ -0,0 +1,146 @@
+#include "extended_dynamic_state.h"
+
+#include "device_extensions.h"
+
+ExtendedDynamicState ExtendedDynamicState::Query(const VkPhysicalDevice phyDevice) {
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT features2 = {};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT features3 = {};
+    features3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+
+    // Only the structures of the supported extensions may be in the chain
+    void* chain = nullptr;
+    if (HasDeviceExtension(phyDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+        features3.pNext = chain;
+        chain = &features3;
+    }
+    if (HasDeviceExtension(phyDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME)) {
+        features2.pNext = chain;
+        chain = &features2;
+    }
+    if (HasDeviceExtension(phyDevice, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+        features.pNext = chain;
+        chain = &features;
+    }
+
+    VkPhysicalDeviceFeatures2 deviceFeatures = {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = chain;
+
+    vkGetPhysicalDeviceFeatures2(phyDevice, &deviceFeatures);
+
+    ExtendedDynamicState result;
+    result.m_extended           = features.extendedDynamicState == VK_TRUE;
+    result.m_extended2          = features2.extendedDynamicState2 == VK_TRUE;
+    result.m_colorBlendEnable   = features3.extendedDynamicState3ColorBlendEnable == VK_TRUE;
+
+    return result;
+}
+
+void ExtendedDynamicState::AppendExtensions(std::vector<const char*>& extensions) const {
+    if (m_extended) {
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+    if (m_extended2) {
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+    }
+    if (m_colorBlendEnable) {
+        extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+    }
+}
+
+void* ExtendedDynamicState::FeatureChain(void* pNext) {
+    // Only the features used by Apply are enabled
+    if (m_colorBlendEnable) {
+        m_features3 = {};
+        m_features3.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+        m_features3.pNext = pNext;
+        m_features3.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+        pNext = &m_features3;
+    }
+    if (m_extended2) {
+        m_features2 = {};
+        m_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+        m_features2.pNext = pNext;
+        m_features2.extendedDynamicState2 = VK_TRUE;
+        pNext = &m_features2;
+    }
+    if (m_extended) {
+        m_features = {};
+        m_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+        m_features.pNext = pNext;
+        m_features.extendedDynamicState = VK_TRUE;
+        pNext = &m_features;
+    }
+
+    return pNext;
+}
+
+#define VK_LOAD_DEVICE_PFN(device, name) reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name))
+
+void ExtendedDynamicState::Load(const VkDevice device) {
+    if (m_extended) {
+        m_cmdSetCullMode        = VK_LOAD_DEVICE_PFN(device, vkCmdSetCullModeEXT);
+        m_cmdSetFrontFace       = VK_LOAD_DEVICE_PFN(device, vkCmdSetFrontFaceEXT);
+        m_cmdSetDepthTest       = VK_LOAD_DEVICE_PFN(device, vkCmdSetDepthTestEnableEXT);
+        m_cmdSetDepthWrite      = VK_LOAD_DEVICE_PFN(device, vkCmdSetDepthWriteEnableEXT);
+        m_cmdSetDepthCompareOp  = VK_LOAD_DEVICE_PFN(device, vkCmdSetDepthCompareOpEXT);
+
+        m_extended = m_cmdSetCullMode && m_cmdSetFrontFace && m_cmdSetDepthTest && m_cmdSetDepthWrite
+                  && m_cmdSetDepthCompareOp;
+    }
+
+    if (m_extended2) {
+        m_cmdSetDepthBias = VK_LOAD_DEVICE_PFN(device, vkCmdSetDepthBiasEnableEXT);
+        m_extended2 = m_cmdSetDepthBias != nullptr;
+    }
+
+    if (m_colorBlendEnable) {
+        m_cmdSetColorBlend = VK_LOAD_DEVICE_PFN(device, vkCmdSetColorBlendEnableEXT);
+        m_colorBlendEnable = m_cmdSetColorBlend != nullptr;
+    }
+}
+
+std::vector<VkDynamicState> ExtendedDynamicState::States() const {
+    std::vector<VkDynamicState> states;
+
+    if (m_extended) {
+        states.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+        states.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+        states.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+        states.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT);
+        states.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT);
+    }
+    if (m_extended2) {
+        states.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT);
+    }
+    if (m_colorBlendEnable) {
+        states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+    }
+
+    return states;
+}
+
+void ExtendedDynamicState::Apply(const VkCommandBuffer cmdBuffer, const RasterState& state,
+                                 uint32_t colorAttachmentCount) const {
+    if (m_extended) {
+        m_cmdSetCullMode(cmdBuffer, state.cullMode);
+        m_cmdSetFrontFace(cmdBuffer, state.frontFace);
+        m_cmdSetDepthTest(cmdBuffer, state.depthTest ? VK_TRUE : VK_FALSE);
+        m_cmdSetDepthWrite(cmdBuffer, state.depthWrite ? VK_TRUE : VK_FALSE);
+        m_cmdSetDepthCompareOp(cmdBuffer, state.depthCompareOp);
+    }
+
+    if (m_extended2) {
+        m_cmdSetDepthBias(cmdBuffer, state.depthBias ? VK_TRUE : VK_FALSE);
+    }
+
+    if (m_colorBlendEnable && colorAttachmentCount > 0) {
+        const std::vector<VkBool32> blendEnables(colorAttachmentCount, state.blendEnable ? VK_TRUE : VK_FALSE);
+        m_cmdSetColorBlend(cmdBuffer, 0, colorAttachmentCount, blendEnables.data());
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Render states which VK_EXT_extended_dynamic_state (1/2/3) can set while recording.
+struct RasterState {
+    VkCullModeFlags cullMode        = VK_CULL_MODE_NONE;
+    VkFrontFace     frontFace       = VK_FRONT_FACE_CLOCKWISE;
+    bool            depthTest       = true;
+    bool            depthWrite      = true;
+    VkCompareOp     depthCompareOp  = VK_COMPARE_OP_LESS;
+    bool            depthBias       = false;    // needs VK_EXT_extended_dynamic_state2, the factors stay baked
+    bool            blendEnable     = true;     // needs VK_EXT_extended_dynamic_state3 (colorBlendEnable)
+};
+
+// Moves the RasterState out of the pipelines: pipelines built with "States()" as dynamic states
+// do not differ in them, so one compiled pipeline serves every combination (see PipelineBuilder::Key).
+// Each level is used only if the device supports it, states of the missing levels stay baked.
+class ExtendedDynamicState {
+public:
+    // Checks the extensions and their features.
+    static ExtendedDynamicState Query(const VkPhysicalDevice phyDevice);
+
+    // Device creation: adds the supported extensions and links their feature structures in front of "pNext".
+    // The returned chain points into this object.
+    void AppendExtensions(std::vector<const char*>& extensions) const;
+    void* FeatureChain(void* pNext);
+
+    // Loads the vkCmdSet* entry points, call after the device creation.
+    void Load(const VkDevice device);
+
+    bool HasExtended() const { return m_extended; }
+    bool HasExtended2() const { return m_extended2; }
+    bool HasColorBlendEnable() const { return m_colorBlendEnable; }
+
+    // Dynamic states to add to the pipelines, empty without extension support.
+    std::vector<VkDynamicState> States() const;
+
+    // Records the supported part of "state", call after binding a pipeline built with "States()".
+    void Apply(const VkCommandBuffer cmdBuffer, const RasterState& state, uint32_t colorAttachmentCount = 1) const;
+
+private:
+    bool    m_extended          = false;
+    bool    m_extended2         = false;
+    bool    m_colorBlendEnable  = false;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT     m_features  = {};
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT    m_features2 = {};
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT    m_features3 = {};
+
+    PFN_vkCmdSetCullModeEXT         m_cmdSetCullMode        = nullptr;
+    PFN_vkCmdSetFrontFaceEXT        m_cmdSetFrontFace       = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT  m_cmdSetDepthTest       = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT m_cmdSetDepthWrite      = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT   m_cmdSetDepthCompareOp  = nullptr;
+    PFN_vkCmdSetDepthBiasEnableEXT  m_cmdSetDepthBias       = nullptr;
+    PFN_vkCmdSetColorBlendEnableEXT m_cmdSetColorBlend      = nullptr;
+};
@@ -0,0 +1,148 @@
+#include "frames_in_flight.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "queue_timeline.h"
+
+// Weight of the newest sample in the moving averages
+static constexpr double kAverageWeight = 0.05;
+
+FramesInFlight FramesInFlight::Create(const VkDevice device, const VkQueue queue, uint32_t queueFamilyIdx,
+                                      uint32_t frameCount) {
+    FramesInFlight frames;
+    frames.m_device     = device;
+    frames.m_timeline   = &QueueTimeline::Get(device, queue);
+    frames.m_frameCount = std::clamp(frameCount, 1u, kMaxFrames);
+
+    const VkCommandPoolCreateInfo poolInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamilyIdx,
+    };
+
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &frames.m_cmdPool);
+    if (result != VK_SUCCESS) {
+        printf("[FramesInFlight] Command pool creation failed (error code: %d)\n", result);
+        return frames;
+    }
+
+    // Every slot exists up front, SetFrameCount only changes how many of them are cycled
+    frames.m_slots = std::vector<Slot>(kMaxFrames);
+
+    std::vector<VkCommandBuffer> cmdBuffers(kMaxFrames, VK_NULL_HANDLE);
+    const VkCommandBufferAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = frames.m_cmdPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = kMaxFrames,
+    };
+
+    result = vkAllocateCommandBuffers(device, &allocInfo, cmdBuffers.data());
+    if (result != VK_SUCCESS) {
+        printf("[FramesInFlight] Command buffer allocation failed (error code: %d)\n", result);
+    }
+
+    const VkSemaphoreCreateInfo semaphoreInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+    };
+
+    for (uint32_t idx = 0; idx < kMaxFrames; idx++) {
+        Frame& frame = frames.m_slots[idx].frame;
+        frame.index     = idx;
+        frame.cmdBuffer = cmdBuffers[idx];
+
+        // Reused after the slot's submit finished, the wait on the semaphore is finished by then
+        result = vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frame.acquireSemaphore);
+        if (result != VK_SUCCESS) {
+            printf("[FramesInFlight] Semaphore creation failed (error code: %d)\n", result);
+        }
+    }
+
+    frames.m_lastBegin = std::chrono::steady_clock::now();
+
+    return frames;
+}
+
+const FramesInFlight::Frame& FramesInFlight::Begin() {
+    const auto start = std::chrono::steady_clock::now();
+
+    m_current = (uint32_t)(m_frameNumber % m_frameCount);
+    m_frameNumber++;
+
+    Slot& slot = m_slots[m_current];
+
+    VkResult result = m_timeline->Wait(slot.submitted);
+    if (result != VK_SUCCESS) {
+        printf("[FramesInFlight] Waiting for frame %u failed (error code: %d)\n", m_current, result);
+    }
+
+    const auto waited = std::chrono::steady_clock::now();
+
+    m_timeline->Collect();
+    vkResetCommandBuffer(slot.frame.cmdBuffer, 0);
+
+    const std::chrono::duration<double, std::milli> waitMs  = waited - start;
+    const std::chrono::duration<double, std::milli> frameMs = start - m_lastBegin;
+    m_lastBegin = start;
+
+    // The first frame after a (re)start has no previous Begin to measure from
+    if (m_frameNumber > 1) {
+        const double weight = m_sampleCount == 0 ? 1.0 : kAverageWeight;
+        m_avgWaitMs  += (waitMs.count() - m_avgWaitMs) * weight;
+        m_avgFrameMs += (frameMs.count() - m_avgFrameMs) * weight;
+        m_sampleCount++;
+    }
+
+    return slot.frame;
+}
+
+uint64_t FramesInFlight::Submit(const VkSubmitInfo& submitInfo) {
+    const uint64_t value = m_timeline->Submit(submitInfo);
+    if (value != 0) {
+        m_slots[m_current].submitted = value;
+    }
+
+    return value;
+}
+
+void FramesInFlight::WaitIdle() {
+    m_timeline->WaitIdle();
+}
+
+void FramesInFlight::SetFrameCount(uint32_t frameCount) {
+    frameCount = std::clamp(frameCount, 1u, kMaxFrames);
+    if (frameCount == m_frameCount) {
+        return;
+    }
+
+    // The slots keep their submitted values, a slot used again later waits for its last frame
+    m_frameCount  = frameCount;
+    m_frameNumber = 0;
+    m_current     = m_frameCount - 1;
+    m_sampleCount = 0;
+    m_avgFrameMs  = 0.0;
+    m_avgWaitMs   = 0.0;
+}
+
+void FramesInFlight::Destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    WaitIdle();
+
+    for (Slot& slot : m_slots) {
+        vkDestroySemaphore(m_device, slot.frame.acquireSemaphore, nullptr);
+    }
+
+    vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+
+    m_slots.clear();
+    m_cmdPool = VK_NULL_HANDLE;
+    m_device  = VK_NULL_HANDLE;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class QueueTimeline;
+
+// Per-frame command buffers and synchronization for up to kMaxFrames frames in flight: the CPU records
+// the next frame while the GPU still executes the previous ones. A slot is only reused after
+// the frame submitted with it finished, everything indexed by the slot (Frame::index) is free then.
+// Frames are submitted through the queue's QueueTimeline, Begin waits for the value of the slot's last submit.
+// Must only be used from one thread (the render loop).
+class FramesInFlight {
+public:
+    static constexpr uint32_t kMaxFrames = 3;
+
+    struct Frame {
+        uint32_t        index               = 0;                // slot, e.g. for FrameRingBuffer::BeginFrame
+        VkCommandBuffer cmdBuffer           = VK_NULL_HANDLE;   // reset, ready to be recorded
+        VkSemaphore     acquireSemaphore    = VK_NULL_HANDLE;   // for vkAcquireNextImageKHR, waited by the submit
+    };
+
+    static FramesInFlight Create(const VkDevice device, const VkQueue queue, uint32_t queueFamilyIdx,
+                                 uint32_t frameCount = 2);
+
+    // Waits for the frame which used the next slot, runs the deferred calls of the timeline
+    // and resets the slot's command buffer.
+    const Frame& Begin();
+
+    // Submits the frame begun last, returns its timeline value (0 on failure).
+    // A begun frame which is not submitted (e.g. failed acquire) leaves the slot free.
+    uint64_t Submit(const VkSubmitInfo& submitInfo);
+
+    // Waits for every frame in flight and runs the deferred calls of the timeline.
+    // For the rare cases when something used by the pending frames must change (descriptor rewrites).
+    void WaitIdle();
+
+    // 1..kMaxFrames, restarts the averages.
+    void SetFrameCount(uint32_t frameCount);
+    uint32_t FrameCount() const { return m_frameCount; }
+
+    // Moving averages measured by Begin: time between two frames and time blocked on the GPU.
+    double AverageFrameMs() const { return m_avgFrameMs; }
+    double AverageWaitMs() const { return m_avgWaitMs; }
+    uint64_t SampleCount() const { return m_sampleCount; }
+
+    QueueTimeline& Timeline() const { return *m_timeline; }
+
+    void Destroy();
+
+private:
+    struct Slot {
+        Frame       frame;
+        uint64_t    submitted   = 0;    // timeline value of the slot's last submit
+    };
+
+    VkDevice                m_device        = VK_NULL_HANDLE;
+    QueueTimeline*          m_timeline      = nullptr;
+    VkCommandPool           m_cmdPool       = VK_NULL_HANDLE;
+    std::vector<Slot>       m_slots;
+    uint32_t                m_frameCount    = 0;
+    uint32_t                m_current       = 0;    // slot of the last Begin
+    uint64_t                m_frameNumber   = 0;
+
+    std::chrono::steady_clock::time_point   m_lastBegin;
+    double                  m_avgFrameMs    = 0.0;
+    double                  m_avgWaitMs     = 0.0;
+    uint64_t                m_sampleCount   = 0;
+};
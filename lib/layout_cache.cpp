@@ -0,0 +1,226 @@
+#include "layout_cache.h"
+
+#include <cstdio>
+#include <memory>
+
+#include "device_registry.h"
+
+LayoutCache& LayoutCache::Get(const VkDevice device) {
+    return DeviceRegistry<LayoutCache>::Get(device, [&]() {
+        return std::make_unique<LayoutCache>(device);
+    });
+}
+
+void LayoutCache::Destroy(const VkDevice device) {
+    DeviceRegistry<LayoutCache>::Destroy(device);
+}
+
+size_t LayoutCache::KeyHash::operator()(const Key& key) const {
+    size_t seed = key.size();
+    for (uint64_t value : key) {
+        seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    return seed;
+}
+
+LayoutCache::LayoutCache(const VkDevice device)
+    : m_device(device) {
+}
+
+LayoutCache::~LayoutCache() {
+    for (auto& [key, entry] : m_pipelineLayouts) {
+        printf("[LayoutCache] Pipeline layout still has %u user(s)\n", entry.refCount);
+        vkDestroyPipelineLayout(m_device, entry.handle, nullptr);
+    }
+
+    for (auto& [key, entry] : m_setLayouts) {
+        printf("[LayoutCache] Descriptor set layout still has %u user(s)\n", entry.refCount);
+        vkDestroyDescriptorSetLayout(m_device, entry.handle, nullptr);
+    }
+}
+
+VkResult LayoutCache::Acquire(const VkDescriptorSetLayoutCreateInfo& createInfo, VkDescriptorSetLayout* outLayout) {
+    const VkDescriptorSetLayoutBindingFlagsCreateInfo* bindingFlags = nullptr;
+    for (const VkBaseInStructure* next = (const VkBaseInStructure*)createInfo.pNext; next; next = next->pNext) {
+        if (next->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO) {
+            bindingFlags = (const VkDescriptorSetLayoutBindingFlagsCreateInfo*)next;
+        } else {
+            printf("[LayoutCache] Unsupported structure in the pNext chain (sType: %d)\n", next->sType);
+        }
+    }
+
+    Key key;
+    key.push_back(createInfo.flags);
+    for (uint32_t idx = 0; idx < createInfo.bindingCount; idx++) {
+        const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[idx];
+
+        key.push_back(binding.binding);
+        key.push_back(binding.descriptorType);
+        key.push_back(binding.descriptorCount);
+        key.push_back(binding.stageFlags);
+        key.push_back(bindingFlags && idx < bindingFlags->bindingCount ? bindingFlags->pBindingFlags[idx] : 0);
+
+        if (binding.pImmutableSamplers) {
+            for (uint32_t samplerIdx = 0; samplerIdx < binding.descriptorCount; samplerIdx++) {
+                key.push_back((uint64_t)binding.pImmutableSamplers[samplerIdx]);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_setLayouts.find(key);
+    if (it != m_setLayouts.end()) {
+        it->second.refCount++;
+        m_hitCount++;
+
+        *outLayout = it->second.handle;
+        return VK_SUCCESS;
+    }
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    VkResult result = vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr, &layout);
+    if (result != VK_SUCCESS) {
+        printf("[LayoutCache] Descriptor set layout creation failed (error code: %d)\n", result);
+        return result;
+    }
+
+    m_setLayouts.emplace(key, Entry<VkDescriptorSetLayout>{ layout, 1 });
+    m_setLayoutKeys.emplace(layout, key);
+
+    *outLayout = layout;
+    return VK_SUCCESS;
+}
+
+VkResult LayoutCache::Acquire(
+    const std::vector<VkDescriptorSetLayout>& setLayouts,
+    const std::vector<VkPushConstantRange>&   pushConstantRanges,
+    VkPipelineLayout*                         outLayout) {
+
+    Key key;
+    key.push_back(setLayouts.size());
+    for (VkDescriptorSetLayout setLayout : setLayouts) {
+        key.push_back((uint64_t)setLayout);
+    }
+    for (const VkPushConstantRange& range : pushConstantRanges) {
+        key.push_back(range.stageFlags);
+        key.push_back(range.offset);
+        key.push_back(range.size);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_pipelineLayouts.find(key);
+    if (it != m_pipelineLayouts.end()) {
+        it->second.refCount++;
+        m_hitCount++;
+
+        *outLayout = it->second.handle;
+        return VK_SUCCESS;
+    }
+
+    VkPipelineLayoutCreateInfo createInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext                  = nullptr,
+        .flags                  = 0,
+        .setLayoutCount         = (uint32_t)setLayouts.size(),
+        .pSetLayouts            = setLayouts.data(),
+        .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+        .pPushConstantRanges    = pushConstantRanges.data(),
+    };
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    VkResult result = vkCreatePipelineLayout(m_device, &createInfo, nullptr, &layout);
+    if (result != VK_SUCCESS) {
+        printf("[LayoutCache] Pipeline layout creation failed (error code: %d)\n", result);
+        return result;
+    }
+
+    // The key holds the set layout handles: the cached set layouts are kept alive while the pipeline layout is,
+    // so their handles can not be reused by other set layouts
+    std::vector<VkDescriptorSetLayout>& heldSetLayouts = m_pipelineLayoutSets[layout];
+    for (VkDescriptorSetLayout setLayout : setLayouts) {
+        auto keyIt = m_setLayoutKeys.find(setLayout);
+        if (keyIt != m_setLayoutKeys.end()) {
+            m_setLayouts.find(keyIt->second)->second.refCount++;
+            heldSetLayouts.push_back(setLayout);
+        }
+    }
+
+    m_pipelineLayouts.emplace(key, Entry<VkPipelineLayout>{ layout, 1 });
+    m_pipelineLayoutKeys.emplace(layout, key);
+
+    *outLayout = layout;
+    return VK_SUCCESS;
+}
+
+void LayoutCache::Release(VkDescriptorSetLayout layout) {
+    if (layout == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ReleaseSetLayout(layout);
+}
+
+void LayoutCache::ReleaseSetLayout(VkDescriptorSetLayout layout) {
+    auto keyIt = m_setLayoutKeys.find(layout);
+    if (keyIt == m_setLayoutKeys.end()) {
+        printf("[LayoutCache] Released descriptor set layout is not owned by the cache\n");
+        return;
+    }
+
+    auto it = m_setLayouts.find(keyIt->second);
+    if (--it->second.refCount > 0) {
+        return;
+    }
+
+    vkDestroyDescriptorSetLayout(m_device, layout, nullptr);
+    m_setLayouts.erase(it);
+    m_setLayoutKeys.erase(keyIt);
+}
+
+void LayoutCache::Release(VkPipelineLayout layout) {
+    if (layout == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto keyIt = m_pipelineLayoutKeys.find(layout);
+    if (keyIt == m_pipelineLayoutKeys.end()) {
+        printf("[LayoutCache] Released pipeline layout is not owned by the cache\n");
+        return;
+    }
+
+    auto it = m_pipelineLayouts.find(keyIt->second);
+    if (--it->second.refCount > 0) {
+        return;
+    }
+
+    vkDestroyPipelineLayout(m_device, layout, nullptr);
+    m_pipelineLayouts.erase(it);
+    m_pipelineLayoutKeys.erase(keyIt);
+
+    auto setsIt = m_pipelineLayoutSets.find(layout);
+    for (VkDescriptorSetLayout setLayout : setsIt->second) {
+        ReleaseSetLayout(setLayout);
+    }
+    m_pipelineLayoutSets.erase(setsIt);
+}
+
+uint32_t LayoutCache::SetLayoutCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_setLayouts.size();
+}
+
+uint32_t LayoutCache::PipelineLayoutCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_pipelineLayouts.size();
+}
+
+uint64_t LayoutCache::HitCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hitCount;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Shares descriptor set layouts and pipeline layouts between every user requesting the same layout.
+// Identical layouts get the same handle, which keeps the sets bound across pipelines sharing them.
+// Layouts are reference counted and destroyed when the last user releases them,
+// a cached pipeline layout counts as a user of its cached set layouts.
+class LayoutCache {
+public:
+    // One cache per device, created on first use.
+    static LayoutCache& Get(const VkDevice device);
+    // Destroys every layout still alive, call before vkDestroyDevice.
+    static void Destroy(const VkDevice device);
+
+    // Supports the VkDescriptorSetLayoutBindingFlagsCreateInfo in the pNext chain, other structures are ignored.
+    VkResult Acquire(const VkDescriptorSetLayoutCreateInfo& createInfo, VkDescriptorSetLayout* outLayout);
+    VkResult Acquire(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                     const std::vector<VkPushConstantRange>&   pushConstantRanges,
+                     VkPipelineLayout*                         outLayout);
+
+    void Release(VkDescriptorSetLayout layout);
+    void Release(VkPipelineLayout layout);
+
+    uint32_t SetLayoutCount() const;
+    uint32_t PipelineLayoutCount() const;
+    // Number of Acquire calls served by an existing layout
+    uint64_t HitCount() const;
+
+    explicit LayoutCache(const VkDevice device);
+    ~LayoutCache();
+
+private:
+    // Every field of the create info flattened into words
+    using Key = std::vector<uint64_t>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    template<typename Handle>
+    struct Entry {
+        Handle      handle;
+        uint32_t    refCount;
+    };
+
+    // Call with m_mutex locked
+    void ReleaseSetLayout(VkDescriptorSetLayout layout);
+
+    VkDevice                                                        m_device;
+
+    mutable std::mutex                                              m_mutex;
+    std::unordered_map<Key, Entry<VkDescriptorSetLayout>, KeyHash>  m_setLayouts;
+    std::unordered_map<Key, Entry<VkPipelineLayout>, KeyHash>       m_pipelineLayouts;
+    std::unordered_map<VkDescriptorSetLayout, Key>                  m_setLayoutKeys;
+    std::unordered_map<VkPipelineLayout, Key>                       m_pipelineLayoutKeys;
+    // Cached set layouts referenced by each pipeline layout
+    std::unordered_map<VkPipelineLayout, std::vector<VkDescriptorSetLayout>> m_pipelineLayoutSets;
+    uint64_t                                                        m_hitCount = 0;
+};
@@ -0,0 +1,587 @@
+#include "memory_arena.h"
+
+#include "device_registry.h"
+#include "memory_stats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+struct MemoryBlock {
+    struct Range {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    VkDeviceMemory      memory          = VK_NULL_HANDLE;
+    VkDeviceSize        size            = 0;
+    uint32_t            memoryTypeIdx   = UINT32_MAX;
+    MemoryResourceKind  kind            = MemoryResourceKind::Linear;
+    uint8_t*            mapped          = nullptr;
+    uint32_t            allocationCount = 0;
+
+    // Sorted by offset, neighbouring ranges are always merged.
+    std::vector<Range>  freeRanges;
+
+    bool Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize* outOffset);
+    void Free(VkDeviceSize offset, VkDeviceSize allocSize);
+};
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment) {
+    return value / alignment * alignment;
+}
+
+bool MemoryBlock::Allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize* outOffset) {
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+
+    // First fit
+    for (size_t idx = 0; idx < freeRanges.size(); idx++) {
+        Range range = freeRanges[idx];
+
+        const VkDeviceSize alignedOffset = AlignUp(range.offset, alignment);
+        const VkDeviceSize rangeEnd      = range.offset + range.size;
+
+        if (alignedOffset + allocSize > rangeEnd) {
+            continue;
+        }
+
+        const VkDeviceSize padding  = alignedOffset - range.offset;
+        const VkDeviceSize tailSize = rangeEnd - (alignedOffset + allocSize);
+
+        freeRanges.erase(freeRanges.begin() + idx);
+
+        // Keep the front padding and the tail as free ranges.
+        if (tailSize > 0) {
+            freeRanges.insert(freeRanges.begin() + idx, { alignedOffset + allocSize, tailSize });
+        }
+        if (padding > 0) {
+            freeRanges.insert(freeRanges.begin() + idx, { range.offset, padding });
+        }
+
+        allocationCount++;
+        *outOffset = alignedOffset;
+        return true;
+    }
+
+    return false;
+}
+
+void MemoryBlock::Free(VkDeviceSize offset, VkDeviceSize allocSize) {
+    auto it = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+                               [](const Range& range, VkDeviceSize value) { return range.offset < value; });
+
+    it = freeRanges.insert(it, { offset, allocSize });
+
+    // Merge with the next range
+    auto next = it + 1;
+    if (next != freeRanges.end() && it->offset + it->size == next->offset) {
+        it->size += next->size;
+        freeRanges.erase(next);
+    }
+
+    // Merge with the previous range
+    if (it != freeRanges.begin()) {
+        auto prev = it - 1;
+        if (prev->offset + prev->size == it->offset) {
+            prev->size += it->size;
+            freeRanges.erase(it);
+        }
+    }
+
+    allocationCount--;
+}
+
+
+MemoryArena& MemoryArena::Get(const VkPhysicalDevice phyDevice, const VkDevice device) {
+    return DeviceRegistry<MemoryArena>::Get(device, [&]() {
+        return std::make_unique<MemoryArena>(phyDevice, device);
+    });
+}
+
+void MemoryArena::Destroy(const VkDevice device) {
+    DeviceRegistry<MemoryArena>::Destroy(device);
+}
+
+void MemoryArena::NameResource(const VkDevice device, uint64_t resource, const std::string& name) {
+    MemoryArena* arena = DeviceRegistry<MemoryArena>::Find(device);
+    if (arena == nullptr) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(arena->m_mutex);
+
+    auto it = arena->m_resources.find(resource);
+    if (it != arena->m_resources.end()) {
+        it->second.name = name;
+    }
+}
+
+uint32_t MemoryArena::FindMemoryTypeIndex(
+    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+    uint32_t                                memoryTypeBits,
+    VkMemoryPropertyFlags                   flags) {
+
+    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; idx++) {
+        if (memoryTypeBits & (1 << idx)) {
+            const VkMemoryType& memoryType = memoryProperties.memoryTypes[idx];
+
+            if ((memoryType.propertyFlags & flags) == flags) {
+                return idx;
+            }
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+MemoryArena::MemoryArena(const VkPhysicalDevice phyDevice, const VkDevice device)
+    : m_phyDevice(phyDevice)
+    , m_device(device) {
+    vkGetPhysicalDeviceMemoryProperties(phyDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+    m_nonCoherentAtomSize = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+}
+
+MemoryArena::~MemoryArena() {
+    for (std::unique_ptr<MemoryBlock>& block : m_blocks) {
+        if (block->allocationCount > 0) {
+            printf("[MemoryArena] Block of memory type %u still has %u live allocation(s)\n",
+                   block->memoryTypeIdx, block->allocationCount);
+        }
+
+        if (block->mapped) {
+            vkUnmapMemory(m_device, block->memory);
+        }
+        vkFreeMemory(m_device, block->memory, nullptr);
+    }
+}
+
+VkResult MemoryArena::AllocateForBuffer(
+    const VkBuffer          buffer,
+    VkMemoryPropertyFlags   flags,
+    MemoryAllocation*       outAllocation) {
+
+    VkMemoryDedicatedRequirements dedicatedRequirements = {
+        .sType                          = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext                          = nullptr,
+        .prefersDedicatedAllocation     = VK_FALSE,
+        .requiresDedicatedAllocation    = VK_FALSE,
+    };
+
+    VkMemoryRequirements2 requirements = {
+        .sType              = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext              = &dedicatedRequirements,
+        .memoryRequirements = {},
+    };
+
+    VkBufferMemoryRequirementsInfo2 requirementsInfo = {
+        .sType  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2,
+        .pNext  = nullptr,
+        .buffer = buffer,
+    };
+
+    vkGetBufferMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {
+        .sType  = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext  = nullptr,
+        .image  = VK_NULL_HANDLE,
+        .buffer = buffer,
+    };
+
+    const bool dedicated = dedicatedRequirements.requiresDedicatedAllocation
+                        || dedicatedRequirements.prefersDedicatedAllocation;
+
+    VkResult result = Allocate(requirements.memoryRequirements, flags, MemoryResourceKind::Linear, dedicated,
+                               &dedicatedInfo, outAllocation);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    outAllocation->resource = reinterpret_cast<uint64_t>(buffer);
+
+    // Only a bound range is tracked, a failed bind gives the range back
+    result = vkBindBufferMemory(m_device, buffer, outAllocation->memory, outAllocation->offset);
+    if (result != VK_SUCCESS) {
+        printf("[MemoryArena] Buffer memory bind failed (error code: %d)\n", result);
+        Free(*outAllocation);
+        return result;
+    }
+
+    Track(*outAllocation, MemoryResourceKind::Linear);
+
+    return VK_SUCCESS;
+}
+
+VkResult MemoryArena::AllocateForImage(
+    const VkImage           image,
+    VkMemoryPropertyFlags   flags,
+    bool                    preferDedicated,
+    MemoryAllocation*       outAllocation) {
+
+    VkMemoryDedicatedRequirements dedicatedRequirements = {
+        .sType                          = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS,
+        .pNext                          = nullptr,
+        .prefersDedicatedAllocation     = VK_FALSE,
+        .requiresDedicatedAllocation    = VK_FALSE,
+    };
+
+    VkMemoryRequirements2 requirements = {
+        .sType              = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext              = &dedicatedRequirements,
+        .memoryRequirements = {},
+    };
+
+    VkImageMemoryRequirementsInfo2 requirementsInfo = {
+        .sType  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .pNext  = nullptr,
+        .image  = image,
+    };
+
+    vkGetImageMemoryRequirements2(m_device, &requirementsInfo, &requirements);
+
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {
+        .sType  = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .pNext  = nullptr,
+        .image  = image,
+        .buffer = VK_NULL_HANDLE,
+    };
+
+    const bool dedicated = preferDedicated
+                        || dedicatedRequirements.requiresDedicatedAllocation
+                        || dedicatedRequirements.prefersDedicatedAllocation;
+
+    VkResult result = Allocate(requirements.memoryRequirements, flags, MemoryResourceKind::Optimal, dedicated,
+                               &dedicatedInfo, outAllocation);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    outAllocation->resource = reinterpret_cast<uint64_t>(image);
+
+    // Only a bound range is tracked, a failed bind gives the range back
+    result = vkBindImageMemory(m_device, image, outAllocation->memory, outAllocation->offset);
+    if (result != VK_SUCCESS) {
+        printf("[MemoryArena] Image memory bind failed (error code: %d)\n", result);
+        Free(*outAllocation);
+        return result;
+    }
+
+    Track(*outAllocation, MemoryResourceKind::Optimal);
+
+    return VK_SUCCESS;
+}
+
+VkResult MemoryArena::Allocate(
+    const VkMemoryRequirements& requirements,
+    VkMemoryPropertyFlags       flags,
+    MemoryResourceKind          kind,
+    bool                        dedicated,
+    const void*                 dedicatedInfo,
+    MemoryAllocation*           outAllocation) {
+
+    const uint32_t memoryTypeIdx = FindMemoryTypeIndex(m_memoryProperties, requirements.memoryTypeBits, flags);
+    if (memoryTypeIdx == UINT32_MAX) {
+        printf("[MemoryArena] No memory type found for flags 0x%x (type bits: 0x%x)\n", flags,
+               requirements.memoryTypeBits);
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    const VkDeviceSize blockSize = BlockSizeFor(memoryTypeIdx);
+
+    // Big resources (render targets, huge textures) would only fragment the blocks.
+    if (dedicated || requirements.size > blockSize / 2) {
+        return AllocateDedicated(requirements, memoryTypeIdx, dedicatedInfo, outAllocation);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MemoryBlock* target = nullptr;
+    VkDeviceSize offset = 0;
+
+    for (std::unique_ptr<MemoryBlock>& block : m_blocks) {
+        if (block->memoryTypeIdx != memoryTypeIdx || block->kind != kind) {
+            continue;
+        }
+
+        if (block->Allocate(requirements.size, requirements.alignment, &offset)) {
+            target = block.get();
+            break;
+        }
+    }
+
+    if (target == nullptr) {
+        target = CreateBlock(memoryTypeIdx, kind, blockSize);
+        if (target == nullptr || !target->Allocate(requirements.size, requirements.alignment, &offset)) {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+    }
+
+    *outAllocation = {
+        .arena          = this,
+        .block          = target,
+        .memory         = target->memory,
+        .offset         = offset,
+        .size           = requirements.size,
+        .memoryTypeIdx  = memoryTypeIdx,
+        .mapped         = target->mapped ? target->mapped + offset : nullptr,
+    };
+
+    return VK_SUCCESS;
+}
+
+VkResult MemoryArena::AllocateDedicated(
+    const VkMemoryRequirements& requirements,
+    uint32_t                    memoryTypeIdx,
+    const void*                 dedicatedInfo,
+    MemoryAllocation*           outAllocation) {
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext           = dedicatedInfo,
+        .allocationSize  = requirements.size,
+        .memoryTypeIndex = memoryTypeIdx,
+    };
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(m_device, &allocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    void* mapped = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    }
+
+    *outAllocation = {
+        .arena          = this,
+        .block          = nullptr,
+        .memory         = memory,
+        .offset         = 0,
+        .size           = requirements.size,
+        .memoryTypeIdx  = memoryTypeIdx,
+        .mapped         = mapped,
+    };
+
+    return VK_SUCCESS;
+}
+
+void MemoryArena::Free(MemoryAllocation& allocation) {
+    if (!allocation.IsValid()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_resources.erase(allocation.resource);
+    }
+
+    if (allocation.IsDedicated()) {
+        if (allocation.mapped) {
+            vkUnmapMemory(m_device, allocation.memory);
+        }
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+    } else {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        MemoryBlock* block = allocation.block;
+        block->Free(allocation.offset, allocation.size);
+
+        // One empty block per memory type and kind is kept for the next transient allocation (staging uploads
+        // would allocate and free a whole block every time), further empty ones go back to the driver.
+        // The kept blocks are freed by Destroy.
+        if (block->allocationCount == 0 && HasOtherEmptyBlock(block)) {
+            DestroyBlock(block);
+        }
+    }
+
+    allocation = {};
+}
+
+void MemoryArena::Flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) {
+    if (!allocation.IsValid() || allocation.mapped == nullptr || IsHostCoherent(allocation.memoryTypeIdx)) {
+        return;
+    }
+
+    const VkDeviceSize memorySize = allocation.block ? allocation.block->size : allocation.size;
+
+    VkDeviceSize begin = allocation.offset + offset;
+    VkDeviceSize end   = (size == VK_WHOLE_SIZE) ? allocation.offset + allocation.size : begin + size;
+
+    begin = AlignDown(begin, m_nonCoherentAtomSize);
+    end   = AlignUp(end, m_nonCoherentAtomSize);
+
+    VkMappedMemoryRange range = {
+        .sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext  = nullptr,
+        .memory = allocation.memory,
+        .offset = begin,
+        .size   = (end >= memorySize) ? VK_WHOLE_SIZE : end - begin,
+    };
+
+    vkFlushMappedMemoryRanges(m_device, 1, &range);
+}
+
+bool MemoryArena::IsHostCoherent(uint32_t memoryTypeIdx) const {
+    return m_memoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+MemoryBlock* MemoryArena::CreateBlock(uint32_t memoryTypeIdx, MemoryResourceKind kind, VkDeviceSize size) {
+    VkMemoryAllocateInfo allocInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext           = nullptr,
+        .allocationSize  = size,
+        .memoryTypeIndex = memoryTypeIdx,
+    };
+
+    std::unique_ptr<MemoryBlock> block = std::make_unique<MemoryBlock>();
+
+    VkResult result = vkAllocateMemory(m_device, &allocInfo, nullptr, &block->memory);
+    if (result != VK_SUCCESS) {
+        printf("[MemoryArena] Failed to allocate a %llu byte block (error code: %d)\n",
+               (unsigned long long)size, result);
+        return nullptr;
+    }
+
+    block->size          = size;
+    block->memoryTypeIdx = memoryTypeIdx;
+    block->kind          = kind;
+    block->freeRanges.push_back({ 0, size });
+
+    // Host visible blocks are mapped once for their whole lifetime.
+    if (m_memoryProperties.memoryTypes[memoryTypeIdx].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        void* mapped = nullptr;
+        vkMapMemory(m_device, block->memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        block->mapped = static_cast<uint8_t*>(mapped);
+    }
+
+    m_blocks.push_back(std::move(block));
+    return m_blocks.back().get();
+}
+
+bool MemoryArena::HasOtherEmptyBlock(const MemoryBlock* block) const {
+    for (const std::unique_ptr<MemoryBlock>& other : m_blocks) {
+        if (other.get() != block && other->allocationCount == 0 && other->memoryTypeIdx == block->memoryTypeIdx
+            && other->kind == block->kind) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void MemoryArena::DestroyBlock(MemoryBlock* block) {
+    if (block->mapped) {
+        vkUnmapMemory(m_device, block->memory);
+    }
+    vkFreeMemory(m_device, block->memory, nullptr);
+
+    m_blocks.erase(std::find_if(m_blocks.begin(), m_blocks.end(),
+                                [block](const std::unique_ptr<MemoryBlock>& entry) { return entry.get() == block; }));
+}
+
+VkDeviceSize MemoryArena::BlockSizeFor(uint32_t memoryTypeIdx) const {
+    const uint32_t heapIdx       = m_memoryProperties.memoryTypes[memoryTypeIdx].heapIndex;
+    const VkDeviceSize heapSize  = m_memoryProperties.memoryHeaps[heapIdx].size;
+
+    // Small heaps (eg.: the 256MiB BAR heap) should not be eaten up by a few blocks.
+    return std::min(kDefaultBlockSize, heapSize / 8);
+}
+
+void MemoryArena::Track(const MemoryAllocation& allocation, MemoryResourceKind kind) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_resources[allocation.resource] = {
+        .name           = "",
+        .kind           = kind,
+        .memoryTypeIdx  = allocation.memoryTypeIdx,
+        .size           = allocation.size,
+        .dedicated      = allocation.IsDedicated(),
+    };
+}
+
+void MemoryArena::CollectStats(MemoryStats* outStats) {
+    MemoryStats& stats = *outStats;
+    stats = {};
+
+    stats.heaps.resize(m_memoryProperties.memoryHeapCount);
+    for (uint32_t heapIdx = 0; heapIdx < m_memoryProperties.memoryHeapCount; heapIdx++) {
+        stats.heaps[heapIdx].size  = m_memoryProperties.memoryHeaps[heapIdx].size;
+        stats.heaps[heapIdx].flags = m_memoryProperties.memoryHeaps[heapIdx].flags;
+    }
+
+    if (m_useMemoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties = {
+            .sType              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+            .pNext              = &budget,
+            .memoryProperties   = {},
+        };
+        vkGetPhysicalDeviceMemoryProperties2(m_phyDevice, &properties);
+
+        for (uint32_t heapIdx = 0; heapIdx < m_memoryProperties.memoryHeapCount; heapIdx++) {
+            stats.heaps[heapIdx].budget = budget.heapBudget[heapIdx];
+            stats.heaps[heapIdx].usage  = budget.heapUsage[heapIdx];
+        }
+        stats.hasBudget = true;
+    }
+
+    std::vector<MemoryTypeStats> types(m_memoryProperties.memoryTypeCount);
+    for (uint32_t typeIdx = 0; typeIdx < m_memoryProperties.memoryTypeCount; typeIdx++) {
+        types[typeIdx].memoryTypeIdx = typeIdx;
+        types[typeIdx].heapIdx       = m_memoryProperties.memoryTypes[typeIdx].heapIndex;
+        types[typeIdx].flags         = m_memoryProperties.memoryTypes[typeIdx].propertyFlags;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (const std::unique_ptr<MemoryBlock>& block : m_blocks) {
+        MemoryTypeStats& type = types[block->memoryTypeIdx];
+        type.blockCount++;
+        type.allocatedBytes += block->size;
+    }
+
+    for (const std::pair<const uint64_t, TrackedResource>& entry : m_resources) {
+        const TrackedResource& resource = entry.second;
+
+        MemoryTypeStats& type = types[resource.memoryTypeIdx];
+        type.resourceCount++;
+        type.usedBytes += resource.size;
+
+        if (resource.dedicated) {
+            type.dedicatedCount++;
+            type.allocatedBytes += resource.size;
+        }
+
+        stats.resources.push_back({
+            .name           = resource.name,
+            .handle         = entry.first,
+            .kind           = resource.kind,
+            .memoryTypeIdx  = resource.memoryTypeIdx,
+            .size           = resource.size,
+            .dedicated      = resource.dedicated,
+        });
+    }
+
+    for (const MemoryTypeStats& type : types) {
+        if (type.allocatedBytes == 0) {
+            continue;
+        }
+
+        stats.heaps[type.heapIdx].allocatedBytes += type.allocatedBytes;
+        stats.heaps[type.heapIdx].usedBytes      += type.usedBytes;
+        stats.types.push_back(type);
+    }
+
+    std::sort(stats.resources.begin(), stats.resources.end(),
+              [](const MemoryResourceStats& lhs, const MemoryResourceStats& rhs) { return lhs.size > rhs.size; });
+}
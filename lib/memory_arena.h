@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class MemoryArena;
+struct MemoryBlock;
+struct MemoryStats;
+
+// Resources placed into the same block must respect "bufferImageGranularity",
+// keeping linear (buffer) and optimal (image) resources in separate blocks avoids the issue.
+enum class MemoryResourceKind : uint32_t {
+    Linear  = 0,
+    Optimal = 1,
+};
+
+struct MemoryAllocation {
+    MemoryArena*    arena           = nullptr;
+    MemoryBlock*    block           = nullptr;  // nullptr for dedicated allocations
+    VkDeviceMemory  memory          = VK_NULL_HANDLE;
+    VkDeviceSize    offset          = 0;
+    VkDeviceSize    size            = 0;
+    uint32_t        memoryTypeIdx   = UINT32_MAX;
+    void*           mapped          = nullptr;  // already offset, only for host visible memory
+    uint64_t        resource        = 0;        // VkBuffer/VkImage handle, used for the statistics
+
+    bool IsValid() const { return memory != VK_NULL_HANDLE; }
+    bool IsDedicated() const { return block == nullptr; }
+};
+
+class MemoryArena {
+public:
+    static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+
+    // One arena per device, created on first use.
+    static MemoryArena& Get(const VkPhysicalDevice phyDevice, const VkDevice device);
+    // Frees every block of the device's arena, call before vkDestroyDevice.
+    static void Destroy(const VkDevice device);
+
+    // Attaches a debug name to a tracked buffer/image, does nothing if the device has no arena yet.
+    static void NameResource(const VkDevice device, uint64_t resource, const std::string& name);
+
+    static uint32_t FindMemoryTypeIndex(
+        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        uint32_t                                memoryTypeBits,
+        VkMemoryPropertyFlags                   flags);
+
+    VkResult AllocateForBuffer(
+        const VkBuffer          buffer,
+        VkMemoryPropertyFlags   flags,
+        MemoryAllocation*       outAllocation);
+
+    VkResult AllocateForImage(
+        const VkImage           image,
+        VkMemoryPropertyFlags   flags,
+        bool                    preferDedicated,
+        MemoryAllocation*       outAllocation);
+
+    void Free(MemoryAllocation& allocation);
+
+    // Only does work for non HOST_COHERENT memory types.
+    void Flush(const MemoryAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    bool IsHostCoherent(uint32_t memoryTypeIdx) const;
+
+    // Only enable if the device was created with VK_EXT_memory_budget.
+    void UseMemoryBudget(bool enabled) { m_useMemoryBudget = enabled; }
+
+    // Usage by heap, memory type and resource. Heap budgets are filled when VK_EXT_memory_budget is in use.
+    void CollectStats(MemoryStats* outStats);
+
+    VkDevice Device() const { return m_device; }
+    VkPhysicalDevice PhyDevice() const { return m_phyDevice; }
+    const VkPhysicalDeviceMemoryProperties& MemoryProperties() const { return m_memoryProperties; }
+
+    MemoryArena(const VkPhysicalDevice phyDevice, const VkDevice device);
+    ~MemoryArena();
+
+private:
+    VkResult Allocate(
+        const VkMemoryRequirements& requirements,
+        VkMemoryPropertyFlags       flags,
+        MemoryResourceKind          kind,
+        bool                        dedicated,
+        const void*                 dedicatedInfo,
+        MemoryAllocation*           outAllocation);
+
+    VkResult AllocateDedicated(
+        const VkMemoryRequirements& requirements,
+        uint32_t                    memoryTypeIdx,
+        const void*                 dedicatedInfo,
+        MemoryAllocation*           outAllocation);
+
+    MemoryBlock* CreateBlock(uint32_t memoryTypeIdx, MemoryResourceKind kind, VkDeviceSize size);
+    void DestroyBlock(MemoryBlock* block);
+    // Another block of the same memory type and kind without allocations, call with m_mutex locked
+    bool HasOtherEmptyBlock(const MemoryBlock* block) const;
+
+    VkDeviceSize BlockSizeFor(uint32_t memoryTypeIdx) const;
+
+    void Track(const MemoryAllocation& allocation, MemoryResourceKind kind);
+
+    struct TrackedResource {
+        std::string         name;
+        MemoryResourceKind  kind;
+        uint32_t            memoryTypeIdx;
+        VkDeviceSize        size;
+        bool                dedicated;
+    };
+
+    VkPhysicalDevice                            m_phyDevice;
+    VkDevice                                    m_device;
+    VkPhysicalDeviceMemoryProperties            m_memoryProperties  = {};
+    VkDeviceSize                                m_nonCoherentAtomSize = 1;
+    bool                                        m_useMemoryBudget = false;
+
+    std::mutex                                  m_mutex;
+    std::vector<std::unique_ptr<MemoryBlock>>   m_blocks;
+    std::unordered_map<uint64_t, TrackedResource> m_resources;
+};
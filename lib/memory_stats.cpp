@@ -0,0 +1,83 @@
+#include "memory_stats.h"
+
+#include <cstdio>
+
+static void WriteJsonString(FILE* file, const std::string& value) {
+    fputc('"', file);
+    for (char chr : value) {
+        switch (chr) {
+            case '"':  fputs("\\\"", file); break;
+            case '\\': fputs("\\\\", file); break;
+            case '\n': fputs("\\n", file); break;
+            case '\t': fputs("\\t", file); break;
+            default:
+                if ((unsigned char)chr < 0x20) {
+                    fprintf(file, "\\u%04x", chr);
+                } else {
+                    fputc(chr, file);
+                }
+        }
+    }
+    fputc('"', file);
+}
+
+bool WriteMemoryStatsJson(const MemoryStats& stats, const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        printf("[MemoryStats] Unable to open '%s' for writing\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"hasBudget\": %s,\n", stats.hasBudget ? "true" : "false");
+
+    fprintf(file, "  \"heaps\": [\n");
+    for (size_t heapIdx = 0; heapIdx < stats.heaps.size(); heapIdx++) {
+        const MemoryHeapStats& heap = stats.heaps[heapIdx];
+
+        fprintf(file, "    { \"index\": %zu, \"size\": %llu, \"deviceLocal\": %s, \"allocated\": %llu, \"used\": %llu",
+                heapIdx, (unsigned long long)heap.size,
+                (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false",
+                (unsigned long long)heap.allocatedBytes, (unsigned long long)heap.usedBytes);
+        if (stats.hasBudget) {
+            fprintf(file, ", \"budget\": %llu, \"usage\": %llu, \"overBudget\": %s",
+                    (unsigned long long)heap.budget, (unsigned long long)heap.usage,
+                    stats.IsOverBudget(heapIdx) ? "true" : "false");
+        }
+        fprintf(file, " }%s\n", (heapIdx + 1 < stats.heaps.size()) ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"memoryTypes\": [\n");
+    for (size_t idx = 0; idx < stats.types.size(); idx++) {
+        const MemoryTypeStats& type = stats.types[idx];
+
+        fprintf(file, "    { \"index\": %u, \"heap\": %u, \"flags\": %u, \"blocks\": %u, \"dedicated\": %u, "
+                      "\"resources\": %u, \"allocated\": %llu, \"used\": %llu }%s\n",
+                type.memoryTypeIdx, type.heapIdx, type.flags, type.blockCount, type.dedicatedCount,
+                type.resourceCount, (unsigned long long)type.allocatedBytes, (unsigned long long)type.usedBytes,
+                (idx + 1 < stats.types.size()) ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"resources\": [\n");
+    for (size_t idx = 0; idx < stats.resources.size(); idx++) {
+        const MemoryResourceStats& resource = stats.resources[idx];
+
+        fprintf(file, "    { \"name\": ");
+        WriteJsonString(file, resource.name);
+        fprintf(file, ", \"handle\": \"0x%llx\", \"kind\": \"%s\", \"memoryType\": %u, \"size\": %llu, "
+                      "\"dedicated\": %s }%s\n",
+                (unsigned long long)resource.handle,
+                resource.kind == MemoryResourceKind::Linear ? "buffer" : "image",
+                resource.memoryTypeIdx, (unsigned long long)resource.size,
+                resource.dedicated ? "true" : "false",
+                (idx + 1 < stats.resources.size()) ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+
+    fprintf(file, "}\n");
+    fclose(file);
+
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "memory_arena.h"
+
+struct MemoryHeapStats {
+    VkDeviceSize        size            = 0;
+    VkMemoryHeapFlags   flags           = 0;
+    VkDeviceSize        allocatedBytes  = 0;    // vkAllocateMemory'd by the arena (blocks + dedicated)
+    VkDeviceSize        usedBytes       = 0;    // handed out to resources
+    // VK_EXT_memory_budget values, process wide (includes memory not owned by the arena).
+    VkDeviceSize        budget          = 0;
+    VkDeviceSize        usage           = 0;
+};
+
+struct MemoryTypeStats {
+    uint32_t                memoryTypeIdx   = 0;
+    uint32_t                heapIdx         = 0;
+    VkMemoryPropertyFlags   flags           = 0;
+    uint32_t                blockCount      = 0;
+    uint32_t                dedicatedCount  = 0;
+    uint32_t                resourceCount   = 0;
+    VkDeviceSize            allocatedBytes  = 0;
+    VkDeviceSize            usedBytes       = 0;
+};
+
+struct MemoryResourceStats {
+    std::string         name;
+    uint64_t            handle          = 0;
+    MemoryResourceKind  kind            = MemoryResourceKind::Linear;
+    uint32_t            memoryTypeIdx   = 0;
+    VkDeviceSize        size            = 0;
+    bool                dedicated       = false;
+};
+
+struct MemoryStats {
+    bool                                hasBudget = false;
+    std::vector<MemoryHeapStats>        heaps;
+    std::vector<MemoryTypeStats>        types;      // only the memory types with allocations
+    std::vector<MemoryResourceStats>    resources;  // sorted by size, biggest first
+
+    bool IsOverBudget(uint32_t heapIdx) const {
+        return hasBudget && heaps[heapIdx].usage > heaps[heapIdx].budget;
+    }
+};
+
+bool WriteMemoryStatsJson(const MemoryStats& stats, const std::string& path);
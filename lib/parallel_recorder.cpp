@@ -0,0 +1,163 @@
+#include "parallel_recorder.h"
+
+#include <algorithm>
+#include <cstdio>
+
+ParallelRecorder::ParallelRecorder(const VkDevice device, uint32_t queueFamilyIdx, uint32_t frameSlotCount,
+                                   uint32_t threadCount)
+    : m_device(device)
+    , m_workers(threadCount) {
+
+    const VkCommandPoolCreateInfo poolInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx,
+    };
+
+    m_pools.resize(frameSlotCount);
+    for (std::vector<JobPool>& slotPools : m_pools) {
+        slotPools.resize(ThreadCount());
+
+        for (JobPool& pool : slotPools) {
+            VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &pool.cmdPool);
+            if (result != VK_SUCCESS) {
+                printf("[ParallelRecorder] Command pool creation failed (error code: %d)\n", result);
+            }
+        }
+    }
+}
+
+void ParallelRecorder::BeginFrame(uint32_t frameSlot) {
+    m_frameSlot = frameSlot;
+    m_recordings.clear();
+
+    // One reset per pool instead of one per command buffer
+    for (JobPool& pool : m_pools[m_frameSlot]) {
+        vkResetCommandPool(m_device, pool.cmdPool, 0);
+        pool.usedCount = 0;
+    }
+}
+
+uint32_t ParallelRecorder::Add(VkRenderPass renderPass, VkFramebuffer framebuffer, Record record) {
+    m_recordings.push_back({ renderPass, framebuffer, std::move(record), VK_NULL_HANDLE });
+
+    return (uint32_t)m_recordings.size() - 1;
+}
+
+void ParallelRecorder::Run() {
+    m_next = 0;
+
+    // No more jobs than recordings, job 0 runs on the calling thread
+    const uint32_t jobCount = std::min(ThreadCount(), (uint32_t)m_recordings.size());
+    for (uint32_t job = 1; job < jobCount; job++) {
+        m_workers.Enqueue([this, job]() { RunJob(job); });
+    }
+
+    if (jobCount > 0) {
+        RunJob(0);
+    }
+
+    m_workers.WaitIdle();
+}
+
+void ParallelRecorder::Execute(VkCommandBuffer primary, uint32_t first, uint32_t count) const {
+    std::vector<VkCommandBuffer> cmdBuffers;
+    cmdBuffers.reserve(count);
+
+    for (uint32_t idx = first; idx < first + count; idx++) {
+        if (m_recordings[idx].cmdBuffer != VK_NULL_HANDLE) {
+            cmdBuffers.push_back(m_recordings[idx].cmdBuffer);
+        }
+    }
+
+    if (!cmdBuffers.empty()) {
+        vkCmdExecuteCommands(primary, (uint32_t)cmdBuffers.size(), cmdBuffers.data());
+    }
+}
+
+void ParallelRecorder::Destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    m_workers.WaitIdle();
+
+    for (std::vector<JobPool>& slotPools : m_pools) {
+        for (JobPool& pool : slotPools) {
+            // Frees the command buffers too
+            vkDestroyCommandPool(m_device, pool.cmdPool, nullptr);
+        }
+    }
+
+    m_pools.clear();
+    m_recordings.clear();
+    m_device = VK_NULL_HANDLE;
+}
+
+void ParallelRecorder::RunJob(uint32_t job) {
+    JobPool& pool = m_pools[m_frameSlot][job];
+
+    // Recordings are taken in order, so neighbouring chunks are likely recorded at the same time
+    for (uint32_t idx = m_next++; idx < m_recordings.size(); idx = m_next++) {
+        Recording& recording = m_recordings[idx];
+
+        VkCommandBuffer cmdBuffer = NextBuffer(pool);
+        if (cmdBuffer == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        const VkCommandBufferInheritanceInfo inheritanceInfo = {
+            .sType                  = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+            .pNext                  = nullptr,
+            .renderPass             = recording.renderPass,
+            .subpass                = 0,
+            .framebuffer            = recording.framebuffer,
+            .occlusionQueryEnable   = VK_FALSE,
+            .queryFlags             = 0,
+            .pipelineStatistics     = 0,
+        };
+
+        const VkCommandBufferBeginInfo beginInfo = {
+            .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext              = nullptr,
+            .flags              = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+                                | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+            .pInheritanceInfo   = &inheritanceInfo,
+        };
+
+        vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+        recording.record(cmdBuffer);
+
+        VkResult result = vkEndCommandBuffer(cmdBuffer);
+        if (result != VK_SUCCESS) {
+            printf("[ParallelRecorder] Recording %u failed (error code: %d)\n", idx, result);
+            continue;
+        }
+
+        recording.cmdBuffer = cmdBuffer;
+    }
+}
+
+VkCommandBuffer ParallelRecorder::NextBuffer(JobPool& pool) {
+    if (pool.usedCount == pool.cmdBuffers.size()) {
+        const VkCommandBufferAllocateInfo allocInfo = {
+            .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext              = nullptr,
+            .commandPool        = pool.cmdPool,
+            .level              = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkResult result = vkAllocateCommandBuffers(m_device, &allocInfo, &cmdBuffer);
+        if (result != VK_SUCCESS) {
+            printf("[ParallelRecorder] Command buffer allocation failed (error code: %d)\n", result);
+            return VK_NULL_HANDLE;
+        }
+
+        pool.cmdBuffers.push_back(cmdBuffer);
+    }
+
+    return pool.cmdBuffers[pool.usedCount++];
+}
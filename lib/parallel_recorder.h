@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "thread_pool.h"
+
+// Records secondary command buffers on worker threads, the primary command buffer executes them in order.
+// Every recording job (one per worker plus one on the calling thread) has its own command pool per
+// frame slot, so a pool is never used by two threads and a slot's pools are reset all at once.
+// The methods must be called from one thread (the render loop), only the Record functions run on the workers.
+class ParallelRecorder {
+public:
+    // Records one secondary command buffer. Runs on a worker: only thread safe calls (no PipelineVariants::Get,
+    // no descriptor writes), everything it reads must stay unchanged until Run returns.
+    using Record = std::function<void(VkCommandBuffer cmdBuffer)>;
+
+    // 0 threads: one worker per hardware thread (minus the calling thread).
+    ParallelRecorder(const VkDevice device, uint32_t queueFamilyIdx, uint32_t frameSlotCount, uint32_t threadCount = 0);
+
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    // Resets the command pools of "frameSlot" and drops the added recordings.
+    // The frame which used the slot before must be finished (see FramesInFlight::Begin).
+    void BeginFrame(uint32_t frameSlot);
+
+    // Queues a secondary command buffer continuing subpass 0 of "renderPass"/"framebuffer".
+    // Returns its index for Execute.
+    uint32_t Add(VkRenderPass renderPass, VkFramebuffer framebuffer, Record record);
+
+    // Records every added buffer, returns once all of them are finished.
+    void Run();
+
+    // vkCmdExecuteCommands for the added buffers [first, first + count), the render pass must have
+    // been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+    void Execute(VkCommandBuffer primary, uint32_t first, uint32_t count) const;
+
+    uint32_t RecordingCount() const { return (uint32_t)m_recordings.size(); }
+    // Workers and the calling thread
+    uint32_t ThreadCount() const { return m_workers.ThreadCount() + 1; }
+
+    // Waits for the workers and destroys the command pools, the device must be idle.
+    void Destroy();
+
+private:
+    struct Recording {
+        VkRenderPass    renderPass;
+        VkFramebuffer   framebuffer;
+        Record          record;
+        VkCommandBuffer cmdBuffer;
+    };
+
+    // Only used by one job at a time
+    struct JobPool {
+        VkCommandPool                   cmdPool     = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer>    cmdBuffers;     // allocated so far, reused after the reset
+        uint32_t                        usedCount   = 0;
+    };
+
+    // Records recordings until none is left, with the pool of "job"
+    void RunJob(uint32_t job);
+    VkCommandBuffer NextBuffer(JobPool& pool);
+
+    VkDevice                            m_device        = VK_NULL_HANDLE;
+    ThreadPool                          m_workers;
+    std::vector<std::vector<JobPool>>   m_pools;        // [frame slot][job]
+    uint32_t                            m_frameSlot     = 0;
+    std::vector<Recording>              m_recordings;
+    std::atomic<uint32_t>               m_next          = 0;
+};
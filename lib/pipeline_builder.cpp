@@ -0,0 +1,823 @@
+#include "pipeline_builder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "debug.h"
+#include "device_registry.h"
+
+PipelineBuilder& PipelineBuilder::Shader(
+    VkShaderStageFlagBits       stage,
+    const uint32_t*             code,
+    size_t                      codeSizeBytes,
+    const VkSpecializationInfo* specialization,
+    const char*                 entryPoint) {
+
+    Stage info = {
+        .stage          = stage,
+        .code           = std::vector<uint32_t>(code, code + codeSizeBytes / sizeof(uint32_t)),
+        .entryPoint     = entryPoint,
+        .specialized    = specialization != nullptr,
+        .mapEntries     = {},
+        .data           = {},
+    };
+
+    if (specialization) {
+        const uint8_t* data = (const uint8_t*)specialization->pData;
+
+        info.mapEntries.assign(specialization->pMapEntries, specialization->pMapEntries + specialization->mapEntryCount);
+        info.data.assign(data, data + specialization->dataSize);
+    }
+
+    m_stages.push_back(std::move(info));
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::VertexBinding(uint32_t binding, uint32_t stride, VkVertexInputRate inputRate) {
+    m_vertexBindings.push_back({ binding, stride, inputRate });
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::VertexAttribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset) {
+    m_vertexAttributes.push_back({ location, binding, format, offset });
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::Topology(VkPrimitiveTopology topology) {
+    m_topology = topology;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::Extent(VkExtent2D extent) {
+    m_extent = extent;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::CullMode(VkCullModeFlags cullMode, VkFrontFace frontFace) {
+    m_cullMode  = cullMode;
+    m_frontFace = frontFace;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::DepthBias(float constantFactor, float slopeFactor) {
+    m_depthBiasEnable   = true;
+    m_depthBiasConstant = constantFactor;
+    m_depthBiasSlope    = slopeFactor;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::Samples(VkSampleCountFlagBits samples) {
+    m_samples = samples;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::DepthTest(bool testEnable, bool writeEnable, VkCompareOp compareOp) {
+    m_depthTest      = testEnable;
+    m_depthWrite     = writeEnable;
+    m_depthCompareOp = compareOp;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::ColorAttachments(uint32_t count, bool blendEnable) {
+    m_colorAttachments = count;
+    m_blendEnable      = blendEnable;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::DynamicState(VkDynamicState state) {
+    m_dynamicStates.push_back(state);
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::DynamicStates(const std::vector<VkDynamicState>& states) {
+    m_dynamicStates.insert(m_dynamicStates.end(), states.begin(), states.end());
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::Layout(VkPipelineLayout layout) {
+    m_layout = layout;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::RenderPass(VkRenderPass renderPass, uint32_t subpass) {
+    m_renderPass = renderPass;
+    m_subpass    = subpass;
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::Name(const std::string& name) {
+    m_name = name;
+    return *this;
+}
+
+static uint64_t FloatBits(float value) {
+    // -0.0 and 0.0 produce the same pipeline
+    if (value == 0.0f) {
+        return 0;
+    }
+
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+bool PipelineBuilder::IsDynamic(VkDynamicState state) const {
+    return std::find(m_dynamicStates.begin(), m_dynamicStates.end(), state) != m_dynamicStates.end();
+}
+
+static VkGraphicsPipelineLibraryFlagBitsEXT PartFlag(PipelinePart part) {
+    switch (part) {
+    case PipelinePart::VertexInput:         return VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+    case PipelinePart::PreRasterization:    return VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+    case PipelinePart::FragmentShader:      return VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+    case PipelinePart::FragmentOutput:      return VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+    }
+
+    return VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+}
+
+static VkGraphicsPipelineLibraryFlagBitsEXT StagePart(VkShaderStageFlagBits stage) {
+    return stage == VK_SHADER_STAGE_FRAGMENT_BIT ? VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT
+                                                 : VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+}
+
+std::vector<uint64_t> PipelineBuilder::Key() const {
+    std::vector<uint64_t> key;
+
+    for (uint32_t part = 0; part < PipelinePartCount; part++) {
+        const std::vector<uint64_t> partKey = PartKey((PipelinePart)part);
+
+        key.push_back(partKey.size());
+        key.insert(key.end(), partKey.begin(), partKey.end());
+    }
+
+    return key;
+}
+
+std::vector<uint64_t> PipelineBuilder::PartKey(PipelinePart part) const {
+    std::vector<uint64_t> key;
+    key.push_back((uint64_t)part);
+
+    auto appendStages = [this, &key](VkGraphicsPipelineLibraryFlagBitsEXT stagePart) {
+        for (const Stage& stage : m_stages) {
+            if (StagePart(stage.stage) != stagePart) {
+                continue;
+            }
+
+            key.push_back(stage.stage);
+
+            key.push_back(stage.code.size());
+            key.insert(key.end(), stage.code.begin(), stage.code.end());
+
+            key.push_back(stage.entryPoint.size());
+            key.insert(key.end(), stage.entryPoint.begin(), stage.entryPoint.end());
+
+            key.push_back(stage.specialized);
+            key.push_back(stage.mapEntries.size());
+            for (const VkSpecializationMapEntry& entry : stage.mapEntries) {
+                key.push_back(entry.constantID);
+                key.push_back(entry.offset);
+                key.push_back(entry.size);
+            }
+            key.push_back(stage.data.size());
+            key.insert(key.end(), stage.data.begin(), stage.data.end());
+        }
+        // Terminates the variable length list
+        key.push_back(0);
+    };
+
+    // The dynamic states are part of the key, a left out value is simply replaced by 0
+    auto unlessDynamic = [this](VkDynamicState state, uint64_t value) -> uint64_t {
+        return IsDynamic(state) ? 0 : value;
+    };
+
+    const bool dynamicExtent = IsDynamic(VK_DYNAMIC_STATE_VIEWPORT) && IsDynamic(VK_DYNAMIC_STATE_SCISSOR);
+
+    switch (part) {
+    case PipelinePart::VertexInput:
+        key.push_back(m_vertexBindings.size());
+        for (const VkVertexInputBindingDescription& binding : m_vertexBindings) {
+            key.push_back(binding.binding);
+            key.push_back(binding.stride);
+            key.push_back(binding.inputRate);
+        }
+
+        key.push_back(m_vertexAttributes.size());
+        for (const VkVertexInputAttributeDescription& attribute : m_vertexAttributes) {
+            key.push_back(attribute.location);
+            key.push_back(attribute.binding);
+            key.push_back(attribute.format);
+            key.push_back(attribute.offset);
+        }
+
+        key.push_back(m_topology);
+        break;
+
+    case PipelinePart::PreRasterization:
+        appendStages(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+
+        key.push_back(dynamicExtent ? 0 : m_extent.width);
+        key.push_back(dynamicExtent ? 0 : m_extent.height);
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_CULL_MODE_EXT, m_cullMode));
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_FRONT_FACE_EXT, m_frontFace));
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT, m_depthBiasEnable));
+        key.push_back(FloatBits(m_depthBiasConstant));
+        key.push_back(FloatBits(m_depthBiasSlope));
+        key.push_back((uint64_t)m_layout);
+        break;
+
+    case PipelinePart::FragmentShader:
+        appendStages(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+
+        key.push_back(m_samples);
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT, m_depthTest));
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, m_depthWrite));
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT, m_depthCompareOp));
+        key.push_back((uint64_t)m_layout);
+        break;
+
+    case PipelinePart::FragmentOutput:
+        key.push_back(m_samples);
+        key.push_back(m_colorAttachments);
+        key.push_back(unlessDynamic(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT, m_blendEnable));
+        break;
+    }
+
+    key.push_back(m_dynamicStates.size());
+    key.insert(key.end(), m_dynamicStates.begin(), m_dynamicStates.end());
+
+    // Every part except the vertex input is compiled against the render pass
+    if (part != PipelinePart::VertexInput) {
+        key.push_back((uint64_t)m_renderPass);
+        key.push_back(m_subpass);
+    }
+
+    return key;
+}
+
+VkResult PipelineBuilder::Create(const VkDevice device, const VkPipelineCache pipelineCache, VkPipeline* outPipeline) const {
+    return CreatePipeline(device, pipelineCache, 0, outPipeline);
+}
+
+VkResult PipelineBuilder::CreateLibrary(const VkDevice device, const VkPipelineCache pipelineCache, PipelinePart part,
+                                        VkPipeline* outLibrary) const {
+    return CreatePipeline(device, pipelineCache, PartFlag(part), outLibrary);
+}
+
+VkResult PipelineBuilder::CreatePipeline(const VkDevice device, const VkPipelineCache pipelineCache,
+                                         VkGraphicsPipelineLibraryFlagsEXT libraryParts, VkPipeline* outPipeline) const {
+    *outPipeline = VK_NULL_HANDLE;
+
+    // A complete pipeline has every part
+    auto hasPart = [libraryParts](VkGraphicsPipelineLibraryFlagsEXT part) {
+        return libraryParts == 0 || (libraryParts & part) != 0;
+    };
+
+    // shader stages
+    std::vector<VkSpecializationInfo> specializations(m_stages.size());
+    std::vector<VkPipelineShaderStageCreateInfo> shaders;
+    shaders.reserve(m_stages.size());
+
+    VkResult result = VK_SUCCESS;
+    for (size_t idx = 0; idx < m_stages.size(); idx++) {
+        const Stage& stage = m_stages[idx];
+        if (!hasPart(StagePart(stage.stage))) {
+            continue;
+        }
+
+        VkShaderModuleCreateInfo moduleInfo = {
+            .sType      = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext      = nullptr,
+            .flags      = 0,
+            .codeSize   = stage.code.size() * sizeof(uint32_t),
+            .pCode      = stage.code.data(),
+        };
+
+        VkShaderModule module = VK_NULL_HANDLE;
+        result = vkCreateShaderModule(device, &moduleInfo, nullptr, &module);
+        if (result != VK_SUCCESS) {
+            printf("[PipelineBuilder] Shader module creation failed (error code: %d)\n", result);
+            break;
+        }
+
+        specializations[idx] = {
+            .mapEntryCount  = (uint32_t)stage.mapEntries.size(),
+            .pMapEntries    = stage.mapEntries.data(),
+            .dataSize       = stage.data.size(),
+            .pData          = stage.data.data(),
+        };
+
+        shaders.push_back({
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext                  = nullptr,
+            .flags                  = 0,
+            .stage                  = stage.stage,
+            .module                 = module,
+            .pName                  = stage.entryPoint.c_str(),
+            .pSpecializationInfo    = stage.specialized ? &specializations[idx] : nullptr,
+        });
+    }
+
+    // IMPORTANT! related buffer(s) must be bound before draw via vkCmdBindVertexBuffers
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType                              = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .pNext                              = nullptr,
+        .flags                              = 0,
+        .vertexBindingDescriptionCount      = (uint32_t)m_vertexBindings.size(),
+        .pVertexBindingDescriptions         = m_vertexBindings.data(),
+        .vertexAttributeDescriptionCount    = (uint32_t)m_vertexAttributes.size(),
+        .pVertexAttributeDescriptions       = m_vertexAttributes.data(),
+    };
+
+    // input assembly
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .pNext                  = nullptr,
+        .flags                  = 0,
+        .topology               = m_topology,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    // viewport info
+    VkViewport viewport = {
+        .x          = 0,
+        .y          = 0,
+        .width      = float(m_extent.width),
+        .height     = float(m_extent.height),
+        .minDepth   = 0.0f,
+        .maxDepth   = 1.0f,
+    };
+
+    VkRect2D scissor {
+        .offset = { 0, 0 },
+        .extent = m_extent,
+    };
+
+    VkPipelineViewportStateCreateInfo viewportInfo = {
+        .sType          = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .pNext          = nullptr,
+        .flags          = 0,
+        .viewportCount  = 1,
+        .pViewports     = &viewport,
+        .scissorCount   = 1,
+        .pScissors      = &scissor,
+    };
+
+    // rasterization info
+    VkPipelineRasterizationStateCreateInfo rasterizationInfo = {
+        .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .depthClampEnable        = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode             = VK_POLYGON_MODE_FILL,
+        .cullMode                = m_cullMode,
+        .frontFace               = m_frontFace,
+        .depthBiasEnable         = m_depthBiasEnable ? VK_TRUE : VK_FALSE,
+        .depthBiasConstantFactor = m_depthBiasConstant,
+        .depthBiasClamp          = 0.0f,
+        .depthBiasSlopeFactor    = m_depthBiasSlope,
+        .lineWidth               = 1.0f,
+    };
+
+    // multisample
+    VkPipelineMultisampleStateCreateInfo multisampleInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .pNext                  = nullptr,
+        .flags                  = 0,
+        .rasterizationSamples   = m_samples,
+        .sampleShadingEnable    = VK_FALSE,
+        .minSampleShading       = 0.0f,
+        .pSampleMask            = nullptr,
+        .alphaToCoverageEnable  = VK_FALSE,
+        .alphaToOneEnable       = VK_FALSE,
+    };
+
+    // depth stencil
+    // "empty" stencil Op state
+    VkStencilOpState emptyStencilOp = { };
+
+    VkPipelineDepthStencilStateCreateInfo depthStencilInfo = {
+        .sType                 = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .pNext                 = nullptr,
+        .flags                 = 0,
+        .depthTestEnable       = m_depthTest ? VK_TRUE : VK_FALSE,
+        .depthWriteEnable      = m_depthWrite ? VK_TRUE : VK_FALSE,
+        .depthCompareOp        = m_depthCompareOp,
+        .depthBoundsTestEnable = VK_FALSE,
+        .stencilTestEnable     = VK_FALSE,
+        .front                 = emptyStencilOp,
+        .back                  = emptyStencilOp,
+        .minDepthBounds        = 0.0f,
+        .maxDepthBounds        = 1.0f,
+    };
+
+    // color blend
+    const VkPipelineColorBlendAttachmentState blendAttachment = {
+        .blendEnable         = m_blendEnable ? VK_TRUE : VK_FALSE,
+        // if blend is disabled these are ignored
+        .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+        .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+        .colorBlendOp        = VK_BLEND_OP_ADD,
+        .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+        .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+        .alphaBlendOp        = VK_BLEND_OP_ADD,
+        // Important!
+        .colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+
+    const std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(m_colorAttachments, blendAttachment);
+
+    VkPipelineColorBlendStateCreateInfo colorBlendInfo = {
+        .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .pNext           = nullptr,
+        .flags           = 0,
+        .logicOpEnable   = VK_FALSE,
+        .logicOp         = VK_LOGIC_OP_CLEAR, // Disabled
+        .attachmentCount = (uint32_t)blendAttachments.size(),
+        .pAttachments    = blendAttachments.data(),
+        .blendConstants  = { 1.0f, 1.0f, 1.0f, 1.0f }, // Ignored
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicStateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .dynamicStateCount  = (uint32_t)m_dynamicStates.size(),
+        .pDynamicStates     = m_dynamicStates.data(),
+    };
+
+    // Only the selected parts are compiled into a library, the dynamic states of the other parts are ignored
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo = {
+        .sType  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+        .pNext  = nullptr,
+        .flags  = libraryParts,
+    };
+
+    const bool vertexInput      = hasPart(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+    const bool preRasterization = hasPart(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+    const bool fragmentShader   = hasPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+    const bool fragmentOutput   = hasPart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+
+    // pipeline create
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
+        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext               = libraryParts != 0 ? &libraryInfo : nullptr,
+        .flags               = libraryParts != 0 ? VK_PIPELINE_CREATE_LIBRARY_BIT_KHR
+                                                   | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT
+                                                 : (VkPipelineCreateFlags)0,
+        .stageCount          = (uint32_t)shaders.size(),
+        .pStages             = shaders.data(),
+        .pVertexInputState   = vertexInput ? &vertexInputInfo : nullptr,
+        .pInputAssemblyState = vertexInput ? &inputAssemblyInfo : nullptr,
+        .pTessellationState  = nullptr,
+        .pViewportState      = preRasterization ? &viewportInfo : nullptr,
+        .pRasterizationState = preRasterization ? &rasterizationInfo : nullptr,
+        .pMultisampleState   = (fragmentShader || fragmentOutput) ? &multisampleInfo : nullptr,
+        .pDepthStencilState  = fragmentShader ? &depthStencilInfo : nullptr,
+        .pColorBlendState    = fragmentOutput ? &colorBlendInfo : nullptr,
+        .pDynamicState       = m_dynamicStates.empty() ? nullptr : &dynamicStateInfo,
+        .layout              = (preRasterization || fragmentShader) ? m_layout : VK_NULL_HANDLE,
+        .renderPass          = vertexInput && libraryParts != 0 ? VK_NULL_HANDLE : m_renderPass,
+        .subpass             = m_subpass,
+        .basePipelineHandle  = VK_NULL_HANDLE,
+        .basePipelineIndex   = 0,
+    };
+
+    if (result == VK_SUCCESS) {
+        result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, outPipeline);
+        if (result != VK_SUCCESS) {
+            printf("[PipelineBuilder] Pipeline creation failed (error code: %d)\n", result);
+            *outPipeline = VK_NULL_HANDLE;
+        } else if (!m_name.empty()) {
+            SetResourceName(device, VK_OBJECT_TYPE_PIPELINE, *outPipeline,
+                            libraryParts != 0 ? m_name + "-Library" : m_name);
+        }
+    }
+
+    // Destroy shader modules, pipeline already created
+    for (const VkPipelineShaderStageCreateInfo& shader : shaders) {
+        vkDestroyShaderModule(device, shader.module, nullptr);
+    }
+
+    return result;
+}
+
+VkResult PipelineBuilder::Link(
+    const VkDevice              device,
+    const VkPipelineCache       pipelineCache,
+    const PipelineLibraries&    libraries,
+    const VkPipelineLayout      layout,
+    bool                        optimize,
+    const std::string&          name,
+    VkPipeline*                 outPipeline) {
+
+    VkPipelineLibraryCreateInfoKHR libraryInfo = {
+        .sType          = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .pNext          = nullptr,
+        .libraryCount   = (uint32_t)libraries.size(),
+        .pLibraries     = libraries.data(),
+    };
+
+    // Every state comes from the libraries
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {
+        .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext               = &libraryInfo,
+        .flags               = optimize ? (VkPipelineCreateFlags)VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+        .stageCount          = 0,
+        .pStages             = nullptr,
+        .pVertexInputState   = nullptr,
+        .pInputAssemblyState = nullptr,
+        .pTessellationState  = nullptr,
+        .pViewportState      = nullptr,
+        .pRasterizationState = nullptr,
+        .pMultisampleState   = nullptr,
+        .pDepthStencilState  = nullptr,
+        .pColorBlendState    = nullptr,
+        .pDynamicState       = nullptr,
+        .layout              = layout,
+        .renderPass          = VK_NULL_HANDLE,
+        .subpass             = 0,
+        .basePipelineHandle  = VK_NULL_HANDLE,
+        .basePipelineIndex   = 0,
+    };
+
+    VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, outPipeline);
+    if (result != VK_SUCCESS) {
+        printf("[PipelineBuilder] Pipeline link failed (error code: %d)\n", result);
+        *outPipeline = VK_NULL_HANDLE;
+    } else if (!name.empty()) {
+        SetResourceName(device, VK_OBJECT_TYPE_PIPELINE, *outPipeline, optimize ? name + "-Optimized" : name);
+    }
+
+    return result;
+}
+
+PipelineRegistry& PipelineRegistry::Get(const VkDevice device) {
+    return DeviceRegistry<PipelineRegistry>::Get(device, [&]() {
+        return std::make_unique<PipelineRegistry>(device);
+    });
+}
+
+void PipelineRegistry::Destroy(const VkDevice device) {
+    DeviceRegistry<PipelineRegistry>::Destroy(device);
+}
+
+size_t PipelineRegistry::KeyHash::operator()(const Key& key) const {
+    size_t seed = key.size();
+    for (uint64_t value : key) {
+        seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    return seed;
+}
+
+PipelineRegistry::PipelineRegistry(const VkDevice device)
+    : m_device(device) {
+}
+
+PipelineRegistry::~PipelineRegistry() {
+    // Pending optimized links still use the libraries
+    m_optimizer.reset();
+
+    for (auto& [key, entry] : m_pipelines.entries) {
+        const Created& created = entry.created.get();
+
+        printf("[PipelineRegistry] Pipeline still has %u user(s)\n", entry.refCount);
+        vkDestroyPipeline(m_device, created.pipeline, nullptr);
+    }
+
+    for (auto& [linked, optimized] : m_optimized) {
+        vkDestroyPipeline(m_device, optimized, nullptr);
+    }
+
+    // Only referenced by the pipelines above
+    for (auto& [key, entry] : m_libraries.entries) {
+        vkDestroyPipeline(m_device, entry.created.get().pipeline, nullptr);
+    }
+}
+
+void PipelineRegistry::UseLibraries(bool enable) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_useLibraries = enable;
+    if (enable && !m_optimizer) {
+        // One thread is enough, the optimized links are not waited for
+        m_optimizer = std::make_unique<ThreadPool>(1);
+    }
+}
+
+VkResult PipelineRegistry::Acquire(const PipelineBuilder& builder, const VkPipelineCache pipelineCache,
+                                   VkPipeline* outPipeline) {
+    return AcquireShared(m_pipelines, builder.Key(), [&](VkPipeline* pipeline) {
+        return m_useLibraries ? CreateLinked(builder, pipelineCache, pipeline)
+                              : builder.Create(m_device, pipelineCache, pipeline);
+    }, outPipeline);
+}
+
+VkResult PipelineRegistry::AcquireShared(Table& table, Key key, const std::function<VkResult(VkPipeline*)>& create,
+                                         VkPipeline* outPipeline) {
+    std::promise<Created> promise;
+    std::shared_future<Created> created;
+    bool compile = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = table.entries.find(key);
+        if (it != table.entries.end()) {
+            it->second.refCount++;
+            table.hitCount++;
+
+            created = it->second.created;
+        } else {
+            table.missCount++;
+            compile = true;
+
+            created = promise.get_future().share();
+            table.entries.emplace(key, Entry{ created, 1 });
+        }
+    }
+
+    // Compiled outside of the lock, other threads requesting the same state wait for the result
+    if (compile) {
+        Created result = { VK_SUCCESS, VK_NULL_HANDLE };
+        result.result = create(&result.pipeline);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (result.result == VK_SUCCESS) {
+                table.keys.emplace(result.pipeline, std::move(key));
+            } else {
+                // A later request tries again
+                table.entries.erase(key);
+            }
+        }
+
+        promise.set_value(result);
+    }
+
+    const Created& result = created.get();
+
+    *outPipeline = result.pipeline;
+    return result.result;
+}
+
+VkResult PipelineRegistry::CreateLinked(const PipelineBuilder& builder, const VkPipelineCache pipelineCache,
+                                        VkPipeline* outPipeline) {
+    // Variants usually differ in only one part, the others are already compiled
+    PipelineLibraries libraries = {};
+    VkResult result = VK_SUCCESS;
+    for (uint32_t part = 0; part < PipelinePartCount && result == VK_SUCCESS; part++) {
+        result = AcquireShared(m_libraries, builder.PartKey((PipelinePart)part), [&](VkPipeline* library) {
+            return builder.CreateLibrary(m_device, pipelineCache, (PipelinePart)part, library);
+        }, &libraries[part]);
+    }
+
+    if (result == VK_SUCCESS) {
+        result = PipelineBuilder::Link(m_device, pipelineCache, libraries, builder.PipelineLayout(), false,
+                                       builder.DebugName(), outPipeline);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (result != VK_SUCCESS) {
+        for (VkPipeline library : libraries) {
+            if (library != VK_NULL_HANDLE) {
+                ReleaseShared(m_libraries, library);
+            }
+        }
+        return result;
+    }
+
+    const uint64_t serial = ++m_linkSerial;
+    m_linked[*outPipeline] = Linked{ libraries, serial };
+
+    // The optimizer keeps its own reference, the pipeline may be released before the link finishes
+    for (VkPipeline library : libraries) {
+        AddReference(m_libraries, library);
+    }
+
+    const VkPipeline linked = *outPipeline;
+    const VkPipelineLayout layout = builder.PipelineLayout();
+    const std::string name = builder.DebugName();
+
+    m_optimizer->Enqueue([this, linked, serial, libraries, layout, name, pipelineCache]() {
+        VkPipeline optimized = VK_NULL_HANDLE;
+        VkResult result = PipelineBuilder::Link(m_device, pipelineCache, libraries, layout, true, name, &optimized);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_linked.find(linked);
+        if (result == VK_SUCCESS) {
+            if (it != m_linked.end() && it->second.serial == serial) {
+                m_optimized[linked] = optimized;
+            } else {
+                vkDestroyPipeline(m_device, optimized, nullptr);
+            }
+        }
+
+        for (VkPipeline library : libraries) {
+            ReleaseShared(m_libraries, library);
+        }
+    });
+
+    return VK_SUCCESS;
+}
+
+void PipelineRegistry::AddReference(Table& table, VkPipeline pipeline) {
+    auto keyIt = table.keys.find(pipeline);
+    if (keyIt != table.keys.end()) {
+        table.entries.find(keyIt->second)->second.refCount++;
+    }
+}
+
+bool PipelineRegistry::ReleaseShared(Table& table, VkPipeline pipeline) {
+    auto keyIt = table.keys.find(pipeline);
+    if (keyIt == table.keys.end()) {
+        printf("[PipelineRegistry] Released pipeline is not owned by the registry\n");
+        return false;
+    }
+
+    auto it = table.entries.find(keyIt->second);
+    if (--it->second.refCount > 0) {
+        return false;
+    }
+
+    vkDestroyPipeline(m_device, pipeline, nullptr);
+    table.entries.erase(it);
+    table.keys.erase(keyIt);
+
+    return true;
+}
+
+void PipelineRegistry::Release(VkPipeline pipeline) {
+    if (pipeline == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!ReleaseShared(m_pipelines, pipeline)) {
+        return;
+    }
+
+    m_releaseGeneration++;
+
+    auto optimizedIt = m_optimized.find(pipeline);
+    if (optimizedIt != m_optimized.end()) {
+        vkDestroyPipeline(m_device, optimizedIt->second, nullptr);
+        m_optimized.erase(optimizedIt);
+    }
+
+    auto linkedIt = m_linked.find(pipeline);
+    if (linkedIt != m_linked.end()) {
+        for (VkPipeline library : linkedIt->second.libraries) {
+            ReleaseShared(m_libraries, library);
+        }
+        m_linked.erase(linkedIt);
+    }
+}
+
+VkPipeline PipelineRegistry::Optimized(VkPipeline pipeline) const {
+    if (!m_useLibraries) {
+        return pipeline;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_optimized.find(pipeline);
+    return it != m_optimized.end() ? it->second : pipeline;
+}
+
+uint32_t PipelineRegistry::PipelineCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_pipelines.keys.size();
+}
+
+uint32_t PipelineRegistry::LibraryCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_libraries.keys.size();
+}
+
+uint32_t PipelineRegistry::OptimizedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_optimized.size();
+}
+
+uint64_t PipelineRegistry::HitCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pipelines.hitCount;
+}
+
+uint64_t PipelineRegistry::MissCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pipelines.missCount;
+}
+
+uint64_t PipelineRegistry::ReleaseGeneration() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_releaseGeneration;
+}
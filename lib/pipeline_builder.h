@@ -0,0 +1,210 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "thread_pool.h"
+
+// State subsets of a graphics pipeline which VK_EXT_graphics_pipeline_library compiles separately.
+enum class PipelinePart : uint32_t {
+    VertexInput         = 0,    // vertex input and input assembly
+    PreRasterization    = 1,    // non fragment shaders, viewport and rasterization
+    FragmentShader      = 2,    // fragment shader, depth test and multisample
+    FragmentOutput      = 3,    // color blend and multisample
+};
+
+constexpr uint32_t PipelinePartCount = 4;
+
+using PipelineLibraries = std::array<VkPipeline, PipelinePartCount>;
+
+// Describes a graphics pipeline, starting from the state shared by the course's pipelines:
+// triangle list, filled and not culled polygons, one sample, depth test and write with "less",
+// one alpha blended color attachment and a static viewport/scissor covering "Extent".
+// Shaders are given as SPIR-V code (copied), modules are only created when a pipeline is compiled.
+class PipelineBuilder {
+public:
+    PipelineBuilder& Shader(VkShaderStageFlagBits stage, const uint32_t* code, size_t codeSizeBytes,
+                            const VkSpecializationInfo* specialization = nullptr, const char* entryPoint = "main");
+    PipelineBuilder& VertexBinding(uint32_t binding, uint32_t stride,
+                                   VkVertexInputRate inputRate = VK_VERTEX_INPUT_RATE_VERTEX);
+    PipelineBuilder& VertexAttribute(uint32_t location, uint32_t binding, VkFormat format, uint32_t offset);
+    PipelineBuilder& Topology(VkPrimitiveTopology topology);
+    PipelineBuilder& Extent(VkExtent2D extent);
+    PipelineBuilder& CullMode(VkCullModeFlags cullMode, VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE);
+    PipelineBuilder& DepthBias(float constantFactor, float slopeFactor);
+    PipelineBuilder& Samples(VkSampleCountFlagBits samples);
+    PipelineBuilder& DepthTest(bool testEnable, bool writeEnable = true, VkCompareOp compareOp = VK_COMPARE_OP_LESS);
+    // Every color attachment uses the same blend state, 0 for depth only passes.
+    PipelineBuilder& ColorAttachments(uint32_t count, bool blendEnable = true);
+    PipelineBuilder& DynamicState(VkDynamicState state);
+    PipelineBuilder& DynamicStates(const std::vector<VkDynamicState>& states);
+    PipelineBuilder& Layout(VkPipelineLayout layout);
+    PipelineBuilder& RenderPass(VkRenderPass renderPass, uint32_t subpass = 0);
+    // Debug name of the created pipeline, not part of the key.
+    PipelineBuilder& Name(const std::string& name);
+
+    // Compiles a new pipeline on every call, see PipelineRegistry for the deduplicated version.
+    VkResult Create(const VkDevice device, const VkPipelineCache pipelineCache, VkPipeline* outPipeline) const;
+
+    // Compiles only the state of "part" into a pipeline library, which keeps the information
+    // needed for a later link time optimized Link. Requires VK_EXT_graphics_pipeline_library.
+    VkResult CreateLibrary(const VkDevice device, const VkPipelineCache pipelineCache, PipelinePart part,
+                           VkPipeline* outLibrary) const;
+
+    // Links one library of each part into a complete pipeline. Without "optimize" the link is fast,
+    // but the pipeline may run slower than a fully compiled one.
+    static VkResult Link(const VkDevice device, const VkPipelineCache pipelineCache, const PipelineLibraries& libraries,
+                         const VkPipelineLayout layout, bool optimize, const std::string& name, VkPipeline* outPipeline);
+
+    // Every field of the state flattened into words, identical keys produce identical pipelines.
+    // Fields covered by a dynamic state are left out: builders differing only in those share a pipeline.
+    std::vector<uint64_t> Key() const;
+    // Same for the fields used by one part, builders with equal part keys share that library.
+    std::vector<uint64_t> PartKey(PipelinePart part) const;
+
+    VkPipelineLayout PipelineLayout() const { return m_layout; }
+
+    const std::string& DebugName() const { return m_name; }
+
+private:
+    bool IsDynamic(VkDynamicState state) const;
+
+    // "libraryParts" selects the VkGraphicsPipelineLibraryFlagsEXT subset to compile, 0 for a complete pipeline
+    VkResult CreatePipeline(const VkDevice device, const VkPipelineCache pipelineCache,
+                            VkGraphicsPipelineLibraryFlagsEXT libraryParts, VkPipeline* outPipeline) const;
+
+    struct Stage {
+        VkShaderStageFlagBits                   stage;
+        std::vector<uint32_t>                   code;
+        std::string                             entryPoint;
+        bool                                    specialized;
+        std::vector<VkSpecializationMapEntry>   mapEntries;
+        std::vector<uint8_t>                    data;
+    };
+
+    std::vector<Stage>                              m_stages;
+    std::vector<VkVertexInputBindingDescription>    m_vertexBindings;
+    std::vector<VkVertexInputAttributeDescription>  m_vertexAttributes;
+    VkPrimitiveTopology                             m_topology          = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkExtent2D                                      m_extent            = { 0, 0 };
+    VkCullModeFlags                                 m_cullMode          = VK_CULL_MODE_NONE;
+    VkFrontFace                                     m_frontFace         = VK_FRONT_FACE_CLOCKWISE;
+    bool                                            m_depthBiasEnable   = false;
+    float                                           m_depthBiasConstant = 0.0f;
+    float                                           m_depthBiasSlope    = 0.0f;
+    VkSampleCountFlagBits                           m_samples           = VK_SAMPLE_COUNT_1_BIT;
+    bool                                            m_depthTest         = true;
+    bool                                            m_depthWrite        = true;
+    VkCompareOp                                     m_depthCompareOp    = VK_COMPARE_OP_LESS;
+    uint32_t                                        m_colorAttachments  = 1;
+    bool                                            m_blendEnable       = true;
+    std::vector<VkDynamicState>                     m_dynamicStates;
+    VkPipelineLayout                                m_layout            = VK_NULL_HANDLE;
+    VkRenderPass                                    m_renderPass        = VK_NULL_HANDLE;
+    uint32_t                                        m_subpass           = 0;
+    std::string                                     m_name;
+};
+
+// Shares graphics pipelines between every user requesting the same PipelineBuilder state.
+// A state is compiled only once, even when it is requested from several threads at the same time.
+// Pipelines are reference counted and destroyed when the last user releases them.
+//
+// With UseLibraries the four parts of a pipeline are compiled (and shared) as pipeline libraries,
+// a new state is served by a fast link of them. The link time optimized version is linked on a
+// background thread and returned by Optimized once ready, the handle from Acquire stays valid until released.
+class PipelineRegistry {
+public:
+    // One registry per device, created on first use.
+    static PipelineRegistry& Get(const VkDevice device);
+    // Destroys every pipeline still alive, call before vkDestroyDevice and before destroying
+    // the pipeline cache used by Acquire (pending optimized links use it).
+    static void Destroy(const VkDevice device);
+
+    // Call before the first Acquire, only if GraphicsPipelineLibrary::IsSupported.
+    void UseLibraries(bool enable);
+    bool UsesLibraries() const { return m_useLibraries; }
+
+    // Thread safe, the pipeline cache is only used on a miss.
+    VkResult Acquire(const PipelineBuilder& builder, const VkPipelineCache pipelineCache, VkPipeline* outPipeline);
+    void Release(VkPipeline pipeline);
+
+    // The link time optimized version of an acquired pipeline if it is already linked, otherwise "pipeline".
+    // Look it up when binding, both are valid until "pipeline" is released.
+    VkPipeline Optimized(VkPipeline pipeline) const;
+
+    uint32_t PipelineCount() const;
+    uint32_t LibraryCount() const;
+    uint32_t OptimizedCount() const;
+    // Number of Acquire calls served by an existing (or in-flight) pipeline
+    uint64_t HitCount() const;
+    // Number of Acquire calls which compiled a pipeline
+    uint64_t MissCount() const;
+    // Incremented whenever Release destroys a pipeline. A new pipeline may get the handle of a destroyed one,
+    // so anything keyed on pipeline handles (e.g. reused command buffers) must include this too.
+    uint64_t ReleaseGeneration() const;
+
+    explicit PipelineRegistry(const VkDevice device);
+    ~PipelineRegistry();
+
+private:
+    using Key = std::vector<uint64_t>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Created {
+        VkResult    result;
+        VkPipeline  pipeline;
+    };
+
+    struct Entry {
+        std::shared_future<Created> created;
+        uint32_t                    refCount;
+    };
+
+    // Pipelines and libraries are shared the same way
+    struct Table {
+        std::unordered_map<Key, Entry, KeyHash>     entries;
+        std::unordered_map<VkPipeline, Key>         keys;
+        uint64_t                                    hitCount    = 0;
+        uint64_t                                    missCount   = 0;
+    };
+
+    // Libraries of a fast linked pipeline, "serial" tells apart pipelines getting the same handle
+    struct Linked {
+        PipelineLibraries   libraries;
+        uint64_t            serial;
+    };
+
+    VkResult AcquireShared(Table& table, Key key, const std::function<VkResult(VkPipeline*)>& create,
+                           VkPipeline* outPipeline);
+    // Requires the lock, returns true if the last reference was released and the pipeline destroyed
+    bool ReleaseShared(Table& table, VkPipeline pipeline);
+    void AddReference(Table& table, VkPipeline pipeline);
+
+    VkResult CreateLinked(const PipelineBuilder& builder, const VkPipelineCache pipelineCache, VkPipeline* outPipeline);
+
+    VkDevice                                        m_device;
+    bool                                            m_useLibraries  = false;
+
+    mutable std::mutex                              m_mutex;
+    Table                                           m_pipelines;
+    Table                                           m_libraries;
+    std::unordered_map<VkPipeline, Linked>          m_linked;
+    std::unordered_map<VkPipeline, VkPipeline>      m_optimized;
+    uint64_t                                        m_linkSerial    = 0;
+    uint64_t                                        m_releaseGeneration = 0;
+
+    // Link time optimization, destroyed (and drained) first in the destructor
+    std::unique_ptr<ThreadPool>                     m_optimizer;
+};
@@ -0,0 +1,171 @@
+#include "pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static constexpr uint32_t kFileMagic    = 0x43505643; // "CVPC"
+static constexpr uint32_t kFileVersion  = 1;
+
+// Bytes between the read position and the end of "file", the read position is kept
+static uint64_t RemainingBytes(FILE* file) {
+    const long position = ftell(file);
+    if (position < 0 || fseek(file, 0, SEEK_END) != 0) {
+        return 0;
+    }
+
+    const long end = ftell(file);
+    fseek(file, position, SEEK_SET);
+
+    return end > position ? (uint64_t)(end - position) : 0;
+}
+
+VkResult PipelineCache::Load(const VkPhysicalDevice phyDevice, const VkDevice device, const std::string& path) {
+    m_device = device;
+    m_path   = path;
+    m_warm   = false;
+
+    VkPhysicalDeviceIDProperties idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &idProperties;
+
+    vkGetPhysicalDeviceProperties2(phyDevice, &properties);
+
+    m_expected.magic            = kFileMagic;
+    m_expected.version          = kFileVersion;
+    m_expected.vendorID         = properties.properties.vendorID;
+    m_expected.deviceID         = properties.properties.deviceID;
+    m_expected.driverVersion    = properties.properties.driverVersion;
+    memcpy(m_expected.driverUUID, idProperties.driverUUID, VK_UUID_SIZE);
+    memcpy(m_cacheUUID, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    // 1) Read and validate the file, any mismatch results in an empty cache
+    std::vector<uint8_t> data;
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file) {
+        FileHeader header = {};
+        const bool headerRead = fread(&header, sizeof(header), 1, file) == 1;
+
+        if (!headerRead || header.magic != kFileMagic || header.version != kFileVersion
+            || header.vendorID != m_expected.vendorID || header.deviceID != m_expected.deviceID
+            || header.driverVersion != m_expected.driverVersion
+            || memcmp(header.driverUUID, m_expected.driverUUID, VK_UUID_SIZE) != 0) {
+            printf("[PipelineCache] '%s' was written by a different device/driver, ignoring it\n", path.c_str());
+        } else if (header.dataSize != RemainingBytes(file)) {
+            // Checked before the allocation: a corrupt size must not become a huge resize
+            printf("[PipelineCache] '%s' is truncated or corrupt, ignoring it\n", path.c_str());
+        } else {
+            data.resize(header.dataSize);
+            if (fread(data.data(), 1, data.size(), file) != data.size()) {
+                printf("[PipelineCache] '%s' is truncated, ignoring it\n", path.c_str());
+                data.clear();
+            }
+        }
+
+        fclose(file);
+    }
+
+    // 2) The driver's own header must match as well
+    if (!data.empty()) {
+        VkPipelineCacheHeaderVersionOne cacheHeader = {};
+
+        if (data.size() < sizeof(cacheHeader)) {
+            data.clear();
+        } else {
+            memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+
+            if (cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                || cacheHeader.vendorID != m_expected.vendorID || cacheHeader.deviceID != m_expected.deviceID
+                || memcmp(cacheHeader.pipelineCacheUUID, m_cacheUUID, VK_UUID_SIZE) != 0) {
+                printf("[PipelineCache] Pipeline cache UUID mismatch, ignoring '%s'\n", path.c_str());
+                data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {
+        .sType              = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .initialDataSize    = data.size(),
+        .pInitialData       = data.empty() ? nullptr : data.data(),
+    };
+
+    VkResult result = vkCreatePipelineCache(device, &createInfo, nullptr, &m_cache);
+    if (result != VK_SUCCESS && !data.empty()) {
+        // Retry without the stored data
+        createInfo.initialDataSize  = 0;
+        createInfo.pInitialData     = nullptr;
+        data.clear();
+
+        result = vkCreatePipelineCache(device, &createInfo, nullptr, &m_cache);
+    }
+
+    if (result != VK_SUCCESS) {
+        printf("[PipelineCache] Pipeline cache creation failed (error code: %d)\n", result);
+        m_cache = VK_NULL_HANDLE;
+        return result;
+    }
+
+    m_warm = !data.empty();
+    printf("[PipelineCache] %s start, %zu bytes loaded from '%s'\n", m_warm ? "Warm" : "Cold", data.size(), path.c_str());
+
+    return VK_SUCCESS;
+}
+
+bool PipelineCache::Save() const {
+    if (m_cache == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    size_t dataSize = 0;
+    VkResult result = vkGetPipelineCacheData(m_device, m_cache, &dataSize, nullptr);
+    if (result != VK_SUCCESS || dataSize == 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> data(dataSize);
+    result = vkGetPipelineCacheData(m_device, m_cache, &dataSize, data.data());
+    if (result != VK_SUCCESS) {
+        printf("[PipelineCache] Failed to query the cache data (error code: %d)\n", result);
+        return false;
+    }
+
+    FileHeader header = m_expected;
+    header.dataSize = dataSize;
+
+    // Write to a temporary file first so an interrupted save never leaves a broken cache behind
+    const std::string tmpPath = m_path + ".tmp";
+
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        printf("[PipelineCache] Unable to open '%s' for writing\n", tmpPath.c_str());
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    written = written && fwrite(data.data(), 1, dataSize, file) == dataSize;
+    written = (fclose(file) == 0) && written;
+
+    if (!written) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    remove(m_path.c_str());
+    if (rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+        printf("[PipelineCache] Unable to replace '%s'\n", m_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void PipelineCache::Destroy() {
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+#include <vulkan/vulkan_core.h>
+
+// VkPipelineCache backed by a file: loaded at startup, written back with "Save".
+// The stored data is only used if it was written on the same vendor, device and driver,
+// otherwise the cache starts empty (and is overwritten on save).
+class PipelineCache {
+public:
+    VkResult Load(const VkPhysicalDevice phyDevice, const VkDevice device, const std::string& path);
+    bool Save() const;
+
+    void Destroy();
+
+    VkPipelineCache Handle() const { return m_cache; }
+    // true if the cache was created from the file contents (warm start)
+    bool IsWarm() const { return m_warm; }
+
+private:
+    VkDevice        m_device    = VK_NULL_HANDLE;
+    VkPipelineCache m_cache     = VK_NULL_HANDLE;
+    std::string     m_path;
+    bool            m_warm      = false;
+
+    // Written before the driver's cache data
+    struct FileHeader {
+        uint32_t    magic;
+        uint32_t    version;
+        uint32_t    vendorID;
+        uint32_t    deviceID;
+        uint32_t    driverVersion;
+        uint8_t     driverUUID[VK_UUID_SIZE];
+        uint64_t    dataSize;
+    };
+
+    FileHeader      m_expected  = {};
+    uint8_t         m_cacheUUID[VK_UUID_SIZE] = {};
+};
@@ -0,0 +1,10 @@
+#include "pipeline_compiler.h"
+
+PipelineCompiler::PipelineCompiler(const VkPipelineCache pipelineCache, uint32_t workerCount)
+    : m_pipelineCache(pipelineCache)
+    , m_workers(std::make_unique<ThreadPool>(workerCount)) {
+}
+
+void PipelineCompiler::WaitIdle() {
+    m_workers->WaitIdle();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <type_traits>
+
+#include <vulkan/vulkan_core.h>
+
+#include "thread_pool.h"
+
+// Builds pipelines on a worker pool against one shared VkPipelineCache.
+// A build task is a pipeline description in the form of a callable receiving the cache,
+// it must create every object it needs (shader modules, etc.) itself and return the result.
+// The cache must not be created with VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT,
+// as multiple threads call vkCreate*Pipelines with it at the same time.
+class PipelineCompiler {
+public:
+    // 0 workers means one per hardware thread (minus the main thread).
+    PipelineCompiler(const VkPipelineCache pipelineCache, uint32_t workerCount = 0);
+
+    // Queues the build, the returned future is ready when the task finished on a worker.
+    template<typename Task>
+    auto Compile(Task&& task) -> std::future<std::invoke_result_t<Task, VkPipelineCache>> {
+        using Result = std::invoke_result_t<Task, VkPipelineCache>;
+
+        // std::function needs a copyable callable, the task is shared instead
+        auto packaged = std::make_shared<std::packaged_task<Result(VkPipelineCache)>>(std::forward<Task>(task));
+        std::future<Result> result = packaged->get_future();
+
+        m_submitted++;
+        m_workers->Enqueue([this, packaged]() {
+            (*packaged)(m_pipelineCache);
+            m_completed++;
+        });
+
+        return result;
+    }
+
+    // Blocks until every queued build is finished.
+    void WaitIdle();
+
+    uint32_t WorkerCount() const { return m_workers->ThreadCount(); }
+    uint32_t SubmittedCount() const { return m_submitted; }
+    uint32_t CompletedCount() const { return m_completed; }
+
+private:
+    VkPipelineCache                 m_pipelineCache;
+    std::atomic<uint32_t>           m_submitted = 0;
+    std::atomic<uint32_t>           m_completed = 0;
+
+    // Declared last: destroyed (and drained) first, while the members above are still alive
+    std::unique_ptr<ThreadPool>     m_workers;
+};
@@ -0,0 +1,55 @@
+#include "pipeline_library.h"
+
+#include "device_extensions.h"
+
+GraphicsPipelineLibrary GraphicsPipelineLibrary::Query(const VkPhysicalDevice phyDevice) {
+    GraphicsPipelineLibrary result;
+
+    // The feature and property structures may only be chained if the extension is present
+    if (!HasDeviceExtension(phyDevice, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)
+        || !HasDeviceExtension(phyDevice, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+        return result;
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures = {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &features;
+
+    vkGetPhysicalDeviceFeatures2(phyDevice, &deviceFeatures);
+
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+
+    VkPhysicalDeviceProperties2 deviceProperties = {};
+    deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    deviceProperties.pNext = &properties;
+
+    vkGetPhysicalDeviceProperties2(phyDevice, &deviceProperties);
+
+    result.m_supported = features.graphicsPipelineLibrary == VK_TRUE
+                      && properties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+
+    return result;
+}
+
+void GraphicsPipelineLibrary::AppendExtensions(std::vector<const char*>& extensions) const {
+    if (m_supported) {
+        extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    }
+}
+
+void* GraphicsPipelineLibrary::FeatureChain(void* pNext) {
+    if (m_supported) {
+        m_features = {};
+        m_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+        m_features.pNext = pNext;
+        m_features.graphicsPipelineLibrary = VK_TRUE;
+        pNext = &m_features;
+    }
+
+    return pNext;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// VK_EXT_graphics_pipeline_library support: pipelines are built from separately compiled
+// vertex input, pre-rasterization, fragment shader and fragment output libraries (see PipelineRegistry::UseLibraries).
+// Only used when the device can link the libraries fast, otherwise a link is as slow as a full compile.
+class GraphicsPipelineLibrary {
+public:
+    // Checks the extensions, the feature and the fast linking property.
+    static GraphicsPipelineLibrary Query(const VkPhysicalDevice phyDevice);
+
+    // Device creation: adds the extensions and links the feature structure in front of "pNext".
+    // The returned chain points into this object.
+    void AppendExtensions(std::vector<const char*>& extensions) const;
+    void* FeatureChain(void* pNext);
+
+    bool IsSupported() const { return m_supported; }
+
+private:
+    bool    m_supported = false;
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT  m_features = {};
+};
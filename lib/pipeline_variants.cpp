@@ -0,0 +1,160 @@
+#include "pipeline_variants.h"
+
+#include <chrono>
+#include <cstdio>
+
+#include "pipeline_builder.h"
+
+void PipelineVariants::Init(PipelineCompiler& compiler, uint32_t variantCount, Build build) {
+    m_compiler  = &compiler;
+    m_build     = std::move(build);
+    m_slots     = std::vector<Slot>(variantCount);
+}
+
+VkPipeline PipelineVariants::Get(uint32_t variant, VkPipeline fallback) {
+    Collect(false);
+
+    Slot& slot = m_slots[variant];
+    slot.stats.requested = true;
+
+    if (slot.pipeline != VK_NULL_HANDLE) {
+        m_last = slot.pipeline;
+        return slot.pipeline;
+    }
+
+    if (!slot.build.valid() && !slot.failed) {
+        Queue(variant);
+    }
+
+    slot.stats.fallbackCount++;
+    return m_last != VK_NULL_HANDLE ? m_last : fallback;
+}
+
+void PipelineVariants::Warm(uint32_t variant) {
+    Slot& slot = m_slots[variant];
+    slot.stats.requested = true;
+
+    if (slot.pipeline == VK_NULL_HANDLE && !slot.build.valid() && !slot.failed) {
+        Queue(variant);
+    }
+}
+
+void PipelineVariants::WarmAll() {
+    for (uint32_t variant = 0; variant < m_slots.size(); variant++) {
+        Warm(variant);
+    }
+}
+
+void PipelineVariants::Wait() {
+    // Outdated builds are queued again while collecting
+    while (PendingCount() > 0) {
+        Collect(true);
+    }
+}
+
+void PipelineVariants::Rebuild() {
+    m_generation++;
+
+    for (uint32_t variant = 0; variant < m_slots.size(); variant++) {
+        Slot& slot = m_slots[variant];
+        if (!slot.stats.requested) {
+            continue;
+        }
+
+        slot.failed = false;
+
+        // A build already in flight may use the old shaders, it is repeated after it finished (Collect)
+        if (!slot.build.valid()) {
+            Queue(variant);
+        }
+    }
+}
+
+std::vector<VkPipeline> PipelineVariants::TakeRetired() {
+    Collect(false);
+
+    std::vector<VkPipeline> retired;
+    retired.swap(m_retired);
+
+    return retired;
+}
+
+void PipelineVariants::Destroy(const VkDevice device) {
+    for (Slot& slot : m_slots) {
+        // Not collected, an outdated build would be queued again
+        if (slot.build.valid()) {
+            PipelineRegistry::Get(device).Release(slot.build.get().pipeline);
+        }
+        PipelineRegistry::Get(device).Release(slot.pipeline);
+    }
+    for (VkPipeline pipeline : m_retired) {
+        PipelineRegistry::Get(device).Release(pipeline);
+    }
+
+    m_slots.clear();
+    m_retired.clear();
+    m_last = VK_NULL_HANDLE;
+}
+
+uint32_t PipelineVariants::PendingCount() const {
+    uint32_t count = 0;
+    for (const Slot& slot : m_slots) {
+        count += slot.build.valid() ? 1 : 0;
+    }
+
+    return count;
+}
+
+void PipelineVariants::Queue(uint32_t variant) {
+    Slot& slot = m_slots[variant];
+    slot.stats.buildCount++;
+
+    const Build build           = m_build;
+    const uint64_t generation   = m_generation;
+
+    slot.build = m_compiler->Compile([build, variant, generation](VkPipelineCache pipelineCache) {
+        const auto start = std::chrono::steady_clock::now();
+        VkPipeline pipeline = build(variant, pipelineCache);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        return Built{ pipeline, elapsed.count(), generation };
+    });
+}
+
+void PipelineVariants::Collect(bool wait) {
+    for (uint32_t variant = 0; variant < m_slots.size(); variant++) {
+        Slot& slot = m_slots[variant];
+        if (!slot.build.valid()) {
+            continue;
+        }
+
+        if (!wait && slot.build.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            continue;
+        }
+
+        const Built built = slot.build.get();
+        slot.stats.lastBuildMs = built.buildMs;
+
+        if (built.pipeline == VK_NULL_HANDLE) {
+            // The previous pipeline (if any) stays
+            printf("[PipelineVariants] Variant %u failed to build\n", variant);
+            slot.stats.failedCount++;
+            slot.failed = true;
+        } else {
+            if (slot.pipeline != VK_NULL_HANDLE) {
+                if (m_last == slot.pipeline) {
+                    m_last = built.pipeline;
+                }
+                m_retired.push_back(slot.pipeline);
+            }
+
+            slot.pipeline       = built.pipeline;
+            slot.stats.ready    = true;
+            slot.failed         = false;
+        }
+
+        if (built.generation != m_generation) {
+            Queue(variant);
+        }
+    }
+}
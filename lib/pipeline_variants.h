@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "pipeline_compiler.h"
+
+// Lazily built set of pipeline variants (shader combinations, specializations, etc.).
+// A variant is compiled on the PipelineCompiler the first time it is requested, until it is ready
+// Get answers with an already built pipeline, so selecting a new variant never blocks a frame.
+// The methods must be called from one thread (the render loop), only the builds run on the workers.
+class PipelineVariants {
+public:
+    // Creates one variant (usually through PipelineRegistry), VK_NULL_HANDLE on failure.
+    // Runs on the compiler's workers: it must not use anything the render loop modifies.
+    using Build = std::function<VkPipeline(uint32_t variant, VkPipelineCache pipelineCache)>;
+
+    // Per variant numbers to decide which variants are worth building up front (Warm)
+    struct VariantStats {
+        bool        requested       = false;    // Get or Warm was called
+        bool        ready           = false;
+        uint32_t    buildCount      = 0;
+        uint32_t    failedCount     = 0;
+        double      lastBuildMs     = 0.0;      // time of the last build on the worker
+        uint64_t    fallbackCount   = 0;        // Get calls answered with a fallback pipeline
+    };
+
+    void Init(PipelineCompiler& compiler, uint32_t variantCount, Build build);
+
+    // The pipeline of "variant" if it is built. Otherwise queues its build and returns the last pipeline
+    // returned by the set (a switch keeps the previous variant on screen), or "fallback" if there is none.
+    VkPipeline Get(uint32_t variant, VkPipeline fallback = VK_NULL_HANDLE);
+    // The built pipeline of "variant" (VK_NULL_HANDLE if there is none yet), nothing is queued.
+    VkPipeline Current(uint32_t variant) const { return m_slots[variant].pipeline; }
+
+    // Queues the build of a variant without using it. A variant which failed to build is only queued
+    // again by Rebuild (the shaders have to change first).
+    void Warm(uint32_t variant);
+    void WarmAll();
+
+    // Blocks until the queued builds are finished.
+    void Wait();
+
+    // Rebuilds every requested variant (shader hot reload), the current pipelines are used until
+    // their replacements are ready. The replaced pipelines are collected by TakeRetired.
+    void Rebuild();
+
+    // Pipelines replaced by a Rebuild, the caller releases them (PipelineRegistry) once no frame uses them.
+    std::vector<VkPipeline> TakeRetired();
+
+    // Waits for the pending builds, then releases every pipeline of the set.
+    void Destroy(const VkDevice device);
+
+    uint32_t VariantCount() const { return (uint32_t)m_slots.size(); }
+    uint32_t PendingCount() const;
+    const VariantStats& Stats(uint32_t variant) const { return m_slots[variant].stats; }
+
+private:
+    struct Built {
+        VkPipeline  pipeline;
+        double      buildMs;
+        uint64_t    generation;
+    };
+
+    struct Slot {
+        VkPipeline          pipeline    = VK_NULL_HANDLE;
+        std::future<Built>  build;
+        VariantStats        stats;
+        bool                failed      = false;    // not queued again until the next Rebuild
+    };
+
+    void Queue(uint32_t variant);
+    // Takes the finished builds, the ones started before the last Rebuild are queued again
+    void Collect(bool wait);
+
+    PipelineCompiler*           m_compiler      = nullptr;
+    Build                       m_build;
+    std::vector<Slot>           m_slots;
+    std::vector<VkPipeline>     m_retired;
+    VkPipeline                  m_last          = VK_NULL_HANDLE;
+    uint64_t                    m_generation    = 0;    // number of Rebuild calls
+};
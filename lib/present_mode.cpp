@@ -0,0 +1,74 @@
+#include "present_mode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+VkPresentModeKHR SelectPresentMode(const VkPhysicalDevice phyDevice, const VkSurfaceKHR surface,
+                                   PresentModePolicy policy) {
+    uint32_t modeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(phyDevice, surface, &modeCount, nullptr);
+
+    std::vector<VkPresentModeKHR> modes(modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(phyDevice, surface, &modeCount, modes.data());
+
+    const auto isSupported = [&modes](VkPresentModeKHR mode) {
+        return std::find(modes.begin(), modes.end(), mode) != modes.end();
+    };
+
+    switch (policy) {
+    case PresentModePolicy::Immediate:
+        if (isSupported(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+            return VK_PRESENT_MODE_IMMEDIATE_KHR;
+        }
+        [[fallthrough]];
+    case PresentModePolicy::Mailbox:
+        if (isSupported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+            return VK_PRESENT_MODE_MAILBOX_KHR;
+        }
+        [[fallthrough]];
+    case PresentModePolicy::Fifo:
+        break;
+    }
+
+    // The only mode every implementation must support
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t SelectSwapchainImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode) {
+    uint32_t imageCount = capabilities.minImageCount;
+    if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        imageCount++;
+    }
+
+    // maxImageCount == 0: no limit
+    if (capabilities.maxImageCount > 0) {
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+
+    return imageCount;
+}
+
+bool ParsePresentModePolicy(const char* text, PresentModePolicy* outPolicy) {
+    if (strcmp(text, "fifo") == 0) {
+        *outPolicy = PresentModePolicy::Fifo;
+    } else if (strcmp(text, "mailbox") == 0) {
+        *outPolicy = PresentModePolicy::Mailbox;
+    } else if (strcmp(text, "immediate") == 0) {
+        *outPolicy = PresentModePolicy::Immediate;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+const char* PresentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:     return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:       return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:          return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:  return "FIFO_RELAXED";
+    default:                                return "UNKNOWN";
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan_core.h>
+
+// How frames are handed to the presentation engine:
+//  - Fifo:      vsync, the CPU/GPU are throttled to the display rate (always supported)
+//  - Mailbox:   vsync without throttling, the newest finished image replaces the queued one
+//  - Immediate: no vsync, lowest latency, may tear
+enum class PresentModePolicy : uint32_t {
+    Fifo,
+    Mailbox,
+    Immediate,
+};
+
+// The mode of the policy if the surface supports it, otherwise the nearest supported one
+// (Immediate -> Mailbox -> Fifo, Mailbox -> Fifo).
+VkPresentModeKHR SelectPresentMode(const VkPhysicalDevice phyDevice, const VkSurfaceKHR surface,
+                                   PresentModePolicy policy);
+
+// Swapchain image count for "presentMode": Mailbox needs an extra image to always have a free one.
+uint32_t SelectSwapchainImageCount(const VkSurfaceCapabilitiesKHR& capabilities, VkPresentModeKHR presentMode);
+
+// "fifo", "mailbox" or "immediate", returns false for anything else.
+bool ParsePresentModePolicy(const char* text, PresentModePolicy* outPolicy);
+
+const char* PresentModeName(VkPresentModeKHR presentMode);
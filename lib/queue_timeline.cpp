@@ -0,0 +1,337 @@
+#include "queue_timeline.h"
+
+#include <cstdio>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+
+#include "device_extensions.h"
+#include "device_registry.h"
+
+using TimelineRegistry = DeviceRegistry<QueueTimeline, std::pair<VkDevice, VkQueue>>;
+
+static std::mutex s_devicesMutex;
+
+// Devices created with the timelineSemaphore feature
+static std::unordered_set<VkDevice>& TimelineDevices() {
+    static auto* devices = new std::unordered_set<VkDevice>();
+    return *devices;
+}
+
+TimelineSemaphore TimelineSemaphore::Query(const VkPhysicalDevice phyDevice) {
+    TimelineSemaphore result;
+
+    // The feature structure may only be chained if the extension is present
+    if (!HasDeviceExtension(phyDevice, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        return result;
+    }
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures features = {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+    VkPhysicalDeviceFeatures2 deviceFeatures = {};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &features;
+
+    vkGetPhysicalDeviceFeatures2(phyDevice, &deviceFeatures);
+
+    result.m_supported = features.timelineSemaphore == VK_TRUE;
+
+    return result;
+}
+
+void TimelineSemaphore::AppendExtensions(std::vector<const char*>& extensions) const {
+    if (m_supported) {
+        extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+    }
+}
+
+void* TimelineSemaphore::FeatureChain(void* pNext) {
+    if (m_supported) {
+        m_features = {};
+        m_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        m_features.pNext = pNext;
+        m_features.timelineSemaphore = VK_TRUE;
+        pNext = &m_features;
+    }
+
+    return pNext;
+}
+
+void TimelineSemaphore::Enable(const VkDevice device) const {
+    if (m_supported) {
+        std::lock_guard<std::mutex> lock(s_devicesMutex);
+        TimelineDevices().insert(device);
+    }
+}
+
+QueueTimeline& QueueTimeline::Get(const VkDevice device, const VkQueue queue) {
+    return TimelineRegistry::Get({ device, queue }, [&]() {
+        std::lock_guard<std::mutex> lock(s_devicesMutex);
+        return std::make_unique<QueueTimeline>(device, queue, TimelineDevices().count(device) > 0);
+    });
+}
+
+void QueueTimeline::Destroy(const VkDevice device) {
+    // The destructors wait and run the deferred calls, which may use the registry
+    TimelineRegistry::Destroy(device);
+
+    std::lock_guard<std::mutex> lock(s_devicesMutex);
+    TimelineDevices().erase(device);
+}
+
+#define VK_LOAD_DEVICE_PFN(device, name) reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name))
+
+QueueTimeline::QueueTimeline(const VkDevice device, const VkQueue queue, bool useTimelineSemaphore)
+    : m_device(device)
+    , m_queue(queue) {
+
+    if (!useTimelineSemaphore) {
+        return;
+    }
+
+    m_getCounterValue = VK_LOAD_DEVICE_PFN(device, vkGetSemaphoreCounterValueKHR);
+    m_waitSemaphores  = VK_LOAD_DEVICE_PFN(device, vkWaitSemaphoresKHR);
+    if (!m_getCounterValue || !m_waitSemaphores) {
+        printf("[QueueTimeline] Timeline semaphore entry points are missing, using fences\n");
+        return;
+    }
+
+    const VkSemaphoreTypeCreateInfo typeInfo = {
+        .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext          = nullptr,
+        .semaphoreType  = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue   = 0,
+    };
+
+    const VkSemaphoreCreateInfo createInfo = {
+        .sType  = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext  = &typeInfo,
+        .flags  = 0,
+    };
+
+    VkResult result = vkCreateSemaphore(device, &createInfo, nullptr, &m_semaphore);
+    if (result != VK_SUCCESS) {
+        printf("[QueueTimeline] Timeline semaphore creation failed (error code: %d), using fences\n", result);
+        m_semaphore = VK_NULL_HANDLE;
+    }
+}
+
+QueueTimeline::~QueueTimeline() {
+    WaitIdle();
+
+    if (m_semaphore != VK_NULL_HANDLE) {
+        vkDestroySemaphore(m_device, m_semaphore, nullptr);
+    }
+}
+
+uint64_t QueueTimeline::Submit(const VkSubmitInfo& submitInfo) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint64_t value = m_lastSubmitted + 1;
+    VkResult result = VK_SUCCESS;
+
+    if (m_semaphore != VK_NULL_HANDLE) {
+        std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores,
+                                                  submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+        signalSemaphores.push_back(m_semaphore);
+
+        // The values of binary semaphores are ignored
+        std::vector<uint64_t> signalValues(submitInfo.signalSemaphoreCount, 0);
+        signalValues.push_back(value);
+        const std::vector<uint64_t> waitValues(submitInfo.waitSemaphoreCount, 0);
+
+        const VkTimelineSemaphoreSubmitInfo timelineInfo = {
+            .sType                      = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .pNext                      = submitInfo.pNext,
+            .waitSemaphoreValueCount    = (uint32_t)waitValues.size(),
+            .pWaitSemaphoreValues       = waitValues.data(),
+            .signalSemaphoreValueCount  = (uint32_t)signalValues.size(),
+            .pSignalSemaphoreValues     = signalValues.data(),
+        };
+
+        VkSubmitInfo timelineSubmit = submitInfo;
+        timelineSubmit.pNext                = &timelineInfo;
+        timelineSubmit.signalSemaphoreCount = (uint32_t)signalSemaphores.size();
+        timelineSubmit.pSignalSemaphores    = signalSemaphores.data();
+
+        result = vkQueueSubmit(m_queue, 1, &timelineSubmit, VK_NULL_HANDLE);
+    } else {
+        const VkFenceCreateInfo fenceInfo = {
+            .sType  = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext  = nullptr,
+            .flags  = 0,
+        };
+
+        VkFence fence = VK_NULL_HANDLE;
+        result = vkCreateFence(m_device, &fenceInfo, nullptr, &fence);
+        if (result == VK_SUCCESS) {
+            result = vkQueueSubmit(m_queue, 1, &submitInfo, fence);
+        }
+
+        if (result == VK_SUCCESS) {
+            m_fences.push_back({ value, fence });
+        } else if (fence != VK_NULL_HANDLE) {
+            vkDestroyFence(m_device, fence, nullptr);
+        }
+    }
+
+    if (result != VK_SUCCESS) {
+        printf("[QueueTimeline] Submit failed (error code: %d)\n", result);
+        return 0;
+    }
+
+    m_lastSubmitted = value;
+
+    return value;
+}
+
+uint64_t QueueTimeline::LastSubmitted() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastSubmitted;
+}
+
+uint64_t QueueTimeline::Completed() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return QueryCompleted();
+}
+
+bool QueueTimeline::IsComplete(uint64_t value) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return value <= m_completed || value <= QueryCompleted();
+}
+
+VkResult QueueTimeline::Wait(uint64_t value) {
+    VkFence fence = VK_NULL_HANDLE;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (value <= m_completed) {
+            return VK_SUCCESS;
+        }
+
+        if (value > m_lastSubmitted) {
+            printf("[QueueTimeline] Waiting for value %llu which was never submitted\n", (unsigned long long)value);
+            return VK_ERROR_UNKNOWN;
+        }
+
+        if (m_semaphore == VK_NULL_HANDLE) {
+            // The first submit with at least "value", the earlier ones finished before it
+            for (const PendingFence& pending : m_fences) {
+                if (pending.value >= value) {
+                    fence = pending.fence;
+                    break;
+                }
+            }
+
+            if (fence == VK_NULL_HANDLE) {
+                QueryCompleted();
+                return VK_SUCCESS;
+            }
+        }
+
+        // Keeps the fence alive while the lock is released
+        m_waiterCount++;
+    }
+
+    // Without the lock: the other threads may submit and query meanwhile
+    VkResult result = VK_SUCCESS;
+    if (m_semaphore != VK_NULL_HANDLE) {
+        const VkSemaphoreWaitInfo waitInfo = {
+            .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext          = nullptr,
+            .flags          = 0,
+            .semaphoreCount = 1,
+            .pSemaphores    = &m_semaphore,
+            .pValues        = &value,
+        };
+
+        result = m_waitSemaphores(m_device, &waitInfo, UINT64_MAX);
+    } else {
+        result = vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_waiterCount--;
+    if (result == VK_SUCCESS) {
+        QueryCompleted();
+    }
+
+    if (m_waiterCount == 0) {
+        for (VkFence retired : m_retiredFences) {
+            vkDestroyFence(m_device, retired, nullptr);
+        }
+        m_retiredFences.clear();
+    }
+
+    if (result != VK_SUCCESS) {
+        printf("[QueueTimeline] Wait failed (error code: %d)\n", result);
+        return result;
+    }
+
+    return VK_SUCCESS;
+}
+
+VkResult QueueTimeline::WaitIdle() {
+    const VkResult result = Wait(LastSubmitted());
+
+    Collect();
+
+    return result;
+}
+
+void QueueTimeline::Defer(std::function<void()> call) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_deferred.push_back({ m_lastSubmitted, std::move(call) });
+}
+
+void QueueTimeline::Collect() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_deferred.empty() && m_deferred.front().value > m_completed) {
+            QueryCompleted();
+        }
+
+        while (!m_deferred.empty() && m_deferred.front().value <= m_completed) {
+            ready.push_back(std::move(m_deferred.front().call));
+            m_deferred.pop_front();
+        }
+    }
+
+    // Outside of the lock, the calls may use the timeline too
+    for (std::function<void()>& call : ready) {
+        call();
+    }
+}
+
+size_t QueueTimeline::DeferredCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_deferred.size();
+}
+
+uint64_t QueueTimeline::QueryCompleted() {
+    if (m_semaphore != VK_NULL_HANDLE) {
+        uint64_t value = 0;
+        if (m_getCounterValue(m_device, m_semaphore, &value) == VK_SUCCESS) {
+            m_completed = value;
+        }
+    } else {
+        // Submits finish in order, only the oldest ones have to be checked
+        while (!m_fences.empty() && vkGetFenceStatus(m_device, m_fences.front().fence) == VK_SUCCESS) {
+            m_completed = m_fences.front().value;
+
+            // A Wait outside of the lock may still use it
+            if (m_waiterCount > 0) {
+                m_retiredFences.push_back(m_fences.front().fence);
+            } else {
+                vkDestroyFence(m_device, m_fences.front().fence, nullptr);
+            }
+            m_fences.pop_front();
+        }
+    }
+
+    return m_completed;
+}
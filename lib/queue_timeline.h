@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// VK_KHR_timeline_semaphore support (core since Vulkan 1.2, the samples create 1.1 devices).
+class TimelineSemaphore {
+public:
+    // Checks the extension and its feature.
+    static TimelineSemaphore Query(const VkPhysicalDevice phyDevice);
+
+    // Device creation: adds the extension and links the feature structure in front of "pNext".
+    // The returned chain points into this object.
+    void AppendExtensions(std::vector<const char*>& extensions) const;
+    void* FeatureChain(void* pNext);
+
+    // Call after the device creation, before the first QueueTimeline::Get of the device:
+    // its timelines use timeline semaphores instead of one fence per submit.
+    void Enable(const VkDevice device) const;
+
+    bool IsSupported() const { return m_supported; }
+
+private:
+    bool    m_supported = false;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures   m_features = {};
+};
+
+// GPU progress of one queue as a monotonic counter: every submit through the timeline signals the
+// next value, so anything used by a submit is free once the counter reached the submit's value.
+// Uploads, frames and deferred deletes all wait on these values instead of their own fences,
+// and "is it still in use?" is a comparison against the last known counter.
+// Without TimelineSemaphore::Enable the counter is emulated with one fence per submit.
+class QueueTimeline {
+public:
+    static QueueTimeline& Get(const VkDevice device, const VkQueue queue);
+    // Waits for the queues of the device, runs the deferred calls and destroys their timelines.
+    static void Destroy(const VkDevice device);
+
+    // Submits "submitInfo" and signals the next value after it (next to its own signal semaphores).
+    // Returns the value, 0 if the submit failed.
+    uint64_t Submit(const VkSubmitInfo& submitInfo);
+
+    uint64_t LastSubmitted() const;
+    // Queries the counter.
+    uint64_t Completed();
+    // Cheap if the value is already known to be reached, queries the counter otherwise.
+    bool IsComplete(uint64_t value);
+    // Blocks without holding the lock, other threads may submit and query meanwhile.
+    VkResult Wait(uint64_t value);
+
+    // Waits for everything submitted so far and runs the deferred calls.
+    VkResult WaitIdle();
+
+    // Runs "call" once everything submitted so far is finished (e.g. destroying a replaced pipeline).
+    // Work recorded but not yet submitted is not covered.
+    void Defer(std::function<void()> call);
+    // Runs the deferred calls whose value is reached.
+    void Collect();
+
+    bool UsesTimelineSemaphore() const { return m_semaphore != VK_NULL_HANDLE; }
+    size_t DeferredCount() const;
+
+    QueueTimeline(const VkDevice device, const VkQueue queue, bool useTimelineSemaphore);
+    ~QueueTimeline();
+
+private:
+    struct PendingFence {
+        uint64_t    value;
+        VkFence     fence;
+    };
+
+    struct Deferred {
+        uint64_t                value;
+        std::function<void()>   call;
+    };
+
+    // Requires the lock
+    uint64_t QueryCompleted();
+
+    VkDevice                    m_device        = VK_NULL_HANDLE;
+    VkQueue                     m_queue         = VK_NULL_HANDLE;
+    VkSemaphore                 m_semaphore     = VK_NULL_HANDLE;
+
+    PFN_vkGetSemaphoreCounterValueKHR   m_getCounterValue   = nullptr;
+    PFN_vkWaitSemaphoresKHR             m_waitSemaphores    = nullptr;
+
+    mutable std::mutex          m_mutex;
+    uint64_t                    m_lastSubmitted = 0;
+    uint64_t                    m_completed     = 0;
+    std::deque<PendingFence>    m_fences;       // without timeline semaphore, in submission order
+    std::deque<Deferred>        m_deferred;     // in value order
+    uint32_t                    m_waiterCount   = 0;    // Waits in progress without the lock
+    std::vector<VkFence>        m_retiredFences;        // signaled, destroyed once no Wait is in progress
+};
@@ -0,0 +1,100 @@
+#include "reusable_commands.h"
+
+#include <cstdio>
+
+ReusableCommands ReusableCommands::Create(const VkDevice device, uint32_t queueFamilyIdx, uint32_t slotCount) {
+    ReusableCommands commands;
+    commands.m_device = device;
+
+    // Not transient: the buffers live until their inputs change
+    const VkCommandPoolCreateInfo poolInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queueFamilyIdx,
+    };
+
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &commands.m_cmdPool);
+    if (result != VK_SUCCESS) {
+        printf("[ReusableCommands] Command pool creation failed (error code: %d)\n", result);
+        return commands;
+    }
+
+    std::vector<VkCommandBuffer> cmdBuffers(slotCount, VK_NULL_HANDLE);
+    const VkCommandBufferAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = commands.m_cmdPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = slotCount,
+    };
+
+    result = vkAllocateCommandBuffers(device, &allocInfo, cmdBuffers.data());
+    if (result != VK_SUCCESS) {
+        printf("[ReusableCommands] Command buffer allocation failed (error code: %d)\n", result);
+        return commands;
+    }
+
+    commands.m_slots.resize(slotCount);
+    for (uint32_t idx = 0; idx < slotCount; idx++) {
+        commands.m_slots[idx].cmdBuffer = cmdBuffers[idx];
+    }
+
+    return commands;
+}
+
+VkCommandBuffer ReusableCommands::Get(uint32_t slot, const Key& key, const Record& record) {
+    if (slot >= m_slots.size()) {
+        return VK_NULL_HANDLE;
+    }
+
+    Slot& entry = m_slots[slot];
+    if (entry.valid && entry.key == key) {
+        return entry.cmdBuffer;
+    }
+
+    // No one time submit flag: the buffer is submitted again in the following frames of the slot
+    const VkCommandBufferBeginInfo beginInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .pInheritanceInfo   = nullptr,
+    };
+
+    // Resets the previous recording
+    vkBeginCommandBuffer(entry.cmdBuffer, &beginInfo);
+    record(entry.cmdBuffer);
+
+    m_recordCount++;
+
+    VkResult result = vkEndCommandBuffer(entry.cmdBuffer);
+    if (result != VK_SUCCESS) {
+        printf("[ReusableCommands] Recording slot %u failed (error code: %d)\n", slot, result);
+        entry.valid = false;
+        return VK_NULL_HANDLE;
+    }
+
+    entry.key   = key;
+    entry.valid = true;
+
+    return entry.cmdBuffer;
+}
+
+void ReusableCommands::Invalidate() {
+    for (Slot& slot : m_slots) {
+        slot.valid = false;
+    }
+}
+
+void ReusableCommands::Destroy() {
+    if (m_device == VK_NULL_HANDLE) {
+        return;
+    }
+
+    // Frees the command buffers too
+    vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+
+    m_slots.clear();
+    m_cmdPool = VK_NULL_HANDLE;
+    m_device  = VK_NULL_HANDLE;
+}
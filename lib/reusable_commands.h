@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+// Primary command buffers which are recorded once and submitted every frame until their inputs change.
+// One buffer per frame slot: a slot is only recorded again after its previous submit finished
+// (see FramesInFlight::Begin), so the buffers need no simultaneous use.
+// The recorded commands must not contain per frame values: those go into buffers referenced by the commands
+// (e.g. a FrameRingBuffer region, its dynamic offset is the same for a slot every frame).
+class ReusableCommands {
+public:
+    using Record = std::function<void(VkCommandBuffer cmdBuffer)>;
+    // Everything the recording depends on (pipelines, buffers, offsets, toggles) flattened into words
+    using Key = std::vector<uint64_t>;
+
+    static ReusableCommands Create(const VkDevice device, uint32_t queueFamilyIdx, uint32_t slotCount);
+
+    // The command buffer of "slot", recorded with "record" first if "key" differs from the key of its recording.
+    // Returns VK_NULL_HANDLE if the recording failed.
+    VkCommandBuffer Get(uint32_t slot, const Key& key, const Record& record);
+
+    // Every slot is recorded again on its next Get (e.g. after a descriptor set used by the commands was updated).
+    void Invalidate();
+
+    // Recordings so far, stays flat while the inputs do not change
+    uint64_t RecordCount() const { return m_recordCount; }
+
+    // The device must be idle.
+    void Destroy();
+
+private:
+    struct Slot {
+        VkCommandBuffer cmdBuffer   = VK_NULL_HANDLE;
+        Key             key;
+        bool            valid       = false;
+    };
+
+    VkDevice            m_device        = VK_NULL_HANDLE;
+    VkCommandPool       m_cmdPool       = VK_NULL_HANDLE;
+    std::vector<Slot>   m_slots;
+    uint64_t            m_recordCount   = 0;
+};
@@ -0,0 +1,90 @@
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameRingBuffer FrameRingBuffer::Create(
+    const VkPhysicalDevice  phyDevice,
+    const VkDevice          device,
+    VkDeviceSize            frameSize,
+    uint32_t                frameCount,
+    VkBufferUsageFlags      usageFlags) {
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+
+    // Dynamic offsets must respect the offset alignment, and regions must start at
+    // a "nonCoherentAtomSize" boundary so flushing a region never touches its neighbour.
+    VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 1);
+    if (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        alignment = std::max(alignment, properties.limits.minUniformBufferOffsetAlignment);
+    }
+    if (usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        alignment = std::max(alignment, properties.limits.minStorageBufferOffsetAlignment);
+    }
+
+    FrameRingBuffer ring;
+    ring.m_alignment  = alignment;
+    ring.m_frameSize  = AlignUp(frameSize, alignment);
+    ring.m_frameCount = frameCount;
+    ring.m_buffer     = BufferInfo::Create(phyDevice, device, ring.m_frameSize * frameCount, usageFlags);
+
+    return ring;
+}
+
+void FrameRingBuffer::BeginFrame(uint32_t frameIdx) {
+    m_frameIdx    = frameIdx % m_frameCount;
+    m_head        = 0;
+    m_flushedHead = 0;
+}
+
+RingAllocation FrameRingBuffer::Allocate(VkDeviceSize size) {
+    const VkDeviceSize offset = AlignUp(m_head, m_alignment);
+
+    if (offset + size > m_frameSize) {
+        printf("[FrameRingBuffer] Frame region is full (%llu bytes)\n", (unsigned long long)m_frameSize);
+        return {};
+    }
+
+    m_head = offset + size;
+
+    const VkDeviceSize bufferOffset = m_frameIdx * m_frameSize + offset;
+
+    return {
+        .buffer = m_buffer.buffer,
+        .offset = bufferOffset,
+        .size   = size,
+        .ptr    = static_cast<uint8_t*>(m_buffer.allocation.mapped) + bufferOffset,
+    };
+}
+
+RingAllocation FrameRingBuffer::Push(const void* data, VkDeviceSize size) {
+    RingAllocation allocation = Allocate(size);
+
+    if (allocation.IsValid()) {
+        memcpy(allocation.ptr, data, size);
+    }
+
+    return allocation;
+}
+
+void FrameRingBuffer::Flush() {
+    if (m_head == m_flushedHead) {
+        return;
+    }
+
+    const VkDeviceSize regionOffset = m_frameIdx * m_frameSize;
+    m_buffer.allocation.arena->Flush(m_buffer.allocation, regionOffset + m_flushedHead, m_head - m_flushedHead);
+
+    m_flushedHead = m_head;
+}
+
+void FrameRingBuffer::Destroy(const VkDevice device) {
+    m_buffer.Destroy(device);
+    m_buffer = {};
+}
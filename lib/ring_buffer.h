@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan_core.h>
+
+#include "buffer.h"
+
+struct RingAllocation {
+    VkBuffer        buffer  = VK_NULL_HANDLE;
+    VkDeviceSize    offset  = 0;
+    VkDeviceSize    size    = 0;
+    void*           ptr     = nullptr;
+
+    bool IsValid() const { return ptr != nullptr; }
+
+    // For the "pDynamicOffsets" of vkCmdBindDescriptorSets.
+    uint32_t DynamicOffset() const { return (uint32_t)offset; }
+};
+
+// Persistently mapped buffer split into one region per frame in flight.
+// Every frame gets its sub-allocations from its own region, so data written for a frame
+// can not be overwritten while the GPU is still reading the previous frames.
+class FrameRingBuffer {
+public:
+    static FrameRingBuffer Create(
+        const VkPhysicalDevice  phyDevice,
+        const VkDevice          device,
+        VkDeviceSize            frameSize,
+        uint32_t                frameCount,
+        VkBufferUsageFlags      usageFlags = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+
+    // Starts writing into the region of "frameIdx", everything allocated from it before is dropped.
+    void BeginFrame(uint32_t frameIdx);
+
+    // Returns an invalid allocation if the frame's region is full.
+    RingAllocation Allocate(VkDeviceSize size);
+    RingAllocation Push(const void* data, VkDeviceSize size);
+
+    // Flushes the range written in the current frame (no-op for HOST_COHERENT memory).
+    // Must be called before the frame's commands are submitted.
+    void Flush();
+
+    VkBuffer Buffer() const { return m_buffer.buffer; }
+    VkDeviceSize FrameSize() const { return m_frameSize; }
+    uint32_t FrameCount() const { return m_frameCount; }
+    VkDeviceSize Alignment() const { return m_alignment; }
+
+    void Destroy(const VkDevice device);
+
+private:
+    BufferInfo      m_buffer        = {};
+    VkDeviceSize    m_frameSize     = 0;
+    uint32_t        m_frameCount    = 0;
+    VkDeviceSize    m_alignment     = 1;
+
+    uint32_t        m_frameIdx      = 0;
+    VkDeviceSize    m_head          = 0;    // relative to the current region
+    VkDeviceSize    m_flushedHead   = 0;
+};
@@ -0,0 +1,181 @@
+#include "sampler_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "device_registry.h"
+
+SamplerCache& SamplerCache::Get(const VkPhysicalDevice phyDevice, const VkDevice device) {
+    return DeviceRegistry<SamplerCache>::Get(device, [&]() {
+        return std::make_unique<SamplerCache>(phyDevice, device);
+    });
+}
+
+void SamplerCache::Destroy(const VkDevice device) {
+    DeviceRegistry<SamplerCache>::Destroy(device);
+}
+
+SamplerCache::Key SamplerCache::Key::From(const VkSamplerCreateInfo& createInfo) {
+    return {
+        .flags                      = createInfo.flags,
+        .magFilter                  = createInfo.magFilter,
+        .minFilter                  = createInfo.minFilter,
+        .mipmapMode                 = createInfo.mipmapMode,
+        .addressModeU               = createInfo.addressModeU,
+        .addressModeV               = createInfo.addressModeV,
+        .addressModeW               = createInfo.addressModeW,
+        .mipLodBias                 = createInfo.mipLodBias,
+        .anisotropyEnable           = createInfo.anisotropyEnable,
+        .maxAnisotropy              = createInfo.maxAnisotropy,
+        .compareEnable              = createInfo.compareEnable,
+        .compareOp                  = createInfo.compareOp,
+        .minLod                     = createInfo.minLod,
+        .maxLod                     = createInfo.maxLod,
+        .borderColor                = createInfo.borderColor,
+        .unnormalizedCoordinates    = createInfo.unnormalizedCoordinates,
+    };
+}
+
+bool SamplerCache::Key::operator==(const Key& other) const {
+    return flags == other.flags
+        && magFilter == other.magFilter
+        && minFilter == other.minFilter
+        && mipmapMode == other.mipmapMode
+        && addressModeU == other.addressModeU
+        && addressModeV == other.addressModeV
+        && addressModeW == other.addressModeW
+        && mipLodBias == other.mipLodBias
+        && anisotropyEnable == other.anisotropyEnable
+        && maxAnisotropy == other.maxAnisotropy
+        && compareEnable == other.compareEnable
+        && compareOp == other.compareOp
+        && minLod == other.minLod
+        && maxLod == other.maxLod
+        && borderColor == other.borderColor
+        && unnormalizedCoordinates == other.unnormalizedCoordinates;
+}
+
+static void HashCombine(size_t& seed, uint32_t value) {
+    seed ^= std::hash<uint32_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+static uint32_t FloatBits(float value) {
+    // -0.0 and 0.0 compare equal, so they must hash the same
+    if (value == 0.0f) {
+        return 0;
+    }
+
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+size_t SamplerCache::KeyHash::operator()(const Key& key) const {
+    size_t seed = 0;
+    HashCombine(seed, key.flags);
+    HashCombine(seed, key.magFilter);
+    HashCombine(seed, key.minFilter);
+    HashCombine(seed, key.mipmapMode);
+    HashCombine(seed, key.addressModeU);
+    HashCombine(seed, key.addressModeV);
+    HashCombine(seed, key.addressModeW);
+    HashCombine(seed, FloatBits(key.mipLodBias));
+    HashCombine(seed, key.anisotropyEnable);
+    HashCombine(seed, FloatBits(key.maxAnisotropy));
+    HashCombine(seed, key.compareEnable);
+    HashCombine(seed, key.compareOp);
+    HashCombine(seed, FloatBits(key.minLod));
+    HashCombine(seed, FloatBits(key.maxLod));
+    HashCombine(seed, key.borderColor);
+    HashCombine(seed, key.unnormalizedCoordinates);
+
+    return seed;
+}
+
+SamplerCache::SamplerCache(const VkPhysicalDevice phyDevice, const VkDevice device)
+    : m_device(device) {
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(phyDevice, &properties);
+    m_maxSamplerCount = properties.limits.maxSamplerAllocationCount;
+}
+
+SamplerCache::~SamplerCache() {
+    for (auto& [key, entry] : m_entries) {
+        printf("[SamplerCache] Sampler still has %u user(s)\n", entry.refCount);
+        vkDestroySampler(m_device, entry.sampler, nullptr);
+    }
+}
+
+VkResult SamplerCache::Acquire(const VkSamplerCreateInfo& createInfo, VkSampler* outSampler) {
+    if (createInfo.pNext != nullptr) {
+        printf("[SamplerCache] pNext chain of the sampler create info is ignored\n");
+    }
+
+    const Key key = Key::From(createInfo);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        it->second.refCount++;
+        m_hitCount++;
+
+        *outSampler = it->second.sampler;
+        return VK_SUCCESS;
+    }
+
+    if (m_entries.size() >= m_maxSamplerCount) {
+        printf("[SamplerCache] maxSamplerAllocationCount (%u) reached\n", m_maxSamplerCount);
+        return VK_ERROR_TOO_MANY_OBJECTS;
+    }
+
+    VkSamplerCreateInfo info = createInfo;
+    info.pNext = nullptr;
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkResult result = vkCreateSampler(m_device, &info, nullptr, &sampler);
+    if (result != VK_SUCCESS) {
+        printf("[SamplerCache] Sampler creation failed (error code: %d)\n", result);
+        return result;
+    }
+
+    m_entries.emplace(key, Entry{ sampler, 1 });
+    m_keys.emplace(sampler, key);
+
+    *outSampler = sampler;
+    return VK_SUCCESS;
+}
+
+void SamplerCache::Release(VkSampler sampler) {
+    if (sampler == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto keyIt = m_keys.find(sampler);
+    if (keyIt == m_keys.end()) {
+        printf("[SamplerCache] Released sampler is not owned by the cache\n");
+        return;
+    }
+
+    auto it = m_entries.find(keyIt->second);
+    if (--it->second.refCount > 0) {
+        return;
+    }
+
+    vkDestroySampler(m_device, sampler, nullptr);
+    m_entries.erase(it);
+    m_keys.erase(keyIt);
+}
+
+uint32_t SamplerCache::SamplerCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (uint32_t)m_entries.size();
+}
+
+uint64_t SamplerCache::HitCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hitCount;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include <vulkan/vulkan_core.h>
+
+// Shares VkSampler objects between every user requesting the same sampler state.
+// Samplers are reference counted and destroyed when the last user releases them.
+// Create infos with a pNext chain are not supported (the chain is not part of the key).
+class SamplerCache {
+public:
+    // One cache per device, created on first use.
+    static SamplerCache& Get(const VkPhysicalDevice phyDevice, const VkDevice device);
+    // Destroys every sampler still alive, call before vkDestroyDevice.
+    static void Destroy(const VkDevice device);
+
+    // Returns VK_ERROR_TOO_MANY_OBJECTS if a new sampler would exceed "maxSamplerAllocationCount".
+    VkResult Acquire(const VkSamplerCreateInfo& createInfo, VkSampler* outSampler);
+    void Release(VkSampler sampler);
+
+    // Number of unique VkSampler objects alive
+    uint32_t SamplerCount() const;
+    uint32_t MaxSamplerCount() const { return m_maxSamplerCount; }
+    // Number of Acquire calls served by an existing sampler
+    uint64_t HitCount() const;
+
+    SamplerCache(const VkPhysicalDevice phyDevice, const VkDevice device);
+    ~SamplerCache();
+
+private:
+    struct Key {
+        VkSamplerCreateFlags    flags;
+        VkFilter                magFilter;
+        VkFilter                minFilter;
+        VkSamplerMipmapMode     mipmapMode;
+        VkSamplerAddressMode    addressModeU;
+        VkSamplerAddressMode    addressModeV;
+        VkSamplerAddressMode    addressModeW;
+        float                   mipLodBias;
+        VkBool32                anisotropyEnable;
+        float                   maxAnisotropy;
+        VkBool32                compareEnable;
+        VkCompareOp             compareOp;
+        float                   minLod;
+        float                   maxLod;
+        VkBorderColor           borderColor;
+        VkBool32                unnormalizedCoordinates;
+
+        static Key From(const VkSamplerCreateInfo& createInfo);
+        bool operator==(const Key& other) const;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        VkSampler   sampler;
+        uint32_t    refCount;
+    };
+
+    VkDevice                                m_device;
+    uint32_t                                m_maxSamplerCount;
+
+    mutable std::mutex                      m_mutex;
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    std::unordered_map<VkSampler, Key>      m_keys;
+    uint64_t                                m_hitCount = 0;
+};
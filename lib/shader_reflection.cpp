@@ -0,0 +1,441 @@
+#include "shader_reflection.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+
+// Subset of the SPIR-V specification used by the reflection
+namespace spv {
+    constexpr uint32_t kMagic                   = 0x07230203;
+    constexpr uint32_t kHeaderWords             = 5;
+
+    constexpr uint32_t OpEntryPoint             = 15;
+    constexpr uint32_t OpTypeBool               = 20;
+    constexpr uint32_t OpTypeInt                = 21;
+    constexpr uint32_t OpTypeFloat              = 22;
+    constexpr uint32_t OpTypeVector             = 23;
+    constexpr uint32_t OpTypeMatrix             = 24;
+    constexpr uint32_t OpTypeImage              = 25;
+    constexpr uint32_t OpTypeSampler            = 26;
+    constexpr uint32_t OpTypeSampledImage       = 27;
+    constexpr uint32_t OpTypeArray              = 28;
+    constexpr uint32_t OpTypeRuntimeArray       = 29;
+    constexpr uint32_t OpTypeStruct             = 30;
+    constexpr uint32_t OpTypePointer            = 32;
+    constexpr uint32_t OpConstant               = 43;
+    constexpr uint32_t OpSpecConstant           = 50;
+    constexpr uint32_t OpVariable               = 59;
+    constexpr uint32_t OpDecorate               = 71;
+    constexpr uint32_t OpMemberDecorate         = 72;
+
+    constexpr uint32_t DecorationBlock          = 2;
+    constexpr uint32_t DecorationBufferBlock    = 3;
+    constexpr uint32_t DecorationArrayStride    = 6;
+    constexpr uint32_t DecorationMatrixStride   = 7;
+    constexpr uint32_t DecorationBinding        = 33;
+    constexpr uint32_t DecorationDescriptorSet  = 34;
+    constexpr uint32_t DecorationOffset         = 35;
+
+    constexpr uint32_t StorageUniformConstant   = 0;
+    constexpr uint32_t StorageUniform           = 2;
+    constexpr uint32_t StoragePushConstant      = 9;
+    constexpr uint32_t StorageStorageBuffer     = 12;
+
+    constexpr uint32_t DimBuffer                = 5;
+    constexpr uint32_t DimSubpassData           = 6;
+}
+
+static VkShaderStageFlagBits StageFromExecutionModel(uint32_t model) {
+    switch (model) {
+    case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+    case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+    default: return VK_SHADER_STAGE_ALL;
+    }
+}
+
+namespace {
+
+struct Type {
+    uint32_t                opcode      = 0;
+    std::vector<uint32_t>   operands;   // words after the result id
+};
+
+struct Decorations {
+    uint32_t    set         = 0;
+    uint32_t    binding     = 0;
+    bool        hasBinding  = false;
+    bool        block       = false;
+    bool        bufferBlock = false;
+    uint32_t    arrayStride = 0;
+};
+
+struct MemberDecorations {
+    uint32_t    offset          = 0;
+    uint32_t    matrixStride    = 0;
+};
+
+struct Module {
+    std::unordered_map<uint32_t, Type>                              types;
+    std::unordered_map<uint32_t, uint32_t>                          constants;
+    std::unordered_map<uint32_t, Decorations>                       decorations;
+    std::unordered_map<uint32_t, std::vector<MemberDecorations>>    members;
+
+    MemberDecorations& Member(uint32_t structId, uint32_t member) {
+        std::vector<MemberDecorations>& entries = members[structId];
+        if (entries.size() <= member) {
+            entries.resize(member + 1);
+        }
+        return entries[member];
+    }
+
+    const Type* FindType(uint32_t id) const {
+        auto it = types.find(id);
+        return it != types.end() ? &it->second : nullptr;
+    }
+
+    uint32_t TypeSize(uint32_t typeId, uint32_t matrixStride) const;
+    uint32_t StructSize(uint32_t structId) const;
+};
+
+uint32_t Module::TypeSize(uint32_t typeId, uint32_t matrixStride) const {
+    const Type* type = FindType(typeId);
+    if (!type) {
+        return 0;
+    }
+
+    switch (type->opcode) {
+    case spv::OpTypeBool:
+        return 4;
+    case spv::OpTypeInt:
+    case spv::OpTypeFloat:
+        return type->operands[0] / 8;
+    case spv::OpTypeVector:
+        return TypeSize(type->operands[0], 0) * type->operands[1];
+    case spv::OpTypeMatrix:
+        // Column major, the stride includes the column padding
+        return type->operands[1] * (matrixStride ? matrixStride : TypeSize(type->operands[0], 0));
+    case spv::OpTypeArray: {
+        auto length = constants.find(type->operands[1]);
+        auto deco   = decorations.find(typeId);
+        const uint32_t stride = (deco != decorations.end() && deco->second.arrayStride)
+                              ? deco->second.arrayStride : TypeSize(type->operands[0], matrixStride);
+        return length != constants.end() ? length->second * stride : 0;
+    }
+    case spv::OpTypeStruct:
+        return StructSize(typeId);
+    default:
+        return 0;
+    }
+}
+
+uint32_t Module::StructSize(uint32_t structId) const {
+    const Type* type = FindType(structId);
+    auto memberDecos = members.find(structId);
+
+    uint32_t size = 0;
+    for (uint32_t idx = 0; idx < type->operands.size(); idx++) {
+        MemberDecorations deco = {};
+        if (memberDecos != members.end() && idx < memberDecos->second.size()) {
+            deco = memberDecos->second[idx];
+        }
+
+        size = std::max(size, deco.offset + TypeSize(type->operands[idx], deco.matrixStride));
+    }
+
+    return size;
+}
+
+} // namespace
+
+ShaderReflection ShaderReflection::Create(const uint32_t* code, uint32_t codeSize) {
+    ShaderReflection reflection;
+
+    const uint32_t wordCount = codeSize / sizeof(uint32_t);
+    if (code == nullptr || wordCount < spv::kHeaderWords || code[0] != spv::kMagic) {
+        printf("[ShaderReflection] Not a SPIR-V module\n");
+        return reflection;
+    }
+
+    // 1) Collect the types, constants, decorations and interface variables
+    Module module;
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_ALL;
+
+    struct Variable {
+        uint32_t    id;
+        uint32_t    pointerType;
+        uint32_t    storageClass;
+    };
+    std::vector<Variable> variables;
+
+    for (uint32_t offset = spv::kHeaderWords; offset < wordCount;) {
+        const uint32_t opcode = code[offset] & 0xFFFF;
+        const uint32_t length = code[offset] >> 16;
+
+        if (length == 0 || offset + length > wordCount) {
+            printf("[ShaderReflection] Malformed SPIR-V instruction at word %u\n", offset);
+            return reflection;
+        }
+
+        const uint32_t* words = code + offset;
+
+        switch (opcode) {
+        case spv::OpEntryPoint:
+            // Modules with multiple entry points are reported with the first one's stage
+            if (stage == VK_SHADER_STAGE_ALL) {
+                stage = StageFromExecutionModel(words[1]);
+            }
+            break;
+        case spv::OpTypeBool:
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+        case spv::OpTypeVector:
+        case spv::OpTypeMatrix:
+        case spv::OpTypeImage:
+        case spv::OpTypeSampler:
+        case spv::OpTypeSampledImage:
+        case spv::OpTypeArray:
+        case spv::OpTypeRuntimeArray:
+        case spv::OpTypeStruct:
+        case spv::OpTypePointer:
+            module.types[words[1]] = { opcode, std::vector<uint32_t>(words + 2, words + length) };
+            break;
+        case spv::OpConstant:
+        case spv::OpSpecConstant:
+            // Only 32 bit integer constants are interesting: the array lengths
+            if (length >= 4) {
+                module.constants[words[2]] = words[3];
+            }
+            break;
+        case spv::OpVariable:
+            variables.push_back({ words[2], words[1], words[3] });
+            break;
+        case spv::OpDecorate: {
+            Decorations& deco = module.decorations[words[1]];
+            switch (words[2]) {
+            case spv::DecorationBlock:          deco.block = true; break;
+            case spv::DecorationBufferBlock:    deco.bufferBlock = true; break;
+            case spv::DecorationArrayStride:    deco.arrayStride = words[3]; break;
+            case spv::DecorationDescriptorSet:  deco.set = words[3]; break;
+            case spv::DecorationBinding:        deco.binding = words[3]; deco.hasBinding = true; break;
+            }
+            break;
+        }
+        case spv::OpMemberDecorate:
+            if (words[3] == spv::DecorationOffset) {
+                module.Member(words[1], words[2]).offset = words[4];
+            } else if (words[3] == spv::DecorationMatrixStride) {
+                module.Member(words[1], words[2]).matrixStride = words[4];
+            }
+            break;
+        }
+
+        offset += length;
+    }
+
+    reflection.m_stages = stage;
+
+    // 2) Resolve the variables
+    for (const Variable& variable : variables) {
+        const Type* pointer = module.FindType(variable.pointerType);
+        if (!pointer || pointer->opcode != spv::OpTypePointer) {
+            continue;
+        }
+
+        uint32_t typeId = pointer->operands[1];
+
+        if (variable.storageClass == spv::StoragePushConstant) {
+            if (module.FindType(typeId) && module.FindType(typeId)->opcode == spv::OpTypeStruct) {
+                // Only the members with a declared offset count, the block always starts at its first member
+                uint32_t begin = UINT32_MAX;
+                auto memberDecos = module.members.find(typeId);
+                if (memberDecos != module.members.end()) {
+                    for (const MemberDecorations& member : memberDecos->second) {
+                        begin = std::min(begin, member.offset);
+                    }
+                }
+
+                reflection.AddPushRange({ stage, begin == UINT32_MAX ? 0 : begin, module.StructSize(typeId) });
+            }
+            continue;
+        }
+
+        if (variable.storageClass != spv::StorageUniformConstant && variable.storageClass != spv::StorageUniform
+            && variable.storageClass != spv::StorageStorageBuffer) {
+            continue;
+        }
+
+        auto deco = module.decorations.find(variable.id);
+        if (deco == module.decorations.end() || !deco->second.hasBinding) {
+            continue;
+        }
+
+        // Unwrap the arrays
+        uint32_t count = 1;
+        const Type* type = module.FindType(typeId);
+        while (type && (type->opcode == spv::OpTypeArray || type->opcode == spv::OpTypeRuntimeArray)) {
+            if (type->opcode == spv::OpTypeRuntimeArray) {
+                count = 0;
+            } else {
+                auto length = module.constants.find(type->operands[1]);
+                count *= length != module.constants.end() ? length->second : 1;
+            }
+
+            typeId = type->operands[0];
+            type = module.FindType(typeId);
+        }
+
+        if (!type) {
+            continue;
+        }
+
+        VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        switch (type->opcode) {
+        case spv::OpTypeSampledImage:
+            descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            break;
+        case spv::OpTypeSampler:
+            descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+            break;
+        case spv::OpTypeImage: {
+            // operands: sampled type, dim, depth, arrayed, ms, sampled, format
+            const uint32_t dim     = type->operands[1];
+            const uint32_t sampled = type->operands[5];
+
+            if (dim == spv::DimSubpassData) {
+                descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            } else if (dim == spv::DimBuffer) {
+                descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                              : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            } else {
+                descriptorType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            }
+            break;
+        }
+        case spv::OpTypeStruct: {
+            auto typeDeco = module.decorations.find(typeId);
+            const bool bufferBlock = typeDeco != module.decorations.end() && typeDeco->second.bufferBlock;
+
+            if (variable.storageClass == spv::StorageStorageBuffer || bufferBlock) {
+                descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            } else {
+                descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            }
+            break;
+        }
+        }
+
+        if (descriptorType == VK_DESCRIPTOR_TYPE_MAX_ENUM) {
+            printf("[ShaderReflection] Unsupported resource at set %u binding %u\n",
+                   deco->second.set, deco->second.binding);
+            continue;
+        }
+
+        reflection.m_bindings.push_back({ deco->second.set, deco->second.binding, descriptorType, count, (VkShaderStageFlags)stage });
+    }
+
+    std::sort(reflection.m_bindings.begin(), reflection.m_bindings.end(),
+              [](const ReflectedBinding& a, const ReflectedBinding& b) {
+                  return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+              });
+
+    reflection.m_valid = true;
+    return reflection;
+}
+
+void ShaderReflection::AddPushRange(const StageRange& range) {
+    for (StageRange& existing : m_pushRanges) {
+        if (existing.stage == range.stage) {
+            existing.begin = std::min(existing.begin, range.begin);
+            existing.end   = std::max(existing.end, range.end);
+            return;
+        }
+    }
+
+    m_pushRanges.push_back(range);
+}
+
+bool ShaderReflection::Merge(const ShaderReflection& other) {
+    bool compatible = true;
+
+    m_valid  = m_valid && other.m_valid;
+    m_stages |= other.m_stages;
+
+    for (const ReflectedBinding& binding : other.m_bindings) {
+        auto it = std::find_if(m_bindings.begin(), m_bindings.end(), [&binding](const ReflectedBinding& existing) {
+            return existing.set == binding.set && existing.binding == binding.binding;
+        });
+
+        if (it == m_bindings.end()) {
+            m_bindings.push_back(binding);
+            continue;
+        }
+
+        if (it->type != binding.type) {
+            printf("[ShaderReflection] Set %u binding %u is declared with different types\n", binding.set, binding.binding);
+            compatible = false;
+            continue;
+        }
+
+        it->stages |= binding.stages;
+        // Runtime sized arrays stay runtime sized
+        it->count = (it->count == 0 || binding.count == 0) ? 0 : std::max(it->count, binding.count);
+    }
+
+    std::sort(m_bindings.begin(), m_bindings.end(), [](const ReflectedBinding& a, const ReflectedBinding& b) {
+        return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+    });
+
+    for (const StageRange& range : other.m_pushRanges) {
+        AddPushRange(range);
+    }
+
+    return compatible;
+}
+
+const ReflectedBinding* ShaderReflection::Find(uint32_t set, uint32_t binding) const {
+    for (const ReflectedBinding& entry : m_bindings) {
+        if (entry.set == set && entry.binding == binding) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+std::vector<VkPushConstantRange> ShaderReflection::PushConstantRanges() const {
+    std::vector<VkPushConstantRange> ranges;
+
+    for (const StageRange& stageRange : m_pushRanges) {
+        // Offsets and sizes must be multiples of 4
+        const uint32_t begin = stageRange.begin & ~3u;
+        const uint32_t end   = (stageRange.end + 3) & ~3u;
+
+        auto it = std::find_if(ranges.begin(), ranges.end(), [begin, end](const VkPushConstantRange& range) {
+            return range.offset == begin && range.size == end - begin;
+        });
+
+        if (it != ranges.end()) {
+            it->stageFlags |= stageRange.stage;
+        } else {
+            ranges.push_back({ (VkShaderStageFlags)stageRange.stage, begin, end - begin });
+        }
+    }
+
+    return ranges;
+}
+
+VkShaderStageFlags ShaderReflection::PushConstantStages(uint32_t offset, uint32_t size) const {
+    VkShaderStageFlags stages = 0;
+
+    for (const VkPushConstantRange& range : PushConstantRanges()) {
+        if (offset < range.offset + range.size && range.offset < offset + size) {
+            stages |= range.stageFlags;
+        }
+    }
+
+    return stages;
+}
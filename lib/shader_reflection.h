@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+struct ReflectedBinding {
+    uint32_t            set;
+    uint32_t            binding;
+    VkDescriptorType    type;
+    uint32_t            count;      // 0 for runtime sized arrays
+    VkShaderStageFlags  stages;
+};
+
+// Descriptor and push constant interface of SPIR-V modules.
+// One module is reflected by "Create", the modules of a pipeline (or of every pipeline sharing
+// a layout) are combined by "Merge" which ORs the stage flags of the common bindings.
+// Arrays sized by a specialization constant report the constant's default value.
+// Buffer descriptors are always reported as the non dynamic type.
+class ShaderReflection {
+public:
+    // "codeSize" is in bytes, same as the SPIR-V arrays generated by the build.
+    static ShaderReflection Create(const uint32_t* code, uint32_t codeSize);
+
+    bool IsValid() const { return m_valid; }
+
+    // Returns false if a binding is declared with a different type, the first declaration is kept.
+    bool Merge(const ShaderReflection& other);
+
+    VkShaderStageFlags Stages() const { return m_stages; }
+
+    // Sorted by set then binding
+    const std::vector<ReflectedBinding>& Bindings() const { return m_bindings; }
+    const ReflectedBinding* Find(uint32_t set, uint32_t binding) const;
+
+    // Each stage covers only the bytes its push constant block declares, stages with the same
+    // range share one VkPushConstantRange.
+    std::vector<VkPushConstantRange> PushConstantRanges() const;
+    // Stage flags to use for a vkCmdPushConstants call updating [offset, offset + size).
+    VkShaderStageFlags PushConstantStages(uint32_t offset, uint32_t size) const;
+
+private:
+    struct StageRange {
+        VkShaderStageFlagBits   stage;
+        uint32_t                begin;
+        uint32_t                end;
+    };
+
+    void AddPushRange(const StageRange& range);
+
+    bool                            m_valid     = false;
+    VkShaderStageFlags              m_stages    = 0;
+    std::vector<ReflectedBinding>   m_bindings;
+    std::vector<StageRange>         m_pushRanges;   // one per stage
+};
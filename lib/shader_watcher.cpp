@@ -0,0 +1,197 @@
+#include "shader_watcher.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#if SHADER_HOT_RELOAD
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <glslang/SPIRV/GlslangToSpv.h>
+#endif
+
+bool ShaderWatcher::IsSupported() {
+#if SHADER_HOT_RELOAD
+    return true;
+#else
+    return false;
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    Stop();
+}
+
+void ShaderWatcher::Watch(const std::string& path) {
+    std::error_code error;
+    const std::filesystem::file_time_type lastWrite = std::filesystem::last_write_time(path, error);
+    if (error) {
+        printf("[ShaderWatcher] Can't watch '%s': %s\n", path.c_str(), error.message().c_str());
+        return;
+    }
+
+    m_files.push_back({ path, lastWrite });
+}
+
+bool ShaderWatcher::Start(std::chrono::milliseconds pollInterval) {
+    if (!IsSupported()) {
+        printf("[ShaderWatcher] Hot reload is not available, configure with SHADER_HOT_RELOAD=ON\n");
+        return false;
+    }
+
+    if (m_thread.joinable() || m_files.empty()) {
+        return false;
+    }
+
+    m_stopping = false;
+    m_thread = std::thread(&ShaderWatcher::WatchLoop, this, pollInterval);
+
+    return true;
+}
+
+void ShaderWatcher::Stop() {
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_stopCondition.notify_all();
+
+    m_thread.join();
+}
+
+std::vector<ShaderWatcher::CompiledShader> ShaderWatcher::TakeCompiled() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<CompiledShader> compiled;
+    compiled.swap(m_compiled);
+
+    return compiled;
+}
+
+void ShaderWatcher::WatchLoop(std::chrono::milliseconds pollInterval) {
+#if SHADER_HOT_RELOAD
+    glslang::InitializeProcess();
+#endif
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stopCondition.wait_for(lock, pollInterval, [this]() { return m_stopping; })) {
+                break;
+            }
+        }
+
+        for (WatchedFile& file : m_files) {
+            std::error_code error;
+            const std::filesystem::file_time_type lastWrite = std::filesystem::last_write_time(file.path, error);
+
+            // Editors may replace the file, it can be missing for a moment
+            if (error || lastWrite == file.lastWrite) {
+                continue;
+            }
+            file.lastWrite = lastWrite;
+
+            std::vector<uint32_t> spirv;
+            if (!Compile(file.path, &spirv)) {
+                m_failedCount++;
+                continue;
+            }
+
+            printf("[ShaderWatcher] Recompiled '%s'\n", file.path.c_str());
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // Only the latest version of a file is interesting
+            bool replaced = false;
+            for (CompiledShader& compiled : m_compiled) {
+                if (compiled.path == file.path) {
+                    compiled.spirv.swap(spirv);
+                    replaced = true;
+                }
+            }
+
+            if (!replaced) {
+                m_compiled.push_back({ file.path, std::move(spirv) });
+            }
+        }
+    }
+
+#if SHADER_HOT_RELOAD
+    glslang::FinalizeProcess();
+#endif
+}
+
+#if SHADER_HOT_RELOAD
+
+static bool StageFromPath(const std::string& path, EShLanguage* outStage) {
+    const std::string extension = std::filesystem::path(path).extension().string();
+
+    if (extension == ".vert")       { *outStage = EShLangVertex; }
+    else if (extension == ".frag")  { *outStage = EShLangFragment; }
+    else if (extension == ".comp")  { *outStage = EShLangCompute; }
+    else if (extension == ".geom")  { *outStage = EShLangGeometry; }
+    else if (extension == ".tesc")  { *outStage = EShLangTessControl; }
+    else if (extension == ".tese")  { *outStage = EShLangTessEvaluation; }
+    else { return false; }
+
+    return true;
+}
+
+bool ShaderWatcher::Compile(const std::string& path, std::vector<uint32_t>* outSpirv) {
+    EShLanguage stage;
+    if (!StageFromPath(path, &stage)) {
+        printf("[ShaderWatcher] Unknown shader stage: %s\n", path.c_str());
+        return false;
+    }
+
+    std::ifstream input(path);
+    if (!input) {
+        printf("[ShaderWatcher] Failed to read: %s\n", path.c_str());
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    const std::string source = buffer.str();
+    const char* sourcePtr = source.c_str();
+    const char* namePtr   = path.c_str();
+
+    // Same targets as the build time "glslangValidator -V" compilation
+    glslang::TShader shader(stage);
+    shader.setStringsWithLengthsAndNames(&sourcePtr, nullptr, &namePtr, 1);
+    shader.setEnvInput(glslang::EShSourceGlsl, stage, glslang::EShClientVulkan, 100);
+    shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
+    shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+
+    const EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+
+    if (!shader.parse(GetDefaultResources(), 100, false, messages)) {
+        printf("[ShaderWatcher] Compile error in '%s':\n%s\n", path.c_str(), shader.getInfoLog());
+        return false;
+    }
+
+    glslang::TProgram program;
+    program.addShader(&shader);
+
+    if (!program.link(messages)) {
+        printf("[ShaderWatcher] Link error in '%s':\n%s\n", path.c_str(), program.getInfoLog());
+        return false;
+    }
+
+    outSpirv->clear();
+    glslang::GlslangToSpv(*program.getIntermediate(stage), *outSpirv);
+
+    return !outSpirv->empty();
+}
+
+#else
+
+bool ShaderWatcher::Compile(const std::string& /*path*/, std::vector<uint32_t>* /*outSpirv*/) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches GLSL sources and recompiles the changed ones to SPIR-V on a background thread (hot reload).
+// The stage is taken from the file extension (.vert, .frag, .comp, ...).
+// Compiling needs the glslang library: configure with SHADER_HOT_RELOAD=ON, otherwise
+// "IsSupported" returns false and "Start" does nothing.
+class ShaderWatcher {
+public:
+    struct CompiledShader {
+        std::string             path;
+        std::vector<uint32_t>   spirv;
+    };
+
+    static bool IsSupported();
+
+    ShaderWatcher() = default;
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    // Must be called before "Start".
+    void Watch(const std::string& path);
+
+    bool Start(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(250));
+    void Stop();
+
+    // Shaders recompiled since the last call, for the main thread (ex.: at a frame boundary).
+    std::vector<CompiledShader> TakeCompiled();
+
+    uint32_t FailedCount() const { return m_failedCount; }
+
+private:
+    struct WatchedFile {
+        std::string                     path;
+        std::filesystem::file_time_type lastWrite;
+    };
+
+    void WatchLoop(std::chrono::milliseconds pollInterval);
+    static bool Compile(const std::string& path, std::vector<uint32_t>* outSpirv);
+
+    std::vector<WatchedFile>        m_files;    // only touched by the watcher thread after Start
+    std::thread                     m_thread;
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_stopCondition;
+    bool                            m_stopping      = false;
+    std::vector<CompiledShader>     m_compiled;
+    std::atomic<uint32_t>           m_failedCount   = 0;
+};
@@ -0,0 +1,224 @@
+#include "staging_uploader.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "queue_timeline.h"
+#include "texture.h"
+
+// Keeps every copy source aligned for both buffer and (up to 16 byte texel) image copies.
+static constexpr VkDeviceSize kStagingAlignment = 16;
+
+StagingUploader StagingUploader::Create(
+    const VkPhysicalDevice  phyDevice,
+    const VkDevice          device,
+    const VkQueue           queue,
+    const VkCommandPool     cmdPool) {
+
+    StagingUploader uploader;
+    uploader.m_phyDevice = phyDevice;
+    uploader.m_device    = device;
+    uploader.m_timeline  = &QueueTimeline::Get(device, queue);
+    uploader.m_cmdPool   = cmdPool;
+
+    return uploader;
+}
+
+BufferInfo StagingUploader::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFlags, const void* data) {
+    BufferInfo result = BufferInfo::Create(m_phyDevice, m_device, size, usageFlags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    if (data != nullptr) {
+        Upload(result, data, size);
+    }
+
+    return result;
+}
+
+VkDeviceSize StagingUploader::Stage(const void* data, VkDeviceSize size) {
+    const VkDeviceSize srcOffset = (m_stagingData.size() + kStagingAlignment - 1) / kStagingAlignment * kStagingAlignment;
+
+    m_stagingData.resize(srcOffset + size);
+    memcpy(m_stagingData.data() + srcOffset, data, size);
+
+    return srcOffset;
+}
+
+void StagingUploader::Upload(const BufferInfo& target, const void* data, VkDeviceSize size, VkDeviceSize targetOffset) {
+    const VkDeviceSize srcOffset = Stage(data, size);
+
+    m_copies.push_back({ target.buffer, srcOffset, targetOffset, size });
+}
+
+void StagingUploader::UploadImage(const Texture& target, const void* data, VkDeviceSize size) {
+    const VkDeviceSize srcOffset = Stage(data, size);
+
+    m_imageCopies.push_back({ &target, srcOffset });
+}
+
+uint64_t StagingUploader::Submit() {
+    if (!HasPending()) {
+        return 0;
+    }
+
+    // 1) One staging buffer for every pending upload
+    BufferInfo staging = BufferInfo::Create(m_phyDevice, m_device, m_stagingData.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    staging.Update(m_device, m_stagingData.data(), m_stagingData.size());
+
+    // 2) Record all copies
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = m_cmdPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1u,
+    };
+
+    VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+    VkResult result = vkAllocateCommandBuffers(m_device, &allocInfo, &cmdBuffer);
+    if (result != VK_SUCCESS) {
+        printf("[StagingUploader] Command buffer allocation failed (error code: %d)\n", result);
+        staging.Destroy(m_device);
+        return 0;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext              = nullptr,
+        .flags              = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo   = nullptr,
+    };
+
+    vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+
+    for (const PendingCopy& copy : m_copies) {
+        VkBufferCopy region = {
+            .srcOffset  = copy.srcOffset,
+            .dstOffset  = copy.dstOffset,
+            .size       = copy.size,
+        };
+
+        vkCmdCopyBuffer(cmdBuffer, staging.buffer, copy.target, 1, &region);
+    }
+
+    for (const PendingImageCopy& copy : m_imageCopies) {
+        copy.target->RecordUpload(cmdBuffer, staging.buffer, copy.srcOffset);
+    }
+
+    // Make the copied buffer data visible for every kind of later read.
+    VkMemoryBarrier barrier = {
+        .sType          = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext          = nullptr,
+        .srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask  = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT
+                        | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+                            | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    // 3) Submit once through the timeline, completion is checked in Poll/Wait
+    VkSubmitInfo submitInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                  = nullptr,
+        .waitSemaphoreCount     = 0,
+        .pWaitSemaphores        = nullptr,
+        .pWaitDstStageMask      = nullptr,
+        .commandBufferCount     = 1,
+        .pCommandBuffers        = &cmdBuffer,
+        .signalSemaphoreCount   = 0,
+        .pSignalSemaphores      = nullptr,
+    };
+
+    m_stagingData.clear();
+    m_copies.clear();
+    m_imageCopies.clear();
+
+    Batch batch = { m_timeline->Submit(submitInfo), cmdBuffer, staging };
+    if (batch.id == 0) {
+        Release(batch);
+        return 0;
+    }
+
+    m_inFlight.push_back(batch);
+
+    return batch.id;
+}
+
+void StagingUploader::Release(Batch& batch) {
+    vkFreeCommandBuffers(m_device, m_cmdPool, 1, &batch.cmdBuffer);
+    batch.staging.Destroy(m_device);
+}
+
+void StagingUploader::Poll() {
+    size_t finished = 0;
+
+    for (; finished < m_inFlight.size(); finished++) {
+        Batch& batch = m_inFlight[finished];
+
+        if (!m_timeline->IsComplete(batch.id)) {
+            break;
+        }
+
+        Release(batch);
+    }
+
+    m_inFlight.erase(m_inFlight.begin(), m_inFlight.begin() + finished);
+}
+
+bool StagingUploader::IsComplete(uint64_t batchId) {
+    if (!m_timeline->IsComplete(batchId)) {
+        return false;
+    }
+
+    Poll();
+
+    return true;
+}
+
+VkResult StagingUploader::Wait(uint64_t batchId) {
+    VkResult result = m_timeline->Wait(batchId);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    Poll();
+
+    return VK_SUCCESS;
+}
+
+VkResult StagingUploader::Flush() {
+    if (!HasPending()) {
+        return VK_SUCCESS;
+    }
+
+    const uint64_t batchId = Submit();
+    if (batchId == 0) {
+        return VK_ERROR_UNKNOWN;
+    }
+
+    return Wait(batchId);
+}
+
+void StagingUploader::Destroy() {
+    if (HasPending()) {
+        printf("[StagingUploader] Destroyed with %zu pending upload(s)\n", m_copies.size() + m_imageCopies.size());
+    }
+
+    if (!m_inFlight.empty()) {
+        m_timeline->Wait(m_inFlight.back().id);
+    }
+
+    for (Batch& batch : m_inFlight) {
+        Release(batch);
+    }
+    m_inFlight.clear();
+
+    m_stagingData.clear();
+    m_copies.clear();
+    m_imageCopies.clear();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "buffer.h"
+
+class QueueTimeline;
+class Texture;
+
+// Collects uploads into device local resources and executes all pending ones with a
+// single command buffer per batch. A batch is identified by its value on the queue's QueueTimeline.
+// Must only be used from one thread (the command pool is not synchronized).
+class StagingUploader {
+public:
+    static StagingUploader Create(
+        const VkPhysicalDevice  phyDevice,
+        const VkDevice          device,
+        const VkQueue           queue,
+        const VkCommandPool     cmdPool);
+
+    // Creates a DEVICE_LOCAL buffer and queues the upload of "data" into it.
+    // The buffer contents are only valid after the batch containing it completed.
+    BufferInfo CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usageFlags, const void* data);
+
+    // "data" is copied into the uploader's own storage, it can be released after the call.
+    void Upload(const BufferInfo& target, const void* data, VkDeviceSize size, VkDeviceSize targetOffset = 0);
+    // Tightly packed texel data for the whole image, the texture must outlive the batch.
+    void UploadImage(const Texture& target, const void* data, VkDeviceSize size);
+
+    // Submits every pending upload as one batch without waiting for it.
+    // Returns the batch id, the QueueTimeline value of its submit (0 if there was nothing to submit).
+    uint64_t Submit();
+
+    // Reclaims the command buffers and staging memory of finished batches.
+    void Poll();
+    bool IsComplete(uint64_t batchId);
+    VkResult Wait(uint64_t batchId);
+
+    // Submit + Wait
+    VkResult Flush();
+
+    bool HasPending() const { return !m_copies.empty() || !m_imageCopies.empty(); }
+
+    void Destroy();
+
+private:
+    struct PendingCopy {
+        VkBuffer        target;
+        VkDeviceSize    srcOffset;
+        VkDeviceSize    dstOffset;
+        VkDeviceSize    size;
+    };
+
+    struct PendingImageCopy {
+        const Texture*  target;
+        VkDeviceSize    srcOffset;
+    };
+
+    struct Batch {
+        uint64_t        id;
+        VkCommandBuffer cmdBuffer;
+        BufferInfo      staging;
+    };
+
+    VkDeviceSize Stage(const void* data, VkDeviceSize size);
+    void Release(Batch& batch);
+
+    VkPhysicalDevice                m_phyDevice = VK_NULL_HANDLE;
+    VkDevice                        m_device    = VK_NULL_HANDLE;
+    VkCommandPool                   m_cmdPool   = VK_NULL_HANDLE;
+    QueueTimeline*                  m_timeline  = nullptr;
+
+    std::vector<uint8_t>            m_stagingData;
+    std::vector<PendingCopy>        m_copies;
+    std::vector<PendingImageCopy>   m_imageCopies;
+
+    // Batches finish in submission order (single queue), so only the oldest has to be checked.
+    std::vector<Batch>              m_inFlight;
+};
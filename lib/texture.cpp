@@ -1,14 +1,21 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <cstdio>
+
 #include <vulkan/vulkan_core.h>
 
 #include "buffer.h"
+#include "queue_timeline.h"
+#include "sampler_cache.h"
+#include "staging_uploader.h"
 #include "stb_image.h"
 
 VkImageView Create2DImageView(
     const VkDevice  device,
     const VkFormat  format,
-    const VkImage   image) {
+    const VkImage   image,
+    uint32_t        mipLevels) {
 
     VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     if (format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D32_SFLOAT_S8_UINT) {
@@ -30,7 +37,7 @@ VkImageView Create2DImageView(
         .subresourceRange = {
             .aspectMask     = aspectMask,
             .baseMipLevel   = 0,
-            .levelCount     = 1,
+            .levelCount     = mipLevels,
             .baseArrayLayer = 0,
             .layerCount     = 1,
         }
@@ -101,24 +108,6 @@ ImageInfo Texture::Create2DImage(
 
 */
 
-static uint32_t FindMemoryTypeIndex(const VkPhysicalDevice phyDevice, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags flags) {
-    VkPhysicalDeviceMemoryProperties memoryProperties = {};
-    vkGetPhysicalDeviceMemoryProperties(phyDevice, &memoryProperties);
-
-    for (uint32_t idx = 0; idx < memoryProperties.memoryTypeCount; idx++) {
-        if (requirements.memoryTypeBits & (1 << idx)) {
-            const VkMemoryType& memoryType = memoryProperties.memoryTypes[idx];
-            // TODO: add size check?
-
-            if (memoryType.propertyFlags & flags) {
-                return idx;
-            }
-        }
-    }
-
-    return (uint32_t)-1;
-}
-
 bool Texture::InitFromBuffer(
     const VkPhysicalDevice  phyDevice,
     const VkDevice          device,
@@ -131,8 +120,8 @@ bool Texture::InitFromBuffer(
 
     UploadFromBuffer(device, queue, cmdPool, buffer);
 
-    m_view = Create2DImageView(device, m_format, m_image);
-    Create2DSampler(device);
+    m_view = Create2DImageView(device, m_format, m_image, m_mipLevels);
+    Create2DSampler(phyDevice, device);
 
     return true;
 }
@@ -217,15 +206,66 @@ Texture *Texture::LoadFromFile(
     return texture;
 }
 
+std::vector<Texture*> Texture::LoadFromFiles(
+    const VkPhysicalDevice          phyDevice,
+    const VkDevice                  device,
+    const VkQueue                   queue,
+    const VkCommandPool             cmdPool,
+    const std::vector<std::string>& paths,
+    const VkFormat                  format,
+    VkImageUsageFlags               usage) {
+
+    StagingUploader uploader = StagingUploader::Create(phyDevice, device, queue, cmdPool);
+
+    std::vector<Texture*> textures(paths.size(), nullptr);
+
+    // 1) Decode and queue the copies, the texel data is kept by the uploader
+    for (size_t idx = 0; idx < paths.size(); idx++) {
+        int32_t width = 0;
+        int32_t height = 0;
+        int32_t channels = 0;
+
+        uint8_t *data = stbi_load(paths[idx].c_str(), &width, &height, &channels, 4);
+        if (!data) {
+            printf("[Texture] Failed to load image: %s\n", paths[idx].c_str());
+            continue;
+        }
+
+        printf("Loaded image: %s (%dx%d)\n", paths[idx].c_str(), width, height);
+
+        const VkExtent2D extent = { (uint32_t)width, (uint32_t)height };
+        Texture texture = Create2D(phyDevice, device, format, extent, usage, VK_SAMPLE_COUNT_1_BIT, FullMipCount(extent));
+
+        if (texture.IsValid()) {
+            textures[idx] = new Texture(texture);
+            uploader.UploadImage(*textures[idx], data, (VkDeviceSize)width * height * 4);
+        }
+
+        stbi_image_free(data);
+    }
+
+    // 2) One submit and one fence for the whole set
+    VkResult result = uploader.Flush();
+    if (result != VK_SUCCESS) {
+        printf("[Texture] Texture set upload failed (error code: %d)\n", result);
+    }
+
+    uploader.Destroy();
+
+    return textures;
+}
+
 Texture Texture::Create2D(
     const VkPhysicalDevice  phyDevice,
     const VkDevice          device,
     const VkFormat          format,
     VkExtent2D              extent,
     VkImageUsageFlags       usage,
-    VkSampleCountFlagBits   msaaSamples) {
+    VkSampleCountFlagBits   msaaSamples,
+    uint32_t                mipLevels) {
 
     Texture texture(format, extent.width, extent.height);
+    texture.m_mipLevels = mipLevels;
 
     if (texture.CreateImage(phyDevice, device, usage, msaaSamples) != VK_SUCCESS) {
         return {VK_FORMAT_UNDEFINED, 0, 0};
@@ -241,8 +281,8 @@ Texture Texture::Create2D(
     ;
 
     if ((usage & requiresView) != 0) {
-        texture.m_view = Create2DImageView(device, texture.m_format, texture.m_image);
-        texture.Create2DSampler(device);
+        texture.m_view = Create2DImageView(device, texture.m_format, texture.m_image, texture.m_mipLevels);
+        texture.Create2DSampler(phyDevice, device);
     }
 
     return texture;
@@ -255,6 +295,24 @@ VkResult Texture::CreateImage(
     VkImageUsageFlags       usage,
     VkSampleCountFlagBits   msaaSamples) {
 
+    VkImageUsageFlags mipUsage = 0;
+    if (m_mipLevels > 1) {
+        // The mip chain is generated with linear filtered blits.
+        VkFormatProperties formatProperties = {};
+        vkGetPhysicalDeviceFormatProperties(phyDevice, m_format, &formatProperties);
+
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT
+                                            | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                                            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+        if ((formatProperties.optimalTilingFeatures & required) != required) {
+            printf("[Texture] Format %d does not support linear blits, mipmaps are disabled\n", m_format);
+            m_mipLevels = 1;
+        } else {
+            mipUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+    }
+
     VkImageCreateInfo createInfo = {
         .sType                  = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext                  = nullptr,
@@ -262,11 +320,11 @@ VkResult Texture::CreateImage(
         .imageType              = VK_IMAGE_TYPE_2D,
         .format                 = m_format,
         .extent                 = { (uint32_t)m_width, (uint32_t)m_height, 1 },
-        .mipLevels              = 1,
+        .mipLevels              = m_mipLevels,
         .arrayLayers            = 1,
         .samples                = msaaSamples,
         .tiling                 = VK_IMAGE_TILING_OPTIMAL,
-        .usage                  = VK_IMAGE_USAGE_TRANSFER_DST_BIT | usage,
+        .usage                  = VK_IMAGE_USAGE_TRANSFER_DST_BIT | mipUsage | usage,
         .sharingMode            = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount  = 0,
         .pQueueFamilyIndices    = nullptr,
@@ -274,35 +332,39 @@ VkResult Texture::CreateImage(
     };
 
     VkResult createResult = vkCreateImage(device, &createInfo, nullptr, &m_image);
-    (void)createResult;
 
-    VkMemoryRequirements requirements = {};
-    vkGetImageMemoryRequirements(device, m_image, &requirements);
+    if (createResult != VK_SUCCESS) {
+        return createResult;
+    }
 
-    const uint32_t memoryTypeIdx = FindMemoryTypeIndex(phyDevice, requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    // TODO: check for error
+    // Render targets are big and live as long as the swapchain, give them their own allocation.
+    const bool isRenderTarget = usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
 
-    VkMemoryAllocateInfo allocInfo = {
-        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .pNext           = 0,
-        .allocationSize  = requirements.size,
-        .memoryTypeIndex = memoryTypeIdx,
-    };
-
-    vkAllocateMemory(device, &allocInfo, nullptr, &m_memory);
-    vkBindImageMemory(device, m_image, m_memory, 0);
+    MemoryArena& arena = MemoryArena::Get(phyDevice, device);
+    VkResult allocResult = arena.AllocateForImage(m_image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, isRenderTarget, &m_memory);
+    if (allocResult != VK_SUCCESS) {
+        vkDestroyImage(device, m_image, nullptr);
+        m_image = VK_NULL_HANDLE;
+        return allocResult;
+    }
 
     return VK_SUCCESS;
 }
 
 void Texture::Destroy(const VkDevice device) {
-    vkDestroySampler(device, m_sampler, nullptr);
+    if (m_samplerCache) {
+        m_samplerCache->Release(m_sampler);
+        m_samplerCache = nullptr;
+    }
     vkDestroyImageView(device, m_view, nullptr);
     vkDestroyImage(device, m_image, nullptr);
-    vkFreeMemory(device, m_memory, nullptr);
+
+    if (m_memory.arena) {
+        m_memory.arena->Free(m_memory);
+    }
 }
 
-bool Texture::Create2DSampler(const VkDevice device) {
+bool Texture::Create2DSampler(const VkPhysicalDevice phyDevice, const VkDevice device) {
     VkSamplerCreateInfo createInfo = {
         .sType              = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
         .pNext              = nullptr,
@@ -319,11 +381,17 @@ bool Texture::Create2DSampler(const VkDevice device) {
         .compareEnable      = VK_FALSE,
         .compareOp          = VK_COMPARE_OP_NEVER,
         .minLod             = 0.0f,
-        .maxLod             = 0.0f,
+        .maxLod             = VK_LOD_CLAMP_NONE,    // the view limits the mip range, keeps the sampler shareable
         .borderColor        = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
         .unnormalizedCoordinates = VK_FALSE,
     };
-    VkResult result = vkCreateSampler(device, &createInfo, nullptr, &m_sampler);
+
+    SamplerCache& samplerCache = SamplerCache::Get(phyDevice, device);
+
+    VkResult result = samplerCache.Acquire(createInfo, &m_sampler);
+    if (result == VK_SUCCESS) {
+        m_samplerCache = &samplerCache;
+    }
 
     return result == VK_SUCCESS;
 }
@@ -344,18 +412,71 @@ bool Texture::UploadFromBuffer(
         .commandBufferCount = 1u,
     };
 
-    // TODO: check result
-    vkAllocateCommandBuffers(device, &allocInfo, &cmdBuffer);
+    VkResult result = vkAllocateCommandBuffers(device, &allocInfo, &cmdBuffer);
+    if (result != VK_SUCCESS) {
+        printf("[Texture] Command buffer allocation failed (error code: %d)\n", result);
+        return false;
+    }
 
     VkCommandBufferBeginInfo beginInfo = {
         .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext              = nullptr,
-        .flags              = 0,
+        .flags              = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
         .pInheritanceInfo   = nullptr,
     };
 
     vkBeginCommandBuffer(cmdBuffer, &beginInfo);
 
+    RecordUpload(cmdBuffer, rawBuffer);
+
+    vkEndCommandBuffer(cmdBuffer);
+
+    // Submit
+    VkSubmitInfo submitInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext                  = nullptr,
+        .waitSemaphoreCount     = 0,
+        .pWaitSemaphores        = nullptr,
+        .pWaitDstStageMask      = nullptr,
+        .commandBufferCount     = 1,
+        .pCommandBuffers        = &cmdBuffer,
+        .signalSemaphoreCount   = 0,
+        .pSignalSemaphores      = nullptr,
+    };
+
+    // Only wait for this upload's value on the queue's timeline instead of draining the whole device
+    QueueTimeline& timeline = QueueTimeline::Get(device, queue);
+
+    const uint64_t value = timeline.Submit(submitInfo);
+    result = (value != 0) ? timeline.Wait(value) : VK_ERROR_UNKNOWN;
+
+    if (result != VK_SUCCESS) {
+        printf("[Texture] Upload failed (error code: %d)\n", result);
+    }
+
+    vkFreeCommandBuffers(device, cmdPool, 1, &cmdBuffer);
+
+    return result == VK_SUCCESS;
+}
+
+
+uint32_t Texture::FullMipCount(VkExtent2D extent) {
+    uint32_t size = std::max(extent.width, extent.height);
+
+    uint32_t levels = 1;
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+
+    return levels;
+}
+
+void Texture::RecordUpload(
+    const VkCommandBuffer   cmdBuffer,
+    const VkBuffer          buffer,
+    VkDeviceSize            bufferOffset) const {
+
     VkImageMemoryBarrier startBarrier = {
         .sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .pNext                  = nullptr,
@@ -366,47 +487,67 @@ bool Texture::UploadFromBuffer(
         .srcQueueFamilyIndex    = 0,
         .dstQueueFamilyIndex    = 0,
         .image                  = m_image,
-        .subresourceRange       = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+        .subresourceRange       = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_mipLevels, 0, 1 },
     };
 
     vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &startBarrier);
 
     VkBufferImageCopy range = {
-        .bufferOffset       = 0,
+        .bufferOffset       = bufferOffset,
         .bufferRowLength    = 0,
         .bufferImageHeight  = 0,
         .imageSubresource   = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
         .imageOffset        = { 0, 0, 0 },
         .imageExtent        = { m_width, m_height, 1 },
     };
-    vkCmdCopyBufferToImage(cmdBuffer, rawBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &range);
+    vkCmdCopyBufferToImage(cmdBuffer, buffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &range);
 
-    VkImageMemoryBarrier endBarrier = startBarrier;
-    endBarrier.srcAccessMask    = startBarrier.dstAccessMask;
-    endBarrier.oldLayout        = startBarrier.newLayout;
-    endBarrier.newLayout        = VK_IMAGE_LAYOUT_GENERAL;
+    // Level "idx - 1" is the source of level "idx", after the blit it is not touched anymore.
+    VkImageMemoryBarrier levelBarrier = startBarrier;
+    levelBarrier.subresourceRange.levelCount = 1;
 
-    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &endBarrier);
+    int32_t mipWidth  = (int32_t)m_width;
+    int32_t mipHeight = (int32_t)m_height;
 
-    vkEndCommandBuffer(cmdBuffer);
+    for (uint32_t idx = 1; idx < m_mipLevels; idx++) {
+        levelBarrier.subresourceRange.baseMipLevel = idx - 1;
+        levelBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT;
+        levelBarrier.dstAccessMask  = VK_ACCESS_TRANSFER_READ_BIT;
+        levelBarrier.oldLayout      = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        levelBarrier.newLayout      = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
 
-    // Submit
-    VkSubmitInfo submitInfo = {
-        .sType                  = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext                  = nullptr,
-        .waitSemaphoreCount     = 0,
-        .pWaitSemaphores        = nullptr,
-        .pWaitDstStageMask      = nullptr,
-        .commandBufferCount     = 1,
-        .pCommandBuffers        = &cmdBuffer,
-        .signalSemaphoreCount   = 0,
-        .pSignalSemaphores      = nullptr,
-    };
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &levelBarrier);
 
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        const int32_t nextWidth  = std::max(mipWidth / 2, 1);
+        const int32_t nextHeight = std::max(mipHeight / 2, 1);
 
-    vkDeviceWaitIdle(device);
+        VkImageBlit blit = {
+            .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, idx - 1, 0, 1 },
+            .srcOffsets     = { { 0, 0, 0 }, { mipWidth, mipHeight, 1 } },
+            .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, idx, 0, 1 },
+            .dstOffsets     = { { 0, 0, 0 }, { nextWidth, nextHeight, 1 } },
+        };
 
-    return true;
-}
+        vkCmdBlitImage(cmdBuffer, m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
 
+        levelBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_READ_BIT;
+        levelBarrier.dstAccessMask  = VK_ACCESS_SHADER_READ_BIT;
+        levelBarrier.oldLayout      = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        levelBarrier.newLayout      = VK_IMAGE_LAYOUT_GENERAL;
+
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &levelBarrier);
+
+        mipWidth  = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    // The last level was only written
+    levelBarrier.subresourceRange.baseMipLevel = m_mipLevels - 1;
+    levelBarrier.srcAccessMask  = VK_ACCESS_TRANSFER_WRITE_BIT;
+    levelBarrier.dstAccessMask  = VK_ACCESS_SHADER_READ_BIT;
+    levelBarrier.oldLayout      = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    levelBarrier.newLayout      = VK_IMAGE_LAYOUT_GENERAL;
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &levelBarrier);
+}
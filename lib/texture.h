@@ -1,13 +1,19 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
+#include "memory_arena.h"
+
+class SamplerCache;
+
 VkImageView Create2DImageView(
     const VkDevice  device,
     const VkFormat  format,
-    const VkImage   image);
+    const VkImage   image,
+    uint32_t        mipLevels = 1);
 
 
 struct BufferInfo;
@@ -23,6 +29,17 @@ public:
         const VkFormat          format,
         VkImageUsageFlags       usage);
 
+    // Loads every file and uploads all of them with a single submit (full mip chains).
+    // Entries of files which could not be loaded are nullptr.
+    static std::vector<Texture*> LoadFromFiles(
+        const VkPhysicalDevice          phyDevice,
+        const VkDevice                  device,
+        const VkQueue                   queue,
+        const VkCommandPool             cmdPool,
+        const std::vector<std::string>& paths,
+        const VkFormat                  format,
+        VkImageUsageFlags               usage);
+
 /*
     static Texture *LoadFromData(
         const VkPhysicalDevice  phyDevice,
@@ -40,19 +57,32 @@ public:
         const VkFormat          format,
         VkExtent2D              extent,
         VkImageUsageFlags       usage,
-        VkSampleCountFlagBits   msaaSamples = VK_SAMPLE_COUNT_1_BIT);
+        VkSampleCountFlagBits   msaaSamples = VK_SAMPLE_COUNT_1_BIT,
+        uint32_t                mipLevels = 1);
+
+    // Number of levels in a full mip chain (down to 1x1).
+    static uint32_t FullMipCount(VkExtent2D extent);
 
     VkImage image() const { return m_image; }
     VkImageView view() const { return m_view; }
     VkSampler sampler() const { return m_sampler; }
 
+    // Waits only for its own submit, prefer StagingUploader/LoadFromFiles for multiple textures.
     bool UploadFromBuffer(
         const VkDevice      device,
         const VkQueue       queue,
         const VkCommandPool cmdPool,
         const VkBuffer&     rawBuffer);
 
-    bool Create2DSampler(const VkDevice device);
+    // Records the copy of tightly packed texel data at "bufferOffset" into the first mip level,
+    // the rest of the mip chain is generated with blits. The image is left in VK_IMAGE_LAYOUT_GENERAL.
+    void RecordUpload(
+        const VkCommandBuffer   cmdBuffer,
+        const VkBuffer          buffer,
+        VkDeviceSize            bufferOffset = 0) const;
+
+    // The sampler is shared through the device's SamplerCache.
+    bool Create2DSampler(const VkPhysicalDevice phyDevice, const VkDevice device);
 
     void Destroy(const VkDevice device);
 
@@ -62,6 +92,8 @@ public:
     uint32_t Height() const { return m_height; }
 
     VkExtent2D Extent2D() const { return { m_width, m_height }; }
+    VkFormat Format() const { return m_format; }
+    uint32_t MipLevels() const { return m_mipLevels; }
 
     Texture()
         : Texture(VK_FORMAT_UNDEFINED, 0, 0)
@@ -74,6 +106,7 @@ private:
         , m_height(height)
     {}
 
+    // Uses "m_mipLevels" levels, reduced to 1 if the format can not be linearly blitted.
     VkResult CreateImage(
         const VkPhysicalDevice  phyDevice,
         const VkDevice          device,
@@ -92,10 +125,12 @@ private:
     VkFormat m_format;
     uint32_t m_width;
     uint32_t m_height;
+    uint32_t m_mipLevels = 1;
 
-    VkImage m_image;
-    VkDeviceMemory m_memory;
+    VkImage m_image = VK_NULL_HANDLE;
+    MemoryAllocation m_memory;
 
-    VkImageView m_view;
-    VkSampler m_sampler;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;       // shared, owned by "m_samplerCache"
+    SamplerCache* m_samplerCache = nullptr;
 };
@@ -0,0 +1,201 @@
+#include "texture_loader.h"
+
+#include <cstdio>
+
+#include "memory_arena.h"
+#include "stb_image.h"
+
+TextureLoader::TextureLoader(
+    const VkPhysicalDevice  phyDevice,
+    const VkDevice          device,
+    const VkQueue           queue,
+    uint32_t                queueFamilyIdx,
+    uint32_t                workerCount)
+    : m_phyDevice(phyDevice)
+    , m_device(device)
+    , m_workers(std::make_unique<ThreadPool>(workerCount)) {
+
+    VkCommandPoolCreateInfo poolInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queueFamilyIdx,
+    };
+
+    VkResult result = vkCreateCommandPool(device, &poolInfo, nullptr, &m_cmdPool);
+    if (result != VK_SUCCESS) {
+        printf("[TextureLoader] Command pool creation failed (error code: %d)\n", result);
+        m_cmdPool = VK_NULL_HANDLE;
+        return;
+    }
+
+    m_uploader = StagingUploader::Create(phyDevice, device, queue, m_cmdPool);
+
+    // Neutral gray 1x1 texture used until the real data arrives.
+    const uint8_t placeholderPixel[4] = { 128, 128, 128, 255 };
+
+    m_placeholder = Texture::Create2D(phyDevice, device, VK_FORMAT_R8G8B8A8_UNORM, {1, 1}, VK_IMAGE_USAGE_SAMPLED_BIT);
+    MemoryArena::NameResource(device, reinterpret_cast<uint64_t>(m_placeholder.image()), "TexturePlaceholder");
+
+    m_uploader.UploadImage(m_placeholder, placeholderPixel, sizeof(placeholderPixel));
+    m_uploader.Flush();
+}
+
+TextureHandle TextureLoader::Load(const std::string& path, VkFormat format) {
+    std::unique_ptr<Entry> entry = std::make_unique<Entry>();
+    entry->path   = path;
+    entry->format = format;
+
+    Entry* entryPtr = entry.get();
+    const TextureHandle handle = (TextureHandle)m_entries.size();
+
+    m_entries.push_back(std::move(entry));
+
+    m_workers->Enqueue([this, entryPtr]() { Decode(entryPtr); });
+
+    return handle;
+}
+
+void TextureLoader::Decode(Entry* entry) {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t channels = 0;
+
+    uint8_t *data = stbi_load(entry->path.c_str(), &width, &height, &channels, 4);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!data) {
+        printf("[TextureLoader] Failed to load image: %s\n", entry->path.c_str());
+        entry->state = State::Failed;
+        return;
+    }
+
+    printf("Loaded image: %s (%dx%d)\n", entry->path.c_str(), width, height);
+
+    entry->pixels = data;
+    entry->width  = width;
+    entry->height = height;
+    entry->state  = State::Decoded;
+}
+
+uint32_t TextureLoader::Update() {
+    // 1) Queue the upload of every image decoded since the last call
+    std::vector<Entry*> decoded;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (std::unique_ptr<Entry>& entry : m_entries) {
+            if (entry->state == State::Decoded) {
+                decoded.push_back(entry.get());
+            }
+        }
+    }
+
+    // Nothing can be uploaded without a command pool
+    if (m_cmdPool == VK_NULL_HANDLE) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Entry* entry : decoded) {
+            stbi_image_free(entry->pixels);
+            entry->pixels = nullptr;
+            entry->state  = State::Failed;
+        }
+
+        return 0;
+    }
+
+    for (Entry* entry : decoded) {
+        const VkExtent2D extent = {(uint32_t)entry->width, (uint32_t)entry->height};
+
+        // The mip chain is built on the GPU by the upload commands
+        entry->texture = Texture::Create2D(m_phyDevice, m_device, entry->format, extent, VK_IMAGE_USAGE_SAMPLED_BIT,
+                                           VK_SAMPLE_COUNT_1_BIT, Texture::FullMipCount(extent));
+
+        if (entry->texture.IsValid()) {
+            MemoryArena::NameResource(m_device, reinterpret_cast<uint64_t>(entry->texture.image()), entry->path);
+
+            m_uploader.UploadImage(entry->texture, entry->pixels, (VkDeviceSize)entry->width * entry->height * 4);
+        }
+
+        stbi_image_free(entry->pixels);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->pixels = nullptr;
+        entry->state  = entry->texture.IsValid() ? State::Uploading : State::Failed;
+    }
+
+    // 2) One submit for all of them
+    const uint64_t batchId = m_uploader.Submit();
+    for (Entry* entry : decoded) {
+        entry->batchId = batchId;
+    }
+
+    // 3) Check the earlier batches
+    m_uploader.Poll();
+
+    uint32_t residentCount = 0;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (std::unique_ptr<Entry>& entry : m_entries) {
+        if (entry->state == State::Uploading && m_uploader.IsComplete(entry->batchId)) {
+            entry->state = State::Resident;
+            residentCount++;
+        }
+    }
+
+    return residentCount;
+}
+
+bool TextureLoader::IsResident(TextureHandle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries[handle]->state == State::Resident;
+}
+
+bool TextureLoader::IsFailed(TextureHandle handle) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries[handle]->state == State::Failed;
+}
+
+uint32_t TextureLoader::PendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    uint32_t count = 0;
+    for (const std::unique_ptr<Entry>& entry : m_entries) {
+        if (entry->state != State::Resident && entry->state != State::Failed) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+const Texture& TextureLoader::Get(TextureHandle handle) const {
+    if (handle < m_entries.size() && IsResident(handle)) {
+        return m_entries[handle]->texture;
+    }
+
+    return m_placeholder;
+}
+
+void TextureLoader::Destroy() {
+    m_workers->WaitIdle();
+    m_workers.reset();
+
+    m_uploader.Destroy();
+
+    for (std::unique_ptr<Entry>& entry : m_entries) {
+        if (entry->pixels) {
+            stbi_image_free(entry->pixels);
+        }
+
+        if (entry->texture.IsValid()) {
+            entry->texture.Destroy(m_device);
+        }
+    }
+    m_entries.clear();
+
+    m_placeholder.Destroy(m_device);
+
+    vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+    m_cmdPool = VK_NULL_HANDLE;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+#include "staging_uploader.h"
+#include "texture.h"
+#include "thread_pool.h"
+
+using TextureHandle = uint32_t;
+
+// Streams textures in the background:
+//  - image files are decoded on a worker pool,
+//  - decoded images are uploaded by Update in one batch per call, without waiting for the GPU,
+//  - until a texture is resident "Get" returns a placeholder texture.
+// Everything except the decoding runs on the thread calling Load/Update.
+class TextureLoader {
+public:
+    TextureLoader(
+        const VkPhysicalDevice  phyDevice,
+        const VkDevice          device,
+        const VkQueue           queue,
+        uint32_t                queueFamilyIdx,
+        uint32_t                workerCount = 0);
+
+    TextureHandle Load(const std::string& path, VkFormat format);
+
+    // Call once per frame: submits the uploads of the freshly decoded images and checks the earlier batches.
+    // Returns the number of textures which became resident, descriptors referencing them should be updated.
+    uint32_t Update();
+
+    bool IsResident(TextureHandle handle) const;
+    bool IsFailed(TextureHandle handle) const;
+    uint32_t PendingCount() const;
+
+    // The loaded texture if resident, the placeholder otherwise.
+    const Texture& Get(TextureHandle handle) const;
+    const Texture& Placeholder() const { return m_placeholder; }
+
+    // Waits for the in-flight work then frees every texture.
+    void Destroy();
+
+private:
+    enum class State {
+        Decoding,
+        Decoded,
+        Uploading,
+        Resident,
+        Failed,
+    };
+
+    struct Entry {
+        std::string path;
+        VkFormat    format;
+        State       state       = State::Decoding;
+
+        // Written by the workers
+        uint8_t*    pixels      = nullptr;
+        int32_t     width       = 0;
+        int32_t     height      = 0;
+
+        Texture     texture;
+        uint64_t    batchId     = 0;
+    };
+
+    void Decode(Entry* entry);
+
+    VkPhysicalDevice                        m_phyDevice;
+    VkDevice                                m_device;
+    VkCommandPool                           m_cmdPool   = VK_NULL_HANDLE;
+    StagingUploader                         m_uploader;
+    Texture                                 m_placeholder;
+
+    std::unique_ptr<ThreadPool>             m_workers;
+    mutable std::mutex                      m_mutex;    // guards the "state" and the decoded data of entries
+    std::vector<std::unique_ptr<Entry>>     m_entries;
+};
@@ -0,0 +1,47 @@
+#include "texture_table.h"
+
+#include <cstdio>
+
+#include "descriptors.h"
+#include "texture.h"
+
+void TextureTable::Init(
+    DescriptorSetMgmt*  set,
+    uint32_t            binding,
+    uint32_t            capacity,
+    bool                bindless,
+    const Texture&      fallback) {
+
+    m_set       = set;
+    m_binding   = binding;
+    m_capacity  = capacity;
+    m_count     = 0;
+
+    if (bindless) {
+        return;
+    }
+
+    for (uint32_t idx = 0; idx < m_capacity; idx++) {
+        m_set->SetArrayImage(m_binding, idx, fallback.view(), fallback.sampler());
+    }
+}
+
+uint32_t TextureTable::Register(const Texture& texture) {
+    if (m_count >= m_capacity) {
+        printf("[TextureTable] Table is full (%u textures)\n", m_capacity);
+        return kInvalidIndex;
+    }
+
+    const uint32_t idx = m_count++;
+    Replace(idx, texture);
+
+    return idx;
+}
+
+void TextureTable::Replace(uint32_t idx, const Texture& texture) {
+    m_set->SetArrayImage(m_binding, idx, texture.view(), texture.sampler());
+}
+
+void TextureTable::Update(const VkDevice device) {
+    m_set->Update(device);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include <vulkan/vulkan_core.h>
+
+class DescriptorSetMgmt;
+class Texture;
+
+// Hands out indices into a COMBINED_IMAGE_SAMPLER array binding, shaders select the texture
+// with the index (e.g. from a push constant) instead of binding a descriptor set per material.
+// With a bindless binding (DescriptorMgmt::SetBindlessDescriptor) unused elements stay empty,
+// otherwise every element is filled with the fallback texture first.
+class TextureTable {
+public:
+    static constexpr uint32_t kInvalidIndex = UINT32_MAX;
+
+    void Init(
+        DescriptorSetMgmt*  set,
+        uint32_t            binding,
+        uint32_t            capacity,
+        bool                bindless,
+        const Texture&      fallback);
+
+    // Returns kInvalidIndex if the table is full.
+    uint32_t Register(const Texture& texture);
+    void Replace(uint32_t idx, const Texture& texture);
+
+    // Writes the registered/replaced textures into the descriptor set.
+    void Update(const VkDevice device);
+
+    uint32_t Count() const { return m_count; }
+    uint32_t Capacity() const { return m_capacity; }
+
+private:
+    DescriptorSetMgmt*  m_set       = nullptr;
+    uint32_t            m_binding   = 0;
+    uint32_t            m_capacity  = 0;
+    uint32_t            m_count     = 0;
+};
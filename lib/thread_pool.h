@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size worker pool for CPU side work (image decoding, etc.).
+// Tasks must not touch Vulkan objects which are externally synchronized by the main thread.
+class ThreadPool {
+public:
+    // 0 means one worker per hardware thread (minus the main thread).
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Enqueue(std::function<void()> task);
+
+    // Blocks until every enqueued task is finished.
+    void WaitIdle();
+
+    uint32_t ThreadCount() const { return (uint32_t)m_workers.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread>            m_workers;
+    std::deque<std::function<void()>>   m_tasks;
+
+    std::mutex                          m_mutex;
+    std::condition_variable             m_taskCondition;
+    std::condition_variable             m_idleCondition;
+    uint32_t                            m_activeTasks   = 0;
+    bool                                m_stopping      = false;
+};